@@ -23,6 +23,11 @@ ttest(byte_stream_one_write)
 ttest(byte_stream_two_writes)
 ttest(byte_stream_many_writes)
 ttest(byte_stream_stress_test)
+ttest(byte_stream_ring)
+ttest(byte_stream_vectored)
+ttest(byte_stream_zero_copy)
+ttest(byte_stream_concurrent)
+ttest(byte_stream_fd)
 
 ttest(reassembler_single)
 ttest(reassembler_cap)
@@ -31,6 +36,9 @@ ttest(reassembler_dup)
 ttest(reassembler_holes)
 ttest(reassembler_overlapping)
 ttest(reassembler_win)
+ttest(reassembler_bitmap)
+ttest(reassembler_budget)
+ttest(reassembler_batch)
 
 ttest(wrapping_integers_cmp)
 ttest(wrapping_integers_wrap)
@@ -45,6 +53,10 @@ ttest(recv_reorder)
 ttest(recv_reorder_more)
 ttest(recv_close)
 ttest(recv_special)
+ttest(recv_sack)
+ttest(recv_window_scale)
+ttest(recv_delayed_ack)
+ttest(recv_auto_tune)
 
 ttest(send_connect)
 ttest(send_transmit)
@@ -53,8 +65,20 @@ ttest(send_window)
 ttest(send_ack)
 ttest(send_close)
 ttest(send_extra)
+ttest(send_congestion)
+ttest(send_rto)
+ttest(send_fast_retx)
+ttest(send_sack)
+ttest(send_window_scale)
+ttest(send_pacing)
+ttest(send_mss)
+ttest(send_hold)
 
 ttest(net_interface)
+ttest(timing_wheel)
+ttest(tcp_segment)
+ttest(tcp_peer)
+ttest(eventloop)
 
 ttest(router)
 
@@ -81,12 +105,15 @@ add_test(NAME ${compile_name_opt}
   COMMAND "${CMAKE_COMMAND}" --build "${CMAKE_BINARY_DIR}" -t speed_testing)
 
 macro (stest name)
-  add_test(NAME ${name} COMMAND ${name})
+  add_test(NAME ${name} COMMAND ${name} ${ARGN})
   set_property(TEST ${name} PROPERTY FIXTURES_REQUIRED compile_opt)
 endmacro (stest)
 
 set_property(TEST ${compile_name_opt} PROPERTY TIMEOUT -1)
 set_tests_properties(${compile_name_opt} PROPERTIES FIXTURES_SETUP compile_opt)
 
-stest(byte_stream_speed_test)
-stest(reassembler_speed_test)
+stest(byte_stream_speed_test --check-allocations)
+stest(reassembler_speed_test --check-allocations)
+stest(send_pacing_speed_test)
+stest(tcp_segment_speed_test)
+stest(tcp_peer_speed_test)
@@ -1,31 +1,145 @@
 #include "byte_stream.hh"
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <span>
 #include <stdexcept>
 
+#include "chunk_pool.hh"
+#include "file_descriptor.hh"
+
 // 重点：为了性能实现延迟更改
 
 using namespace std;
 
-ByteStream::ByteStream(uint64_t capacity) : capacity_(capacity) {}
+// Largest chunk push_from() allocates for Storage::Chunked
+static constexpr uint64_t MAX_READ_CHUNK_SIZE = 16384;
+
+ByteStream::ByteStream(uint64_t capacity, Storage storage)
+    : capacity_(capacity), storage_(storage) {
+  if (storage_ == Storage::Ring) {
+    // The only allocation a ring-backed stream ever makes
+    ring_.resize(capacity_);
+  }
+}
+
+// Copy `data` behind the buffered bytes, wrapping around the end of ring_.
+// The caller guarantees data.size() <= available_capacity().
+void ByteStream::ring_write(string_view data) {
+  const uint64_t size = ring_.size();
+  const uint64_t tail = (ring_head_ + bytes_buffered_) % size;
+  const uint64_t first = min(data.size(), size - tail);
+  memcpy(ring_.data() + tail, data.data(), first);
+  memcpy(ring_.data(), data.data() + first, data.size() - first);
+}
+
+// Queue a chunk (Storage::Chunked) behind the buffered bytes. The caller
+// accounts for its bytes afterwards.
+void ByteStream::push_chunk(Buffer chunk) {
+  chunk_ends_.push_back(bytes_pushed_ + chunk.size());
+  buffer_.push_back(move(chunk));
+}
 
 void Writer::push(string data) {
   if (available_capacity() == 0 || data.empty()) {
     return;
   }
   auto const n = min(available_capacity(), data.size());
-  if (n < data.size()) {
-    data = data.substr(0, n);
+  if (storage_ == Storage::Ring) {
+    ring_write(string_view{data}.substr(0, n));
+  } else {
+    // Shrinking keeps the existing allocation
+    data.resize(n);
+    push_chunk(move(data));
   }
-  buffer_.push(move(data));
   bytes_buffered_ += n;
   bytes_pushed_ += n;
 }
 
+void Writer::push(Buffer data) {
+  if (available_capacity() == 0 || data.empty()) {
+    return;
+  }
+  auto const n = min(available_capacity(), data.size());
+  data.truncate(n);
+  if (storage_ == Storage::Ring) {
+    ring_write(data);
+  } else {
+    push_chunk(move(data));
+  }
+  bytes_buffered_ += n;
+  bytes_pushed_ += n;
+}
+
+void Writer::push(string_view data) {
+  if (available_capacity() == 0 || data.empty()) {
+    return;
+  }
+  data = data.substr(0, available_capacity());
+  if (storage_ == Storage::Ring) {
+    ring_write(data);
+  } else {
+    string chunk = ChunkPool::acquire(data.size());
+    chunk.assign(data);
+    push_chunk(move(chunk));
+  }
+  bytes_buffered_ += data.size();
+  bytes_pushed_ += data.size();
+}
+
+uint64_t Writer::push_from(FileDescriptor& fd) {
+  uint64_t n = available_capacity();
+  if (n == 0) {
+    return 0;
+  }
+
+  if (storage_ == Storage::Ring) {
+    // The free space is at most two regions: after the tail, then from the
+    // start of ring_ up to the head
+    const uint64_t size = ring_.size();
+    const uint64_t tail = (ring_head_ + bytes_buffered_) % size;
+    const uint64_t first = min(n, size - tail);
+    vector<span<char>> regions{{ring_.data() + tail, first}};
+    if (first < n) {
+      regions.emplace_back(ring_.data(), n - first);
+    }
+    const uint64_t bytes_read = fd.read(regions);
+    bytes_buffered_ += bytes_read;
+    bytes_pushed_ += bytes_read;
+    return bytes_read;
+  }
+
+  // Read into a string sized to what fits, which is then moved in as a chunk
+  n = min(n, MAX_READ_CHUNK_SIZE);
+  string chunk = ChunkPool::acquire(n);
+  chunk.resize(n);
+  const uint64_t bytes_read = fd.read({{chunk.data(), chunk.size()}});
+  chunk.resize(bytes_read);
+  push(move(chunk));
+  return bytes_read;
+}
+
 void Writer::close() { closed_ = true; }
 
 void Writer::set_error() { error_ = true; }
 bool Writer::is_closed() const { return closed_; }
 
+uint64_t Writer::capacity() const { return capacity_; }
+
+void Writer::set_capacity(uint64_t capacity) {
+  capacity = max(capacity, bytes_buffered_);
+  if (storage_ == Storage::Ring && capacity != ring_.size()) {
+    string ring(capacity, '\0');
+    const uint64_t first = min(bytes_buffered_, ring_.size() - ring_head_);
+    memcpy(ring.data(), ring_.data() + ring_head_, first);
+    memcpy(ring.data() + first, ring_.data(), bytes_buffered_ - first);
+    ring_.swap(ring);
+    ring_head_ = 0;
+  }
+  capacity_ = capacity;
+}
+
 uint64_t Writer::available_capacity() const {
   return capacity_ - bytes_buffered_;
 }
@@ -34,12 +148,95 @@ uint64_t Writer::bytes_pushed() const { return bytes_pushed_; }
 
 // 注意看辅助函数得到peek的定义
 string_view Reader::peek() const {
+  if (storage_ == Storage::Ring) {
+    if (bytes_buffered_ == 0) {
+      return {};
+    }
+    // Everything up to the end of ring_; the wrapped part follows after pop()
+    return {ring_.data() + ring_head_,
+            min(bytes_buffered_, ring_.size() - ring_head_)};
+  }
   if (buffer_.empty()) {
     return {};
   }
-  string_view ans = string_view{buffer_.front()};
-  ans.remove_prefix(removed_prefix_);
-  return ans;
+  return buffer_.front();
+}
+
+// The views stay valid until the next pop() or push(); `out` is reused so a
+// caller draining the stream in a loop does not allocate.
+void Reader::peek_vectored(vector<string_view>& out, uint64_t limit,
+                           size_t max_views) const {
+  out.clear();
+  limit = min(limit, bytes_buffered_);
+  if (limit == 0 || max_views == 0) {
+    return;
+  }
+  if (storage_ == Storage::Ring) {
+    const uint64_t first = min(limit, ring_.size() - ring_head_);
+    out.emplace_back(ring_.data() + ring_head_, first);
+    if (first < limit && max_views > 1) {
+      out.emplace_back(ring_.data(), limit - first);
+    }
+    return;
+  }
+  for (const auto& chunk : buffer_) {
+    const auto view = string_view{chunk}.substr(0, limit);
+    out.push_back(view);
+    limit -= view.size();
+    if (limit == 0 || out.size() == max_views) {
+      return;
+    }
+  }
+}
+
+Buffer Reader::peek_buffer(uint64_t offset, uint64_t len) const {
+  if (offset >= bytes_buffered_) {
+    return {};
+  }
+  len = min(len, bytes_buffered_ - offset);
+  if (storage_ == Storage::Chunked) {
+    // The first chunk ending past the offset holds it. Chunks are trimmed
+    // only at the front, so each one still ends where it was pushed to.
+    const uint64_t index = bytes_popped_ + offset;
+    const auto end =
+        upper_bound(chunk_ends_.begin(), chunk_ends_.end(), index);
+    auto chunk = buffer_.begin() + (end - chunk_ends_.begin());
+    uint64_t start = chunk->size() - (*end - index);
+    if (start + len <= chunk->size()) {
+      return chunk->substr(start, len);
+    }
+
+    // Spans chunks: copy, starting from the one found
+    string copy = ChunkPool::acquire(len);
+    for (; copy.size() < len; ++chunk, start = 0) {
+      copy += string_view{*chunk}.substr(start, len - copy.size());
+    }
+    return copy;
+  }
+
+  // Storage::Ring: copy
+  thread_local vector<string_view> views;
+  peek_vectored(views, offset + len);
+  string copy = ChunkPool::acquire(len);
+  for (auto view : views) {
+    const uint64_t skip = min<uint64_t>(offset, view.size());
+    offset -= skip;
+    view.remove_prefix(skip);
+    copy += view;
+  }
+  return copy;
+}
+
+uint64_t Reader::pop_to(FileDescriptor& fd) {
+  if (bytes_buffered_ == 0) {
+    return 0;
+  }
+  // More regions than IOV_MAX would fail the writev (EINVAL)
+  thread_local vector<string_view> views;
+  peek_vectored(views, UINT64_MAX, IOV_MAX);
+  const uint64_t bytes_written = fd.write(views);
+  pop(bytes_written);
+  return bytes_written;
 }
 
 bool Reader::is_finished() const { return closed_ && bytes_buffered_ == 0; }
@@ -50,18 +247,24 @@ void Reader::pop(uint64_t len) {
   auto n = min(len, bytes_buffered_);
   bytes_buffered_ -= n;
   bytes_popped_ += n;
+  if (storage_ == Storage::Ring) {
+    if (n > 0) {
+      ring_head_ = (ring_head_ + n) % ring_.size();
+    }
+    return;
+  }
   while (n > 0) {
-    auto sz = buffer_.front().size() - removed_prefix_;
+    auto sz = buffer_.front().size();
     if (n < sz) {
-      removed_prefix_ += len;
+      buffer_.front().remove_prefix(n);
       return;
     }
-    removed_prefix_ = 0;
-    buffer_.pop();
+    buffer_.pop_front();
+    chunk_ends_.pop_front();
     n -= sz;
   }
 }
 
 uint64_t Reader::bytes_buffered() const { return bytes_buffered_; }
 
-uint64_t Reader::bytes_popped() const { return bytes_popped_; }
\ No newline at end of file
+uint64_t Reader::bytes_popped() const { return bytes_popped_; }
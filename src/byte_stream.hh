@@ -1,19 +1,33 @@
 #pragma once
 
 #include <cstdint>
-#include <queue>
+#include <deque>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <vector>
+
+#include "buffer.hh"
+#include "chunk_pool.hh"
 
 using namespace std;
 
 class Reader;
 class Writer;
+class FileDescriptor;
 
 class ByteStream {
+ public:
+  // How the buffered bytes are stored.
+  //   Chunked: a queue of the pushed strings and Buffers (shared, no copy).
+  //   Ring: one capacity-sized buffer allocated at construction (and again
+  //         by set_capacity()); pushes copy into it and peek() returns the
+  //         largest contiguous region.
+  enum class Storage { Chunked, Ring };
+
  protected:
   uint64_t capacity_;
+  Storage storage_;
   // Please add any additional state to the ByteStream here, and not to the
   // Writer and Reader interfaces.
   bool closed_{false};
@@ -22,12 +36,25 @@ class ByteStream {
   uint64_t bytes_pushed_{0};
   uint64_t bytes_popped_{0};
   uint64_t bytes_buffered_{0};
-  uint64_t removed_prefix_{0};
 
-  queue<string> buffer_{};
+  // Storage::Chunked, the front Buffer is trimmed in place by pop().
+  // The deque's nodes come and go as it slides, so they come from the pool.
+  deque<Buffer, PoolAllocator<Buffer>> buffer_{};
+  // The stream index just past each chunk in buffer_, so peek_buffer() can
+  // find the chunk holding an offset by binary search
+  deque<uint64_t, PoolAllocator<uint64_t>> chunk_ends_{};
+
+  // Storage::Ring, ring_head_ is the offset of the first buffered byte
+  string ring_{};
+  uint64_t ring_head_{0};
+
+  void ring_write(string_view data);
+  void push_chunk(Buffer chunk);
 
  public:
-  explicit ByteStream(uint64_t capacity);
+  explicit ByteStream(uint64_t capacity, Storage storage = Storage::Chunked);
+
+  Storage storage() const { return storage_; }
 
   // Helper functions (provided) to access the ByteStream's Reader and Writer
   // interfaces
@@ -41,12 +68,23 @@ class Writer : public ByteStream {
  public:
   void push(std::string data);  // Push data to stream, but only as much as
                                 // available capacity allows.
+  void push(Buffer data);  // Same, sharing the Buffer's bytes rather than
+                           // copying them (Storage::Chunked)
+  void push(std::string_view data);  // Same, copying only what fits
+
+  // Read from `fd` straight into the stream's storage, as much as available
+  // capacity allows. Returns the number of bytes read; check fd.eof().
+  uint64_t push_from(FileDescriptor& fd);
 
   void close();  // Signal that the stream has reached its ending. Nothing more
                  // will be written.
   void set_error();  // Signal that the stream suffered an error.
 
   bool is_closed() const;  // Has the stream been closed?
+  uint64_t capacity() const;  // Most bytes the stream can buffer
+  // Change the capacity, though never below what is buffered. A ring is
+  // reallocated at the new size, with the buffered bytes moved to its start.
+  void set_capacity(uint64_t capacity);
   uint64_t available_capacity()
       const;  // How many bytes can be pushed to the stream right now?
   uint64_t bytes_pushed()
@@ -56,8 +94,23 @@ class Writer : public ByteStream {
 class Reader : public ByteStream {
  public:
   std::string_view peek() const;  // Peek at the next bytes in the buffer
+  void peek_vectored(std::vector<std::string_view>& out,
+                     uint64_t limit = UINT64_MAX,
+                     size_t max_views = SIZE_MAX)
+      const;  // Peek at every buffered region, up to `limit` bytes in total
+              // and `max_views` regions
   void pop(uint64_t len);         // Remove `len` bytes from the buffer
 
+  // Up to `len` buffered bytes starting `offset` bytes past the front, as a
+  // Buffer. It shares the stream's storage when the bytes lie within one
+  // chunk (Storage::Chunked), so they outlive pop() without being copied.
+  Buffer peek_buffer(uint64_t offset, uint64_t len) const;
+
+  // Write buffered bytes straight from the stream's storage to `fd` with one
+  // writev of at most IOV_MAX regions, and pop what was written. Returns the
+  // number of bytes written.
+  uint64_t pop_to(FileDescriptor& fd);
+
   bool is_finished()
       const;               // Is the stream finished (closed and fully popped)?
   bool has_error() const;  // Has the stream had an error?
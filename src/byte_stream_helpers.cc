@@ -1,5 +1,6 @@
 #include <cstdint>
 #include <stdexcept>
+#include <vector>
 
 #include "byte_stream.hh"
 
@@ -10,18 +11,24 @@
 void read(Reader& reader, uint64_t len, std::string& out) {
   out.clear();
 
-  while (reader.bytes_buffered() and out.size() < len) {
-    auto view = reader.peek();
+  // Gather every buffered region at once, then pop them with a single call.
+  thread_local std::vector<std::string_view> views;
+  reader.peek_vectored(views, len);
 
+  uint64_t total = 0;
+  for (const auto view : views) {
     if (view.empty()) {
-      throw std::runtime_error("Reader::peek() returned empty string_view");
+      throw std::runtime_error(
+          "Reader::peek_vectored() returned empty string_view");
     }
+    total += view.size();
+  }
 
-    view = view.substr(
-        0, len - out.size());  // Don't return more bytes than desired.
+  out.reserve(total);
+  for (const auto view : views) {
     out += view;
-    reader.pop(view.size());
   }
+  reader.pop(total);
 }
 
 Reader& ByteStream::reader() {
@@ -0,0 +1,162 @@
+#include "concurrent_byte_stream.hh"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+ConcurrentByteStream::ConcurrentByteStream(uint64_t capacity)
+    : capacity_(capacity), ring_(make_unique_for_overwrite<char[]>(capacity)) {}
+
+uint64_t ConcurrentWriter::push(string_view data) {
+  // Only this thread stores to pushed_and_flags_, so a relaxed load is exact
+  const uint64_t word = pushed_and_flags_.load(memory_order_relaxed);
+  const uint64_t pushed = word & COUNT_MASK;
+
+  // Consult the consumer's counter only when the cached copy says we're full
+  if (capacity_ - (pushed - popped_seen_by_writer_) < data.size()) {
+    popped_seen_by_writer_ = bytes_popped_.load(memory_order_acquire);
+  }
+  const uint64_t n =
+      min(capacity_ - (pushed - popped_seen_by_writer_), data.size());
+  if (n == 0) {
+    return 0;
+  }
+
+  const uint64_t tail = pushed % capacity_;
+  const uint64_t first = min(n, capacity_ - tail);
+  memcpy(ring_.get() + tail, data.data(), first);
+  memcpy(ring_.get(), data.data() + first, n - first);
+
+  pushed_and_flags_.store(word + n, memory_order_release);
+  pushed_and_flags_.notify_one();
+  return n;
+}
+
+void ConcurrentWriter::close() {
+  const uint64_t word = pushed_and_flags_.load(memory_order_relaxed);
+  pushed_and_flags_.store(word | CLOSED_FLAG, memory_order_release);
+  pushed_and_flags_.notify_all();
+}
+
+void ConcurrentWriter::set_error() {
+  const uint64_t word = pushed_and_flags_.load(memory_order_relaxed);
+  pushed_and_flags_.store(word | ERROR_FLAG, memory_order_release);
+  pushed_and_flags_.notify_all();
+}
+
+bool ConcurrentWriter::is_closed() const {
+  return pushed_and_flags_.load(memory_order_relaxed) & CLOSED_FLAG;
+}
+
+uint64_t ConcurrentWriter::available_capacity() const {
+  const uint64_t popped = bytes_popped_.load(memory_order_acquire);
+  return capacity_ - (bytes_pushed() - popped);
+}
+
+uint64_t ConcurrentWriter::bytes_pushed() const {
+  return pushed_and_flags_.load(memory_order_relaxed) & COUNT_MASK;
+}
+
+void ConcurrentWriter::wait_for_capacity(uint64_t len) {
+  len = min(len, capacity_);
+  const uint64_t pushed = bytes_pushed();
+  while (true) {
+    const uint64_t popped = bytes_popped_.load(memory_order_acquire);
+    if (capacity_ - (pushed - popped) >= len) {
+      popped_seen_by_writer_ = popped;
+      return;
+    }
+    bytes_popped_.wait(popped, memory_order_acquire);
+  }
+}
+
+string_view ConcurrentReader::peek() {
+  const uint64_t popped = bytes_popped_.load(memory_order_relaxed);
+  // Refresh the cached copy so a following pop() need not touch the
+  // producer's cache line again
+  pushed_seen_by_reader_ =
+      pushed_and_flags_.load(memory_order_acquire) & COUNT_MASK;
+  const uint64_t buffered = pushed_seen_by_reader_ - popped;
+  if (buffered == 0) {
+    return {};
+  }
+  const uint64_t head = popped % capacity_;
+  return {ring_.get() + head, min(buffered, capacity_ - head)};
+}
+
+void ConcurrentReader::pop(uint64_t len) {
+  const uint64_t popped = bytes_popped_.load(memory_order_relaxed);
+  if (pushed_seen_by_reader_ - popped < len) {
+    pushed_seen_by_reader_ =
+        pushed_and_flags_.load(memory_order_acquire) & COUNT_MASK;
+  }
+  const uint64_t n = min(len, pushed_seen_by_reader_ - popped);
+  if (n == 0) {
+    return;
+  }
+  bytes_popped_.store(popped + n, memory_order_release);
+  bytes_popped_.notify_one();
+}
+
+bool ConcurrentReader::is_finished() const {
+  const uint64_t word = pushed_and_flags_.load(memory_order_acquire);
+  return (word & CLOSED_FLAG) and (word & COUNT_MASK) == bytes_popped();
+}
+
+bool ConcurrentReader::has_error() const {
+  return pushed_and_flags_.load(memory_order_acquire) & ERROR_FLAG;
+}
+
+uint64_t ConcurrentReader::bytes_buffered() const {
+  return (pushed_and_flags_.load(memory_order_acquire) & COUNT_MASK) -
+         bytes_popped();
+}
+
+uint64_t ConcurrentReader::bytes_popped() const {
+  return bytes_popped_.load(memory_order_relaxed);
+}
+
+void ConcurrentReader::wait_for_data() {
+  const uint64_t popped = bytes_popped();
+  while (true) {
+    const uint64_t word = pushed_and_flags_.load(memory_order_acquire);
+    if ((word & COUNT_MASK) != popped or (word & (CLOSED_FLAG | ERROR_FLAG))) {
+      pushed_seen_by_reader_ = word & COUNT_MASK;
+      return;
+    }
+    pushed_and_flags_.wait(word, memory_order_acquire);
+  }
+}
+
+ConcurrentReader& ConcurrentByteStream::reader() {
+  static_assert(sizeof(ConcurrentReader) == sizeof(ConcurrentByteStream),
+                "Please add member variables to the ConcurrentByteStream "
+                "base, not the ConcurrentByteStream Reader.");
+
+  return static_cast<ConcurrentReader&>(*this);  // NOLINT(*-downcast)
+}
+
+const ConcurrentReader& ConcurrentByteStream::reader() const {
+  static_assert(sizeof(ConcurrentReader) == sizeof(ConcurrentByteStream),
+                "Please add member variables to the ConcurrentByteStream "
+                "base, not the ConcurrentByteStream Reader.");
+
+  return static_cast<const ConcurrentReader&>(*this);  // NOLINT(*-downcast)
+}
+
+ConcurrentWriter& ConcurrentByteStream::writer() {
+  static_assert(sizeof(ConcurrentWriter) == sizeof(ConcurrentByteStream),
+                "Please add member variables to the ConcurrentByteStream "
+                "base, not the ConcurrentByteStream Writer.");
+
+  return static_cast<ConcurrentWriter&>(*this);  // NOLINT(*-downcast)
+}
+
+const ConcurrentWriter& ConcurrentByteStream::writer() const {
+  static_assert(sizeof(ConcurrentWriter) == sizeof(ConcurrentByteStream),
+                "Please add member variables to the ConcurrentByteStream "
+                "base, not the ConcurrentByteStream Writer.");
+
+  return static_cast<const ConcurrentWriter&>(*this);  // NOLINT(*-downcast)
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+class ConcurrentReader;
+class ConcurrentWriter;
+
+/*
+ * A single-producer/single-consumer ByteStream for handing bytes from one
+ * thread to another. The Writer may only be used by one thread and the
+ * Reader by one (other) thread; neither side takes a lock.
+ *
+ * Storage is a capacity-sized ring buffer. The producer publishes bytes by
+ * advancing `bytes_pushed_` (release) after copying them in, and the consumer
+ * frees space by advancing `bytes_popped_` (release) after it is done with
+ * them. Each side keeps its counter, and a cached copy of the other side's,
+ * on its own cache line so the two cores do not bounce a shared line on every
+ * push and pop.
+ */
+class ConcurrentByteStream {
+ protected:
+  static constexpr size_t CACHE_LINE_SIZE = 64;
+
+  // Flags share a word with bytes_pushed_ so that a consumer blocked in
+  // wait_for_data() is woken by close() and set_error() as well as by push().
+  static constexpr uint64_t CLOSED_FLAG = 1ULL << 63;
+  static constexpr uint64_t ERROR_FLAG = 1ULL << 62;
+  static constexpr uint64_t COUNT_MASK = ERROR_FLAG - 1;
+
+  uint64_t capacity_;
+  std::unique_ptr<char[]> ring_;
+
+  // Written by the producer only
+  alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> pushed_and_flags_{0};
+  uint64_t popped_seen_by_writer_{0};
+
+  // Written by the consumer only
+  alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> bytes_popped_{0};
+  uint64_t pushed_seen_by_reader_{0};
+
+ public:
+  explicit ConcurrentByteStream(uint64_t capacity);
+
+  // Helper functions to access the stream's Reader and Writer interfaces
+  ConcurrentReader& reader();
+  const ConcurrentReader& reader() const;
+  ConcurrentWriter& writer();
+  const ConcurrentWriter& writer() const;
+};
+
+class ConcurrentWriter : public ConcurrentByteStream {
+ public:
+  // Push data to stream, but only as much as available capacity allows.
+  // Returns the number of bytes accepted.
+  uint64_t push(std::string_view data);
+
+  void close();      // Signal that the stream has reached its ending.
+  void set_error();  // Signal that the stream suffered an error.
+
+  bool is_closed() const;  // Has the stream been closed?
+  uint64_t available_capacity()
+      const;  // How many bytes can be pushed to the stream right now?
+  uint64_t bytes_pushed()
+      const;  // Total number of bytes cumulatively pushed to the stream
+
+  // Block until at least `len` bytes (capped at the capacity) can be pushed
+  void wait_for_capacity(uint64_t len = 1);
+};
+
+class ConcurrentReader : public ConcurrentByteStream {
+ public:
+  // Peek at the next contiguous bytes in the buffer. The view stays valid
+  // until the next pop().
+  std::string_view peek();
+  void pop(uint64_t len);  // Remove `len` bytes from the buffer
+
+  bool is_finished()
+      const;               // Is the stream finished (closed and fully popped)?
+  bool has_error() const;  // Has the stream had an error?
+
+  uint64_t bytes_buffered()
+      const;  // Number of bytes currently buffered (pushed and not popped)
+  uint64_t bytes_popped()
+      const;  // Total number of bytes cumulatively popped from stream
+
+  // Block until there is data to read, or the stream is closed or in error
+  void wait_for_data();
+};
@@ -0,0 +1,115 @@
+#include "congestion_control.hh"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+// RFC 5681's initial window
+uint64_t initial_window(uint64_t mss) {
+  if (mss > 2190) {
+    return 2 * mss;
+  }
+  if (mss > 1095) {
+    return 3 * mss;
+  }
+  return 4 * mss;
+}
+
+}  // namespace
+
+unique_ptr<CongestionController> CongestionController::make(
+    TCPConfig::CongestionControl algorithm, uint64_t mss) {
+  switch (algorithm) {
+    case TCPConfig::CongestionControl::NewReno:
+      return make_unique<NewReno>(mss);
+    case TCPConfig::CongestionControl::Cubic:
+      return make_unique<Cubic>(mss);
+    case TCPConfig::CongestionControl::None:
+      break;
+  }
+  return nullptr;
+}
+
+NewReno::NewReno(uint64_t mss) : mss_(mss), cwnd_(initial_window(mss)) {}
+
+void NewReno::on_ack(uint64_t bytes_acked, uint64_t /* now_ms */) {
+  if (cwnd_ < ssthresh_) {
+    // Slow start: at most one segment per ACK
+    cwnd_ += min(bytes_acked, mss_);
+    return;
+  }
+  // Congestion avoidance: one segment per window's worth of ACKed bytes
+  bytes_acked_ += bytes_acked;
+  if (bytes_acked_ >= cwnd_) {
+    bytes_acked_ -= cwnd_;
+    cwnd_ += mss_;
+  }
+}
+
+void NewReno::on_loss(uint64_t bytes_in_flight, uint64_t /* now_ms */) {
+  ssthresh_ = max(bytes_in_flight / 2, 2 * mss_);
+  cwnd_ = ssthresh_;
+  bytes_acked_ = 0;
+}
+
+void NewReno::on_rto(uint64_t bytes_in_flight, uint64_t /* now_ms */) {
+  ssthresh_ = max(bytes_in_flight / 2, 2 * mss_);
+  cwnd_ = mss_;
+  bytes_acked_ = 0;
+}
+
+Cubic::Cubic(uint64_t mss) : mss_(mss), cwnd_(initial_window(mss)) {}
+
+void Cubic::on_ack(uint64_t bytes_acked, uint64_t now_ms) {
+  if (cwnd_ < ssthresh_) {
+    cwnd_ += min(bytes_acked, mss_);
+    return;
+  }
+
+  const auto cwnd = static_cast<double>(cwnd_);
+  if (!in_epoch_) {
+    in_epoch_ = true;
+    epoch_start_ms_ = now_ms;
+    origin_ = max(w_max_, cwnd);
+    k_ = cbrt((origin_ - cwnd) / static_cast<double>(mss_) / C);
+    w_est_ = cwnd;
+  }
+
+  // Where the cubic says the window should be an RTT from now (RFC 9438
+  // section 4.2), in at most 1.5x steps
+  const double t = static_cast<double>(now_ms - epoch_start_ms_) / 1000 + rtt_;
+  const double target =
+      clamp(origin_ + C * pow(t - k_, 3) * static_cast<double>(mss_), cwnd,
+            1.5 * cwnd);
+
+  // Reno's window over the same ACKs, scaled for CUBIC's gentler decrease
+  w_est_ += static_cast<double>(mss_) * (3 * (1 - BETA) / (1 + BETA)) *
+            static_cast<double>(bytes_acked) / cwnd;
+
+  const double next = max(
+      cwnd + (target - cwnd) * static_cast<double>(bytes_acked) / cwnd, w_est_);
+  cwnd_ = max(cwnd_, static_cast<uint64_t>(next));
+}
+
+void Cubic::reduce() {
+  const auto cwnd = static_cast<double>(cwnd_);
+  // Fast convergence: give up more room if the last peak was not reached
+  w_max_ = cwnd < w_last_max_ ? cwnd * (1 + BETA) / 2 : cwnd;
+  w_last_max_ = cwnd;
+  ssthresh_ = max(static_cast<uint64_t>(cwnd * BETA), 2 * mss_);
+  cwnd_ = ssthresh_;
+  in_epoch_ = false;
+}
+
+void Cubic::on_loss(uint64_t /* bytes_in_flight */,
+                    uint64_t /* now_ms */) {
+  reduce();
+}
+
+void Cubic::on_rto(uint64_t /* bytes_in_flight */, uint64_t /* now_ms */) {
+  reduce();
+  cwnd_ = mss_;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "tcp_config.hh"
+
+// The congestion window of a TCPSender. The sender keeps no more than
+// min(cwnd, receiver's window) sequence numbers in flight, and tells the
+// controller about acknowledgments and losses. All sizes are in bytes
+// (sequence numbers) and times in ms of the sender's clock.
+class CongestionController {
+ public:
+  virtual ~CongestionController() = default;
+
+  virtual std::string_view name() const = 0;
+
+  virtual uint64_t cwnd() const = 0;
+  virtual uint64_t ssthresh() const = 0;
+
+  // `bytes_acked` previously unacknowledged sequence numbers were acked
+  virtual void on_ack(uint64_t bytes_acked, uint64_t now_ms) = 0;
+
+  // A loss was detected without a timeout (e.g. by duplicate ACKs) while
+  // `bytes_in_flight` were outstanding
+  virtual void on_loss(uint64_t bytes_in_flight, uint64_t now_ms) = 0;
+
+  // The retransmission timer expired while `bytes_in_flight` were outstanding
+  virtual void on_rto(uint64_t bytes_in_flight, uint64_t now_ms) = 0;
+
+  // A new RTT sample left the smoothed RTT at `srtt_ms`
+  virtual void on_rtt(double /* srtt_ms */) {}
+
+  // The controller for `algorithm`, or nullptr for CongestionControl::None
+  static std::unique_ptr<CongestionController> make(
+      TCPConfig::CongestionControl algorithm, uint64_t mss);
+};
+
+// RFC 5681 slow start and congestion avoidance, with the RFC 6582 (NewReno)
+// response to loss: halve the flight size, and drop to one segment on RTO.
+class NewReno : public CongestionController {
+ private:
+  uint64_t mss_;
+  uint64_t cwnd_;
+  uint64_t ssthresh_ = UINT64_MAX;
+  // Bytes acked since cwnd last grew in congestion avoidance
+  uint64_t bytes_acked_ = 0;
+
+ public:
+  explicit NewReno(uint64_t mss);
+
+  std::string_view name() const override { return "NewReno"; }
+  uint64_t cwnd() const override { return cwnd_; }
+  uint64_t ssthresh() const override { return ssthresh_; }
+
+  void on_ack(uint64_t bytes_acked, uint64_t now_ms) override;
+  void on_loss(uint64_t bytes_in_flight, uint64_t now_ms) override;
+  void on_rto(uint64_t bytes_in_flight, uint64_t now_ms) override;
+};
+
+// RFC 9438 CUBIC: after a loss the window follows a cubic function of the
+// time since that loss, flattening out around the window where it happened,
+// and never grows slower than Reno would.
+class Cubic : public CongestionController {
+ public:
+  static constexpr double C = 0.4;
+  static constexpr double BETA = 0.7;
+
+ private:
+  uint64_t mss_;
+  uint64_t cwnd_;
+  uint64_t ssthresh_ = UINT64_MAX;
+
+  // The window just before the last reduction, and that before the one
+  // before (for fast convergence)
+  double w_max_ = 0;
+  double w_last_max_ = 0;
+
+  // Congestion avoidance epoch: when it began, the window the cubic is
+  // centred on, the time to reach it (in seconds), and the Reno estimate
+  bool in_epoch_ = false;
+  uint64_t epoch_start_ms_ = 0;
+  double origin_ = 0;
+  double k_ = 0;
+  double w_est_ = 0;
+
+  // The smoothed RTT in seconds (0 until sampled): the window an ACK grows
+  // towards is where the cubic will be one RTT from now
+  double rtt_ = 0;
+
+  void reduce();
+
+ public:
+  explicit Cubic(uint64_t mss);
+
+  std::string_view name() const override { return "CUBIC"; }
+  uint64_t cwnd() const override { return cwnd_; }
+  uint64_t ssthresh() const override { return ssthresh_; }
+
+  void on_ack(uint64_t bytes_acked, uint64_t now_ms) override;
+  void on_loss(uint64_t bytes_in_flight, uint64_t now_ms) override;
+  void on_rto(uint64_t bytes_in_flight, uint64_t now_ms) override;
+  void on_rtt(double srtt_ms) override { rtt_ = srtt_ms / 1000; }
+};
@@ -0,0 +1,47 @@
+#include "eventloop_streams.hh"
+
+#include <memory>
+
+using namespace std;
+
+EventLoop::RuleHandle add_reader(EventLoop& loop, const FileDescriptor& fd,
+                                 Writer& stream,
+                                 EventLoop::CallbackT cancel) {
+  auto source = make_shared<FileDescriptor>(fd.duplicate());
+  return loop.add_rule(
+      fd, EventLoop::Direction::In,
+      [source, &stream] {
+        while (stream.available_capacity() > 0 &&
+               stream.push_from(*source) > 0) {
+        }
+        if (source->eof()) {
+          stream.close();
+        }
+      },
+      [&stream] {
+        return stream.available_capacity() > 0 && !stream.is_closed();
+      },
+      std::move(cancel));
+}
+
+EventLoop::RuleHandle add_writer(EventLoop& loop, const FileDescriptor& fd,
+                                 Reader& stream,
+                                 EventLoop::CallbackT cancel) {
+  auto sink = make_shared<FileDescriptor>(fd.duplicate());
+  auto handle = make_shared<EventLoop::RuleHandle>();
+  *handle = loop.add_rule(
+      fd, EventLoop::Direction::Out,
+      [sink, &stream, handle] {
+        while (stream.bytes_buffered() > 0 && stream.pop_to(*sink) > 0) {
+        }
+        if (stream.is_finished() || stream.has_error()) {
+          handle->cancel();
+        }
+      },
+      [&stream] {
+        return stream.bytes_buffered() > 0 || stream.is_finished() ||
+               stream.has_error();
+      },
+      std::move(cancel));
+  return *handle;
+}
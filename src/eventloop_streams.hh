@@ -0,0 +1,21 @@
+#pragma once
+
+#include "byte_stream.hh"
+#include "eventloop.hh"
+#include "file_descriptor.hh"
+
+// Rules that move a ByteStream's bytes to and from a file descriptor. They
+// live above both libraries: the EventLoop knows nothing of ByteStreams.
+
+// Read from `fd` into `stream` while it has room, closing it at EOF. Once the
+// stream has filled, call loop.notify(fd) after making room in it.
+EventLoop::RuleHandle add_reader(
+    EventLoop& loop, const FileDescriptor& fd, Writer& stream,
+    EventLoop::CallbackT cancel = [] {});
+
+// Write from `stream` to `fd` while it has bytes buffered. The rule is
+// removed once the stream is finished. Once the stream has run dry, call
+// loop.notify(fd) after pushing to (or closing) it.
+EventLoop::RuleHandle add_writer(
+    EventLoop& loop, const FileDescriptor& fd, Reader& stream,
+    EventLoop::CallbackT cancel = [] {});
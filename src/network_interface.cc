@@ -9,12 +9,46 @@ using namespace std;
 // interface ip_address: IP (what ARP calls "protocol") address of the interface
 NetworkInterface::NetworkInterface(const EthernetAddress& ethernet_address,
                                    const Address& ip_address)
-    : ethernet_address_(ethernet_address), ip_address_(ip_address) {
+    : NetworkInterface(ethernet_address, ip_address, nullptr) {}
+
+NetworkInterface::NetworkInterface(const EthernetAddress& ethernet_address,
+                                   const Address& ip_address,
+                                   TimingWheel& wheel)
+    : NetworkInterface(ethernet_address, ip_address, &wheel) {}
+
+NetworkInterface::NetworkInterface(const EthernetAddress& ethernet_address,
+                                   const Address& ip_address,
+                                   TimingWheel* shared_wheel)
+    : ethernet_address_(ethernet_address),
+      ip_address_(ip_address),
+      own_wheel_(shared_wheel == nullptr ? make_unique<TimingWheel>()
+                                         : nullptr),
+      wheel_(shared_wheel == nullptr ? own_wheel_.get() : shared_wheel),
+      timer_events_(make_unique<vector<TimerEvent>>()) {
   cerr << "DEBUG: Network interface has Ethernet address "
        << to_string(ethernet_address_) << " and IP address " << ip_address.ip()
        << "\n";
 }
 
+// Members are assigned in declaration order, which would free the old wheel
+// before the handles in the maps cancel their timers on it
+NetworkInterface& NetworkInterface::operator=(
+    NetworkInterface&& other) noexcept {
+  if (this != &other) {
+    arp_cache_.clear();
+    dgrams_.clear();
+    ethernet_address_ = other.ethernet_address_;
+    ip_address_ = other.ip_address_;
+    frames_ = std::move(other.frames_);
+    own_wheel_ = std::move(other.own_wheel_);
+    wheel_ = other.wheel_;
+    timer_events_ = std::move(other.timer_events_);
+    arp_cache_ = std::move(other.arp_cache_);
+    dgrams_ = std::move(other.dgrams_);
+  }
+  return *this;
+}
+
 // dgram: the IPv4 datagram to be sent
 // next_hop: the IP address of the interface to send it to (typically a router
 // or default gateway, but may also be another host if directly connected to the
@@ -24,6 +58,7 @@ NetworkInterface::NetworkInterface(const EthernetAddress& ethernet_address,
 // by using the Address::ipv4_numeric() method.
 void NetworkInterface::send_datagram(const InternetDatagram& dgram,
                                      const Address& next_hop) {
+  handle_timer_events();
   if (const auto it = arp_cache_.find(next_hop.ipv4_numeric());
       it != arp_cache_.end()) {
     // The destination Ethernet address is already known
@@ -40,13 +75,18 @@ void NetworkInterface::send_datagram(const InternetDatagram& dgram,
                    serialize(make_arp(ARPMessage::OPCODE_REQUEST, {},
                                       next_hop.ipv4_numeric()))));
     // Queue the datagram
-    dgrams_.emplace(next_hop.ipv4_numeric(), DatagramWithTimer{dgram, 0});
+    dgrams_.emplace(
+        next_hop.ipv4_numeric(),
+        DatagramWithTimer{dgram, schedule(TimerEvent::Kind::RetryRequest,
+                                          next_hop.ipv4_numeric(),
+                                          wheel_->now() + ARP_MESSAGE_TIMEOUT)});
   }
 }
 
 // frame: the incoming Ethernet frame
 optional<InternetDatagram> NetworkInterface::recv_frame(
     const EthernetFrame& frame) {
+  handle_timer_events();
   if (frame.header.type == EthernetHeader::TYPE_IPv4 &&
       frame.header.dst == ethernet_address_) {
     InternetDatagram dgram;
@@ -60,9 +100,15 @@ optional<InternetDatagram> NetworkInterface::recv_frame(
     ARPMessage arp;
     if (parse(arp, frame.payload)) {
       // Remember the mapping of sender
-      arp_cache_.emplace(
-          arp.sender_ip_address,
-          EthernetAddressWithTimer{arp.sender_ethernet_address, 0});
+      if (!arp_cache_.contains(arp.sender_ip_address)) {
+        arp_cache_.emplace(
+            arp.sender_ip_address,
+            EthernetAddressWithTimer{
+                arp.sender_ethernet_address,
+                schedule(TimerEvent::Kind::ExpireMapping,
+                         arp.sender_ip_address,
+                         wheel_->now() + MAX_LIFE_TIME)});
+      }
       // Send cached dgram
       if (const auto it = dgrams_.find(arp.sender_ip_address);
           it != dgrams_.end()) {
@@ -88,26 +134,44 @@ optional<InternetDatagram> NetworkInterface::recv_frame(
 // ms_since_last_tick: the number of milliseconds since the last call to this
 // method
 void NetworkInterface::tick(size_t ms_since_last_tick) {
-  for (auto it = arp_cache_.begin(); it != arp_cache_.end();) {
-    it->second.age_ += ms_since_last_tick;
-    if (it->second.age_ >= MAX_LIFE_TIME) {
-      it = arp_cache_.erase(it);
-    } else {
-      ++it;
-    }
+  if (own_wheel_) {
+    own_wheel_->advance(ms_since_last_tick);
   }
-  for (auto& dgram : dgrams_) {
-    dgram.second.time_ += ms_since_last_tick;
-    if (dgram.second.time_ >= ARP_MESSAGE_TIMEOUT) {
-      frames_.emplace(make_frame(
-          ETHERNET_BROADCAST, EthernetHeader::TYPE_ARP,
-          serialize(make_arp(ARPMessage::OPCODE_REQUEST, {}, dgram.first))));
-      dgram.second.time_ -= ARP_MESSAGE_TIMEOUT;
+  handle_timer_events();
+}
+
+TimingWheel::Handle NetworkInterface::schedule(TimerEvent::Kind kind,
+                                               uint32_t ip_address,
+                                               uint64_t deadline_ms) {
+  return wheel_->schedule_at(
+      deadline_ms,
+      [events = timer_events_.get(), wheel = wheel_, kind, ip_address] {
+        events->push_back({kind, ip_address, wheel->now()});
+      });
+}
+
+void NetworkInterface::handle_timer_events() {
+  for (const auto& event : *timer_events_) {
+    if (event.kind == TimerEvent::Kind::ExpireMapping) {
+      arp_cache_.erase(event.ip_address);
+      continue;
+    }
+    const auto it = dgrams_.find(event.ip_address);
+    if (it == dgrams_.end()) {
+      continue;
     }
+    frames_.emplace(make_frame(
+        ETHERNET_BROADCAST, EthernetHeader::TYPE_ARP,
+        serialize(make_arp(ARPMessage::OPCODE_REQUEST, {}, event.ip_address))));
+    it->second.retry_ =
+        schedule(TimerEvent::Kind::RetryRequest, event.ip_address,
+                 event.fired_ms + ARP_MESSAGE_TIMEOUT);
   }
+  timer_events_->clear();
 }
 
 optional<EthernetFrame> NetworkInterface::maybe_send() {
+  handle_timer_events();
   if (!frames_.empty()) {
     EthernetFrame frame = std::move(frames_.front());
     frames_.pop();
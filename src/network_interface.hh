@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <list>
+#include <memory>
 #include <optional>
 #include <queue>
 #include <unordered_map>
@@ -12,6 +13,7 @@
 #include "arp_message.hh"
 #include "ethernet_frame.hh"
 #include "ipv4_datagram.hh"
+#include "timing_wheel.hh"
 
 // A "network interface" that connects IP (the internet layer, or network layer)
 // with Ethernet (the network access layer, or link layer).
@@ -50,23 +52,40 @@ class NetworkInterface {
   // For EthernetFrame to be sent
   std::queue<EthernetFrame> frames_{};
 
+  // ARP entries expire, and ARP requests are retried, from timers on a
+  // timing wheel: the interface's own, or one shared with other interfaces.
+  // The wheel's callbacks only record which timer fired, in timer_events_
+  // (on the heap, so they still find it after the interface is moved);
+  // handle_timer_events() acts on them.
+  std::unique_ptr<TimingWheel> own_wheel_;
+  TimingWheel* wheel_;
+  struct TimerEvent {
+    enum class Kind : uint8_t { ExpireMapping, RetryRequest };
+    Kind kind;
+    uint32_t ip_address;
+    uint64_t fired_ms;
+  };
+  std::unique_ptr<std::vector<TimerEvent>> timer_events_;
+
   // For arp translation table
   struct EthernetAddressWithTimer {
     EthernetAddress ethernet_address_;
-    size_t age_;
+    TimingWheel::Handle expiry_;
 
-    EthernetAddressWithTimer(EthernetAddress ethernet_address, size_t age)
-        : ethernet_address_(ethernet_address), age_(age) {}
+    EthernetAddressWithTimer(EthernetAddress ethernet_address,
+                             TimingWheel::Handle expiry)
+        : ethernet_address_(ethernet_address), expiry_(std::move(expiry)) {}
   };
   std::unordered_map<uint32_t, EthernetAddressWithTimer> arp_cache_{};
 
   // For cached datagrams
   struct DatagramWithTimer {
     InternetDatagram dgram_;
-    size_t time_;
+    TimingWheel::Handle retry_;
 
-    DatagramWithTimer(InternetDatagram dgram, size_t time) noexcept
-        : dgram_(std::move(dgram)), time_(time) {}
+    DatagramWithTimer(InternetDatagram dgram,
+                      TimingWheel::Handle retry) noexcept
+        : dgram_(std::move(dgram)), retry_(std::move(retry)) {}
   };
   // 应当用两级hash，一级对ip,一级对datagram
   std::unordered_map<uint32_t, DatagramWithTimer> dgrams_{};
@@ -77,6 +96,18 @@ class NetworkInterface {
   NetworkInterface(const EthernetAddress& ethernet_address,
                    const Address& ip_address);
 
+  ~NetworkInterface() = default;
+  NetworkInterface(const NetworkInterface& other) = delete;
+  NetworkInterface& operator=(const NetworkInterface& other) = delete;
+  NetworkInterface(NetworkInterface&& other) = default;
+  // Cancels this interface's timers before its own wheel can go
+  NetworkInterface& operator=(NetworkInterface&& other) noexcept;
+
+  // Same, with its timers on `wheel`, which the owner advances (in place of
+  // calling tick()) and which must outlive the interface
+  NetworkInterface(const EthernetAddress& ethernet_address,
+                   const Address& ip_address, TimingWheel& wheel);
+
   // Access queue of Ethernet frames awaiting transmission
   std::optional<EthernetFrame> maybe_send();
 
@@ -95,12 +126,19 @@ class NetworkInterface {
   // fields.
   std::optional<InternetDatagram> recv_frame(const EthernetFrame& frame);
 
-  // Called periodically when time elapses
+  // Called periodically when time elapses (with the interface's own wheel)
   void tick(size_t ms_since_last_tick);
 
  private:
+  // With `shared_wheel` null, on a wheel of the interface's own
+  NetworkInterface(const EthernetAddress& ethernet_address,
+                   const Address& ip_address, TimingWheel* shared_wheel);
+
   ARPMessage make_arp(uint16_t opcode, EthernetAddress target_ethernet_address,
                       uint32_t target_ip_address_numeric) const;
+  TimingWheel::Handle schedule(TimerEvent::Kind kind, uint32_t ip_address,
+                               uint64_t deadline_ms);
+  void handle_timer_events();
   EthernetFrame make_frame(const EthernetAddress& dst, uint16_t type,
                            std::vector<Buffer> payload) const;
 };
\ No newline at end of file
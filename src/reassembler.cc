@@ -1,13 +1,46 @@
 #include "reassembler.hh"
 
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
 using namespace std;
 
+atomic<uint64_t> Reassembler::global_bytes_pending_{0};
+atomic<uint64_t> Reassembler::global_memory_budget_{UINT64_MAX};
+
 /*
 可以使用维护颜色段的方法实现，如珂朵莉树
 */
 
-void Reassembler::insert(uint64_t first_index, string data,
+void Reassembler::insert(uint64_t first_index, Buffer data,
                          bool is_last_substring, Writer& output) {
+  accept(first_index, std::move(data), is_last_substring, output, true);
+  finish_insert(output);
+}
+
+void Reassembler::insert_batch(span<Segment> segments, Writer& output) {
+  // In index order, in-order runs go straight to the Writer and the rest is
+  // stored without any flushing in between
+  sort(segments.begin(), segments.end(),
+       [](const Segment& a, const Segment& b) {
+         return a.first_index < b.first_index;
+       });
+  for (auto& segment : segments) {
+    accept(segment.first_index, std::move(segment.data),
+           segment.is_last_substring, output, false);
+  }
+
+  if (engine_ == Engine::Bitmap) {
+    flush_bitmap(output);
+  } else if (!substrings_.empty()) {
+    scan_storage(output);
+  }
+  finish_insert(output);
+}
+
+void Reassembler::accept(uint64_t first_index, Buffer data,
+                         bool is_last_substring, Writer& output, bool flush) {
   const uint64_t end_index = first_index + data.size();
   if (end_index < next_seq_num_) {
     return;
@@ -15,6 +48,34 @@ void Reassembler::insert(uint64_t first_index, string data,
   if (is_last_substring) {
     last_substring_end_index_ = end_index;
   }
+  if (first_index > next_seq_num_) {
+    note_recent(first_index);
+  }
+  if (first_index == next_seq_num_ && bytes_pending_ == 0 &&
+      data.size() <= output.available_capacity()) {
+    // In order with nothing stored: hand the payload straight to the Writer
+    next_seq_num_ = end_index;
+    output.push(std::move(data));
+  } else if (engine_ == Engine::Bitmap) {
+    store_in_bitmap(first_index, data, output);
+    if (flush) {
+      flush_bitmap(output);
+    }
+  } else {
+    insert_into_map(first_index, std::move(data), output);
+  }
+}
+
+void Reassembler::finish_insert(Writer& output) {
+  enforce_memory_budget();
+  if (output.bytes_pushed() == last_substring_end_index_) {
+    output.close();
+  }
+}
+
+void Reassembler::insert_into_map(uint64_t first_index, Buffer data,
+                                  Writer& output) {
+  const uint64_t end_index = first_index + data.size();
   if (first_index > next_seq_num_) {
     auto [success, hint] = fit_string(data, first_index);
     if (!success) {
@@ -23,40 +84,295 @@ void Reassembler::insert(uint64_t first_index, string data,
     if (!fit_space(data, output)) {
       return;
     }
+    fit_storage(data);
     bytes_pending_ += data.size();
     substrings_.emplace_hint(hint, first_index, std::move(data));
 
   } else {
     const auto max_space = min(space(output), end_index - next_seq_num_);
 
-    data.erase(0, next_seq_num_ - first_index).erase(max_space);
+    data.remove_prefix(next_seq_num_ - first_index);
+    data.truncate(max_space);
     output.push(std::move(data));
     next_seq_num_ += max_space;
 
-    scan_storage(output);
+    // Stored substrings the stream has now reached go out at once, even
+    // within a batch: left behind, they would still count against space()
+    // and cut short the in-order bytes after them
+    if (!substrings_.empty()) {
+      scan_storage(output);
+    }
   }
-  if (output.bytes_pushed() == last_substring_end_index_) {
-    output.close();
+}
+
+void Reassembler::store_in_bitmap(uint64_t first_index, const Buffer& data,
+                                  const Writer& output) {
+  const uint64_t window = output.available_capacity();
+  if (window > ring_.size()) {
+    grow_ring(window);
+  }
+  const uint64_t begin = max(first_index, next_seq_num_);
+  const uint64_t end = min(first_index + data.size(), next_seq_num_ + window);
+  if (begin >= end) {
+    return;
   }
+
+  // Copy the bytes into place, in at most two pieces around the end of ring_
+  const auto bytes =
+      string_view{data}.substr(begin - first_index, end - begin);
+  const uint64_t mask = ring_.size() - 1;
+  const uint64_t slot = begin & mask;
+  const uint64_t first = min(bytes.size(), ring_.size() - slot);
+  memcpy(ring_.data() + slot, bytes.data(), first);
+  memcpy(ring_.data(), bytes.data() + first, bytes.size() - first);
+  bytes_pending_ +=
+      set_present(slot, first) + set_present(0, bytes.size() - first);
 }
 
-bool Reassembler::fit_space(std::string& data, const Writer& output) {
+// Write out the contiguous prefix, if there is one now
+void Reassembler::flush_bitmap(Writer& output) {
+  if (ring_.empty()) {
+    return;
+  }
+  const uint64_t head = next_seq_num_ & (ring_.size() - 1);
+  const uint64_t len = contiguous_present(head);
+  if (len == 0) {
+    return;
+  }
+  const uint64_t len_to_end = min(len, ring_.size() - head);
+  output.push(string_view{ring_.data() + head, len_to_end});
+  output.push(string_view{ring_.data(), len - len_to_end});
+  clear_present(head, len_to_end);
+  clear_present(0, len - len_to_end);
+  bytes_pending_ -= len;
+  next_seq_num_ += len;
+}
+
+// The budgets count the bytes stored, so a stored slice must not pin much
+// more than that: a few bytes of a full segment's frame get their own
+// storage instead. What is left over is within twice the bytes charged.
+void Reassembler::fit_storage(Buffer& data) {
+  if (data.capacity() > 2 * data.size() + ChunkPool::MIN_CLASS_SIZE) {
+    data.compact();
+  }
+}
+
+bool Reassembler::fit_space(Buffer& data, const Writer& output) {
   if (data.size() > space(output)) {
     return false;
   }
   if (data.size() == space(output)) {
-    data.pop_back();
+    data.truncate(data.size() - 1);
   }
   return true;
 }
 
 uint64_t Reassembler::bytes_pending() const { return bytes_pending_; }
 
+void Reassembler::set_global_memory_budget(uint64_t bytes) {
+  global_memory_budget_.store(bytes, memory_order_relaxed);
+}
+
+uint64_t Reassembler::global_bytes_pending() {
+  return global_bytes_pending_.load(memory_order_relaxed);
+}
+
+void Reassembler::enforce_memory_budget() {
+  global_charge_.update(bytes_pending_);
+
+  uint64_t excess =
+      bytes_pending_ > memory_budget_ ? bytes_pending_ - memory_budget_ : 0;
+  const uint64_t global = global_bytes_pending();
+  const uint64_t global_budget =
+      global_memory_budget_.load(memory_order_relaxed);
+  if (global > global_budget) {
+    excess = max(excess, global - global_budget);
+  }
+  excess = min(excess, bytes_pending_);
+  if (excess == 0) {
+    return;
+  }
+
+  if (engine_ == Engine::Bitmap) {
+    evict_from_bitmap(excess);
+  } else {
+    evict_from_map(excess);
+  }
+  bytes_pending_ -= excess;
+  ++eviction_stats_.evictions;
+  eviction_stats_.bytes += excess;
+  global_charge_.update(bytes_pending_);
+}
+
+// Drop `bytes` stored bytes, starting from the end of the last substring
+void Reassembler::evict_from_map(uint64_t bytes) {
+  while (bytes > 0) {
+    const auto last = prev(substrings_.end());
+    const uint64_t size = last->second.size();
+    if (size <= bytes) {
+      substrings_.erase(last);
+      bytes -= size;
+    } else {
+      last->second.truncate(size - bytes);
+      fit_storage(last->second);
+      bytes = 0;
+    }
+  }
+}
+
+// Drop `bytes` present slots, scanning down from the end of the window
+void Reassembler::evict_from_bitmap(uint64_t bytes) {
+  const uint64_t mask = ring_.size() - 1;
+  for (uint64_t end = next_seq_num_ + ring_.size(); bytes > 0;) {
+    const uint64_t slot = end & mask;
+    const uint64_t bits = slot % 64 == 0 ? 64 : slot % 64;
+    const uint64_t word_index = ((end - 1) & mask) / 64;
+    // The `bits` slots just below `end`, moved to the top of the word
+    const uint64_t word = present_[word_index] << (64 - bits);
+    if (word == 0) {
+      end -= bits;
+      continue;
+    }
+    end -= countl_zero(word);
+    const uint64_t run =
+        min(bytes, contiguous_present_before(end & mask));
+    const uint64_t first_slot = (end - run) & mask;
+    const uint64_t len_to_end = min(run, ring_.size() - first_slot);
+    clear_present(first_slot, len_to_end);
+    clear_present(0, run - len_to_end);
+    bytes -= run;
+    end -= run;
+  }
+}
+
+Reassembler::GlobalCharge::GlobalCharge(const GlobalCharge& other)
+    : bytes_(other.bytes_) {
+  global_bytes_pending_.fetch_add(bytes_, memory_order_relaxed);
+}
+
+Reassembler::GlobalCharge& Reassembler::GlobalCharge::operator=(
+    const GlobalCharge& other) {
+  update(other.bytes_);
+  return *this;
+}
+
+Reassembler::GlobalCharge::~GlobalCharge() {
+  global_bytes_pending_.fetch_sub(bytes_, memory_order_relaxed);
+}
+
+void Reassembler::GlobalCharge::update(uint64_t bytes) {
+  if (bytes != bytes_) {
+    // Unsigned wraparound makes this a subtraction when `bytes` is smaller
+    global_bytes_pending_.fetch_add(bytes - bytes_, memory_order_relaxed);
+    bytes_ = bytes;
+  }
+}
+
+vector<Reassembler::Range> Reassembler::sack_blocks(size_t max_blocks) const {
+  vector<Range> blocks;
+  const auto add = [&](const Range& range) {
+    if (find(blocks.begin(), blocks.end(), range) == blocks.end()) {
+      blocks.push_back(range);
+    }
+  };
+
+  for (size_t i = 0; i < recent_count_ && blocks.size() < max_blocks; ++i) {
+    if (recent_[i] < next_seq_num_) {
+      continue;
+    }
+    if (const auto range = stored_range_containing(recent_[i])) {
+      add(*range);
+    }
+  }
+  for (uint64_t from = next_seq_num_; blocks.size() < max_blocks;) {
+    const auto range = next_stored_range(from);
+    if (!range) {
+      break;
+    }
+    add(*range);
+    from = range->second;
+  }
+  return blocks;
+}
+
+void Reassembler::note_recent(uint64_t first_index) {
+  copy_backward(recent_.begin(), recent_.end() - 1, recent_.end());
+  recent_.front() = first_index;
+  recent_count_ = min(recent_count_ + 1, MAX_RECENT);
+}
+
+optional<Reassembler::Range> Reassembler::stored_range_containing(
+    uint64_t index) const {
+  if (engine_ == Engine::Bitmap) {
+    if (index < next_seq_num_ || index >= next_seq_num_ + ring_.size()) {
+      return nullopt;
+    }
+    const uint64_t slot = index & (ring_.size() - 1);
+    if (!is_present(slot)) {
+      return nullopt;
+    }
+    // The slot for next_seq_num_ is never present, so neither scan can run
+    // past the window
+    return Range{index - contiguous_present_before(slot),
+                 index + contiguous_present(slot)};
+  }
+
+  auto it = substrings_.upper_bound(index);
+  if (it == substrings_.begin() || end_index_of(prev(it)) <= index) {
+    return nullopt;
+  }
+  --it;
+  // Stored substrings never overlap, but they can be adjacent
+  Range range{it->first, end_index_of(it)};
+  for (auto left = it; left != substrings_.begin() &&
+                       end_index_of(prev(left)) == range.first;) {
+    --left;
+    range.first = left->first;
+  }
+  for (auto right = next(it);
+       right != substrings_.end() && right->first == range.second; ++right) {
+    range.second = end_index_of(right);
+  }
+  return range;
+}
+
+optional<Reassembler::Range> Reassembler::next_stored_range(
+    uint64_t from) const {
+  if (engine_ == Engine::Bitmap) {
+    const uint64_t mask = ring_.size() - 1;
+    for (uint64_t i = max(from, next_seq_num_);
+         i < next_seq_num_ + ring_.size();) {
+      const uint64_t slot = i & mask;
+      const uint64_t word = present_[slot / 64] >> (slot % 64);
+      if (word == 0) {
+        i += 64 - slot % 64;
+        continue;
+      }
+      i += countr_zero(word);
+      if (i >= next_seq_num_ + ring_.size()) {
+        break;
+      }
+      return Range{i, i + contiguous_present(i & mask)};
+    }
+    return nullopt;
+  }
+
+  auto it = substrings_.lower_bound(from);
+  if (it == substrings_.end()) {
+    return nullopt;
+  }
+  Range range{it->first, end_index_of(it)};
+  for (++it; it != substrings_.end() && it->first == range.second; ++it) {
+    range.second = end_index_of(it);
+  }
+  return range;
+}
+
 uint64_t Reassembler::space(const Writer& writer) const {
   return writer.available_capacity() - bytes_pending_;
 }
 
-std::pair<bool, MapIt_t> Reassembler::fit_string(std::string& data,
+std::pair<bool, MapIt_t> Reassembler::fit_string(Buffer& data,
                                                  uint64_t& first_index) {
   if (substrings_.empty()) {
     return {true, substrings_.end()};
@@ -75,7 +391,7 @@ std::pair<bool, MapIt_t> Reassembler::fit_string(std::string& data,
         return {false, {}};
       }
       // cut off the overlapping part
-      data.erase(0, end_index_it - first_index);
+      data.remove_prefix(end_index_it - first_index);
       first_index = end_index_it;
     }
     // whether the first_index is updated or not,
@@ -106,7 +422,7 @@ std::pair<bool, MapIt_t> Reassembler::fit_string(std::string& data,
   while (it->first < end_index) {
     if (end_index_of(it) >= end_index) {
       end_index = it->first;
-      data.erase(end_index - first_index);
+      data.truncate(end_index - first_index);
       break;
     }
     it = erase_substring_by(it);
@@ -117,7 +433,7 @@ std::pair<bool, MapIt_t> Reassembler::fit_string(std::string& data,
   return {true, it};
 }
 
-uint64_t Reassembler::end_index_of(MapIt_t it) {
+uint64_t Reassembler::end_index_of(Substrings_t::const_iterator it) {
   return it->first + it->second.size();
 }
 
@@ -126,7 +442,8 @@ void Reassembler::scan_storage(Writer& writer) {
        it != substrings_.end() && it->first <= next_seq_num_;) {
     auto end_index = end_index_of(it);
     if (end_index > next_seq_num_) {
-      writer.push(std::move(it->second.erase(0, next_seq_num_ - it->first)));
+      it->second.remove_prefix(next_seq_num_ - it->first);
+      writer.push(std::move(it->second));
       next_seq_num_ = end_index;
       // do not use erase_substring_by(), it->second is moved and thus its size
       // is changed
@@ -141,4 +458,95 @@ void Reassembler::scan_storage(Writer& writer) {
 MapIt_t Reassembler::erase_substring_by(MapIt_t it) {
   bytes_pending_ -= it->second.size();
   return substrings_.erase(it);
-}
\ No newline at end of file
+}
+
+void Reassembler::grow_ring(uint64_t window) {
+  const uint64_t size = max<uint64_t>(bit_ceil(window), 64);
+  string ring(size, 0);
+  vector<uint64_t> present(size / 64);
+
+  // Move any pending bytes to their slots in the larger ring
+  const uint64_t old_mask = ring_.size() - 1;
+  for (uint64_t i = next_seq_num_; i < next_seq_num_ + ring_.size(); ++i) {
+    const uint64_t old_slot = i & old_mask;
+    if (is_present(old_slot)) {
+      const uint64_t slot = i & (size - 1);
+      ring[slot] = ring_[old_slot];
+      present[slot / 64] |= 1ULL << (slot % 64);
+    }
+  }
+
+  ring_.swap(ring);
+  present_.swap(present);
+}
+
+// Mark [slot, slot + len) present, returning how many bits were newly set.
+// The range must not wrap around the end of ring_.
+uint64_t Reassembler::set_present(uint64_t slot, uint64_t len) {
+  uint64_t newly_set = 0;
+  while (len > 0) {
+    const uint64_t bit = slot % 64;
+    const uint64_t n = min(len, 64 - bit);
+    const uint64_t mask = (n == 64 ? ~0ULL : (1ULL << n) - 1) << bit;
+    newly_set += popcount(mask & ~present_[slot / 64]);
+    present_[slot / 64] |= mask;
+    slot += n;
+    len -= n;
+  }
+  return newly_set;
+}
+
+// Mark [slot, slot + len) absent. The range must not wrap.
+void Reassembler::clear_present(uint64_t slot, uint64_t len) {
+  while (len > 0) {
+    const uint64_t bit = slot % 64;
+    const uint64_t n = min(len, 64 - bit);
+    const uint64_t mask = (n == 64 ? ~0ULL : (1ULL << n) - 1) << bit;
+    present_[slot / 64] &= ~mask;
+    slot += n;
+    len -= n;
+  }
+}
+
+// The number of consecutive present slots starting at `slot` (wrapping),
+// counted a whole bitmap word at a time
+uint64_t Reassembler::contiguous_present(uint64_t slot) const {
+  uint64_t total = 0;
+  while (total < ring_.size()) {
+    const uint64_t bit = slot % 64;
+    // Bits shifted in from the top are zero, which ends the run
+    const uint64_t ones = countr_one(present_[slot / 64] >> bit);
+    total += ones;
+    if (ones < 64 - bit) {
+      break;
+    }
+    slot = (slot + ones) & (ring_.size() - 1);
+  }
+  return min<uint64_t>(total, ring_.size());
+}
+
+// The number of consecutive present slots ending just before `slot`
+// (wrapping)
+uint64_t Reassembler::contiguous_present_before(uint64_t slot) const {
+  uint64_t total = 0;
+  while (total < ring_.size()) {
+    uint64_t word_index = slot / 64;
+    uint64_t bits = slot % 64;
+    if (bits == 0) {
+      word_index = (word_index + present_.size() - 1) % present_.size();
+      bits = 64;
+    }
+    // Keep only the `bits` low bits, moved to the top
+    const uint64_t ones = countl_one(present_[word_index] << (64 - bits));
+    total += ones;
+    if (ones < bits) {
+      break;
+    }
+    slot = word_index * 64;
+  }
+  return min<uint64_t>(total, ring_.size());
+}
+
+bool Reassembler::is_present(uint64_t slot) const {
+  return (present_[slot / 64] >> (slot % 64)) & 1U;
+}
@@ -1,26 +1,93 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <climits>
 #include <map>
+#include <optional>
+#include <span>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "byte_stream.hh"
 
-using MapIt_t = std::map<uint64_t, std::string>::iterator;
+using Substrings_t =
+    std::map<uint64_t, Buffer, std::less<>,
+             PoolAllocator<std::pair<const uint64_t, Buffer>>>;
+using MapIt_t = Substrings_t::iterator;
 
 class Reassembler {
+ public:
+  // How out-of-order bytes are stored.
+  //   Map: substrings keyed by first index, trimmed so they never overlap.
+  //   Bitmap: a ring buffer indexed by stream index, with one presence bit
+  //           per byte; inserting is a copy plus a bitmap update, and the
+  //           contiguous prefix is found 64 bits at a time.
+  enum class Engine { Map, Bitmap };
+
  private:
-  std::map<uint64_t, std::string> substrings_{};
+  Engine engine_;
+
+  // Engine::Map
+  // Stored substrings are slices of the inserted Buffers; a slice much
+  // smaller than its storage is copied out so it does not pin the rest
+  Substrings_t substrings_{};
+
+  // Engine::Bitmap
+  // Byte i of the stream lives at ring_[i & (ring_.size() - 1)]; the size is
+  // a power of two, grown as the window (available capacity) grows
+  std::string ring_{};
+  std::vector<uint64_t> present_{};
+
   uint64_t next_seq_num_ = 0;
   uint64_t bytes_pending_ = 0;
   uint64_t last_substring_end_index_ = UINT64_MAX;
 
+  // This Reassembler's share of the count of bytes stored by all
+  // Reassemblers; copies add their share and destruction removes it
+  class GlobalCharge {
+    uint64_t bytes_ = 0;
+
+   public:
+    GlobalCharge() = default;
+    GlobalCharge(const GlobalCharge& other);
+    GlobalCharge& operator=(const GlobalCharge& other);
+    ~GlobalCharge();
+    void update(uint64_t bytes);
+  };
+
+  static std::atomic<uint64_t> global_bytes_pending_;
+  static std::atomic<uint64_t> global_memory_budget_;
+
+  uint64_t memory_budget_ = UINT64_MAX;
+  GlobalCharge global_charge_{};
+
+ public:
+  struct EvictionStats {
+    uint64_t evictions{};  // inserts after which stored bytes were dropped
+    uint64_t bytes{};      // stored bytes dropped in total
+  };
+
+ private:
+  EvictionStats eviction_stats_{};
+
+  // First indices of the latest out-of-order insertions, newest first
+  static constexpr size_t MAX_RECENT = 8;
+  std::array<uint64_t, MAX_RECENT> recent_{};
+  size_t recent_count_ = 0;
+
  public:
+  // A range of stream indices [first, end)
+  using Range = std::pair<uint64_t, uint64_t>;
+
+  explicit Reassembler(Engine engine = Engine::Map) : engine_(engine) {}
+
   /*
    * Insert a new substring to be reassembled into a ByteStream.
    *   `first_index`: the index of the first byte of the substring
-   *   `data`: the substring itself
+   *   `data`: the substring itself (shared, not copied, on its way into the
+   *           Writer)
    *   `is_last_substring`: this substring represents the end of the stream
    *   `output`: a mutable reference to the Writer
    *
@@ -39,21 +106,83 @@ class Reassembler {
    *
    * The Reassembler should close the stream after writing the last byte.
    */
-  void insert(uint64_t first_index, std::string data, bool is_last_substring,
+  void insert(uint64_t first_index, Buffer data, bool is_last_substring,
               Writer& output);
 
+  // One substring of a burst for insert_batch()
+  struct Segment {
+    uint64_t first_index{};
+    Buffer data{};
+    bool is_last_substring{};
+  };
+
+  /*
+   * Insert a burst of substrings (e.g. from recvmmsg or GRO), writing the same
+   * bytes as inserting them one at a time, in order of first index, would.
+   * They are all merged into storage before the contiguous prefix is written
+   * to the Writer, so the per-insert work is done once per burst. The
+   * segments are reordered by first index and their payloads moved from.
+   */
+  void insert_batch(std::span<Segment> segments, Writer& output);
+
   // How many bytes are stored in the Reassembler itself?
   uint64_t bytes_pending() const;
 
+  /*
+   * Up to `max_blocks` of the contiguous ranges stored past the next needed
+   * byte, for selective acknowledgment. As RFC 2018 asks, the range holding
+   * the most recently inserted segment comes first and the others follow in
+   * order of recency; any room left is filled in stream order.
+   */
+  std::vector<Range> sack_blocks(size_t max_blocks) const;
+
+  /*
+   * Bounds on the bytes held out of order, per Reassembler and across all of
+   * them (both unlimited by default). When an insert takes this Reassembler
+   * past either budget, it drops the stored ranges farthest from the next
+   * needed byte until it is back under, or until it stores nothing. Dropped
+   * bytes are simply re-requested, as if they had never arrived.
+   */
+  void set_memory_budget(uint64_t bytes) { memory_budget_ = bytes; }
+  static void set_global_memory_budget(uint64_t bytes);
+  static uint64_t global_bytes_pending();
+  const EvictionStats& eviction_stats() const { return eviction_stats_; }
+
  private:
+  void accept(uint64_t first_index, Buffer data, bool is_last_substring,
+              Writer& output, bool flush);
+  void finish_insert(Writer& output);
+
+  void insert_into_map(uint64_t first_index, Buffer data, Writer& output);
+  void store_in_bitmap(uint64_t first_index, const Buffer& data,
+                       const Writer& output);
+  void flush_bitmap(Writer& output);
+
   uint64_t space(const Writer& writer) const;
 
-  std::pair<bool, MapIt_t> fit_string(std::string& data, uint64_t& first_index);
-  bool fit_space(std::string& data, const Writer& output);
+  std::pair<bool, MapIt_t> fit_string(Buffer& data, uint64_t& first_index);
+  bool fit_space(Buffer& data, const Writer& output);
+  static void fit_storage(Buffer& data);
 
   MapIt_t erase_substring_by(MapIt_t it);
 
   void scan_storage(Writer& writer);
 
-  static uint64_t end_index_of(MapIt_t it);
+  static uint64_t end_index_of(Substrings_t::const_iterator it);
+
+  void enforce_memory_budget();
+  void evict_from_map(uint64_t bytes);
+  void evict_from_bitmap(uint64_t bytes);
+
+  void note_recent(uint64_t first_index);
+  std::optional<Range> stored_range_containing(uint64_t index) const;
+  std::optional<Range> next_stored_range(uint64_t from) const;
+
+  // Engine::Bitmap helpers; slots are positions in ring_
+  void grow_ring(uint64_t window);
+  uint64_t set_present(uint64_t slot, uint64_t len);
+  void clear_present(uint64_t slot, uint64_t len);
+  uint64_t contiguous_present(uint64_t slot) const;
+  uint64_t contiguous_present_before(uint64_t slot) const;
+  bool is_present(uint64_t slot) const;
 };
@@ -19,7 +19,7 @@ class AsyncNetworkInterface : public NetworkInterface {
 
   // Construct from a NetworkInterface
   explicit AsyncNetworkInterface(NetworkInterface&& interface)
-      : NetworkInterface(interface) {}
+      : NetworkInterface(std::move(interface)) {}
 
   // \brief Receives and Ethernet frame and responds appropriately.
 
@@ -0,0 +1,158 @@
+#include "tcp_peer.hh"
+
+#include <vector>
+
+using namespace std;
+
+TCPPeer::TCPPeer(const TCPConfig& config)
+    : config_(config),
+      outbound_(config.send_capacity),
+      inbound_(config.recv_capacity),
+      sender_(config),
+      receiver_(config) {}
+
+// Does `a` tell the sender nothing that `b` did not?
+static bool same_ack(const TCPReceiverMessage& a,
+                     const TCPReceiverMessage& b) {
+  if (a.ackno != b.ackno || a.window() != b.window() ||
+      a.sack_blocks.size() != b.sack_blocks.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.sack_blocks.size(); ++i) {
+    if (a.sack_blocks[i].left_edge != b.sack_blocks[i].left_edge ||
+        a.sack_blocks[i].right_edge != b.sack_blocks[i].right_edge) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void TCPPeer::receive(TCPSegment segment) { receive(span{&segment, 1}); }
+
+void TCPPeer::receive(span<TCPSegment> segments) {
+  if (!active()) {
+    return;
+  }
+  last_receipt_ms_ = now_ms_;
+
+  // Flags and acknowledgments segment by segment, in order; the data goes
+  // to the receiver together, for one insert into the Reassembler
+  vector<TCPSenderMessage> data;
+  data.reserve(segments.size());
+  for (auto& segment : segments) {
+    if (segment.reset) {
+      reset_sent_ = true;  // never answer a RST with one
+      outbound_.writer().set_error();
+      inbound_.writer().set_error();
+      return;
+    }
+
+    TCPSenderMessage& message = segment.sender_message;
+    TCPReceiverMessage& ack = segment.receiver_message;
+    if (message.SYN) {
+      connecting_ = true;
+      // Scaling is on only if both SYNs offer it; a SYN's window is unscaled
+      if (config_.window_scaling && message.window_scale.has_value()) {
+        peer_window_shift_ =
+            min(message.window_scale.value(), TCPConfig::MAX_WINDOW_SHIFT);
+      }
+    } else {
+      ack.window_shift = peer_window_shift_;
+    }
+
+    // A segment carrying data is no duplicate ACK (RFC 5681): the sender
+    // only sees its acknowledgment if it says something new
+    if (message.sequence_length() == 0 || !last_ack_.has_value() ||
+        !same_ack(ack, last_ack_.value())) {
+      sender_.receive(ack);
+      last_ack_ = move(ack);
+    }
+    if (message.sequence_length() > 0) {
+      data.push_back(move(message));
+    }
+  }
+  receiver_.receive(span{data}, reassembler_, inbound_.writer());
+
+  // The peer closed first: nothing of ours is left for it to retransmit
+  // a FIN after
+  if (inbound_.writer().is_closed() && !sender_.FIN_queued()) {
+    linger_after_streams_finish_ = false;
+  }
+}
+
+void TCPPeer::tick(uint64_t ms_since_last_tick) {
+  now_ms_ += ms_since_last_tick;
+  sender_.tick(ms_since_last_tick);
+  receiver_.tick(ms_since_last_tick, inbound_.writer());
+  if (sender_.consecutive_retransmissions() > TCPConfig::MAX_RETX_ATTEMPTS) {
+    outbound_.writer().set_error();
+    inbound_.writer().set_error();
+  }
+}
+
+TCPSegment TCPPeer::make_segment(TCPSenderMessage message) {
+  TCPSegment segment;
+  segment.receiver_message =
+      receiver_.piggyback(inbound_.writer(), reassembler_, message.SYN);
+  if (message.SYN) {
+    segment.mss = static_cast<uint16_t>(min<uint64_t>(UINT16_MAX, config_.mss));
+    segment.sack_permitted = config_.sack;
+  }
+  segment.push = !message.payload.empty();
+  segment.sender_message = move(message);
+  return segment;
+}
+
+size_t TCPPeer::drain_outbound(span<TCPSegment> segments) {
+  if (segments.empty() || reset_sent_) {
+    return 0;
+  }
+  if (has_error()) {
+    segments[0] = make_segment(sender_.send_empty_message());
+    segments[0].reset = true;
+    reset_sent_ = true;
+    return 1;
+  }
+
+  if (connecting_) {
+    sender_.push(outbound_.reader());
+  }
+  size_t count = 0;
+  while (count < segments.size()) {
+    auto message = sender_.maybe_send();
+    if (!message.has_value()) {
+      break;
+    }
+    segments[count++] = make_segment(move(message.value()));
+  }
+  if (count > 0 || !connecting_) {
+    return count;
+  }
+
+  // Nothing to carry the ACK: send it on its own, if one is due
+  auto ack = receiver_.maybe_send(inbound_.writer(), reassembler_);
+  if (!ack.has_value()) {
+    return 0;
+  }
+  segments[0] = {};
+  segments[0].sender_message = sender_.send_empty_message();
+  segments[0].receiver_message = move(ack.value());
+  return 1;
+}
+
+bool TCPPeer::has_error() const {
+  return outbound_.reader().has_error() || inbound_.reader().has_error();
+}
+
+bool TCPPeer::active() const {
+  if (has_error()) {
+    return false;
+  }
+  const bool sender_active =
+      !sender_.FIN_queued() || sender_.sequence_numbers_in_flight() > 0;
+  const bool receiver_active = !inbound_.writer().is_closed();
+  const bool lingering =
+      linger_after_streams_finish_ &&
+      now_ms_ < last_receipt_ms_ + 10 * uint64_t{config_.rt_timeout};
+  return sender_active || receiver_active || lingering;
+}
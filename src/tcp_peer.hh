@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include "byte_stream.hh"
+#include "reassembler.hh"
+#include "tcp_config.hh"
+#include "tcp_receiver.hh"
+#include "tcp_segment.hh"
+#include "tcp_sender.hh"
+
+/*
+ * One endpoint of a TCP connection: a TCPSender and TCPReceiver, the
+ * Reassembler, and the outbound and inbound ByteStreams, driven together.
+ *
+ * The owner feeds arriving segments to receive(), passes the time to tick(),
+ * and collects what to send with drain_outbound(). Segments come out with
+ * their sequence numbers, flags, window and options set; the ports and
+ * checksum are left to the owner.
+ *
+ * ACKs ride on outgoing data where there is any. Segments received between
+ * two drain_outbound() calls are acknowledged together, by one ACK, so a
+ * burst of arrivals is handled as a batch.
+ */
+class TCPPeer {
+ private:
+  TCPConfig config_;
+  ByteStream outbound_;
+  ByteStream inbound_;
+  Reassembler reassembler_{};
+  TCPSender sender_;
+  TCPReceiver receiver_;
+
+  // Has the SYN been allowed out: by connect(), or the peer's SYN?
+  bool connecting_ = false;
+  // Shift for the peer's windows, once its SYN and ours both offered scaling
+  uint8_t peer_window_shift_ = 0;
+  // The last acknowledgment passed to the sender
+  std::optional<TCPReceiverMessage> last_ack_{};
+
+  bool reset_sent_ = false;
+  uint64_t now_ms_ = 0;  // sum of tick()s
+  uint64_t last_receipt_ms_ = 0;
+  // TIME_WAIT: after both streams have finished, stay to acknowledge a
+  // retransmitted FIN. Not needed by the side whose peer closed first.
+  bool linger_after_streams_finish_ = true;
+
+  bool has_error() const;
+  TCPSegment make_segment(TCPSenderMessage message);
+
+ public:
+  /* A peer with the streams, sender and receiver settings of `config` */
+  explicit TCPPeer(const TCPConfig& config);
+
+  /* Open the connection: let the SYN go out. Without this, the peer waits
+   * for the other side's SYN. */
+  void connect() { connecting_ = true; }
+
+  /* Act on a segment from the other peer (already checked and parsed) */
+  void receive(TCPSegment segment);
+
+  /* As above, for a burst of segments: flags and acknowledgments are acted
+   * on one segment at a time, and the payloads all go into the Reassembler
+   * at once */
+  void receive(std::span<TCPSegment> segments);
+
+  /* Time has passed by the given # of milliseconds since the last tick().
+   * The connection is reset after too many consecutive retransmissions. */
+  void tick(uint64_t ms_since_last_tick);
+
+  /* Fill `segments` with what is ready to send, returning how many. Call
+   * again while it fills the whole span. */
+  size_t drain_outbound(std::span<TCPSegment> segments);
+
+  /* Is the connection still alive: a stream not finished, or lingering? */
+  bool active() const;
+
+  Writer& outbound_writer() { return outbound_.writer(); }
+  const Writer& outbound_writer() const { return outbound_.writer(); }
+  Reader& inbound_reader() { return inbound_.reader(); }
+  const Reader& inbound_reader() const { return inbound_.reader(); }
+
+  /* Accessors for use in testing */
+  const TCPSender& sender() const { return sender_; }
+  const TCPReceiver& receiver() const { return receiver_; }
+};
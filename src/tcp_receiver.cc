@@ -1,7 +1,21 @@
 #include "tcp_receiver.hh"
 
+#include <vector>
+
 using namespace std;
 
+TCPReceiver::TCPReceiver(const TCPConfig& config) {
+  if (config.window_scaling) {
+    offered_window_shift_ = config.window_shift();
+  }
+  delayed_ack_ = config.delayed_ack;
+  delayed_ack_ms_ = config.delayed_ack_ms;
+  mss_ = config.mss;
+  auto_tune_ = config.auto_tune_recv;
+  min_capacity_ = config.recv_capacity;
+  max_capacity_ = max(config.recv_capacity, config.max_recv_capacity);
+}
+
 /*
  * The message can have both the FIN bit and the SYN bit set, and possibly carry
  * payload. Reset the isn_ if receive a new SYN (i.e. a SYN message with new
@@ -17,10 +31,21 @@ using namespace std;
 void TCPReceiver::receive(TCPSenderMessage message, Reassembler& reassembler,
                           Writer& inbound_stream) {
   if (isn_.has_value() && message.seqno == isn_) {
+    // A duplicate SYN: acknowledge it again
+    schedule_ack(message, false);
     return;
   }
+  if (shrink_edge_.has_value()) {
+    shrink(inbound_stream);
+  }
+  const uint64_t pushed_before = inbound_stream.bytes_pushed();
+  const uint64_t pending_before = reassembler.bytes_pending();
   if (message.SYN) {
     isn_ = message.seqno;
+    window_shift_ = offered_window_shift_.has_value() &&
+                            message.window_scale.has_value()
+                        ? offered_window_shift_.value()
+                        : 0;
     ackno_ = isn_.value() + message.sequence_length();
     reassembler.insert(0, message.payload, message.FIN, inbound_stream);
   } else if (isn_.has_value()) {
@@ -38,13 +63,256 @@ void TCPReceiver::receive(TCPSenderMessage message, Reassembler& reassembler,
     ackno_ = ackno_ + 1;
     inbound_stream.close();
   }
+  if (isn_.has_value()) {
+    // In order: all of the payload went straight into the stream, with no
+    // hole before or after it
+    const bool in_order =
+        inbound_stream.bytes_pushed() - pushed_before ==
+            message.payload.size() &&
+        pending_before == 0 && reassembler.bytes_pending() == 0;
+    schedule_ack(message, in_order);
+    holes_ = reassembler.bytes_pending() > 0;
+    if (!message.payload.empty()) {
+      last_data_ms_ = now_ms_;
+      if (auto_tune_) {
+        right_size(inbound_stream);
+      }
+    }
+  }
+}
+
+void TCPReceiver::receive(span<TCPSenderMessage> messages,
+                          Reassembler& reassembler, Writer& inbound_stream) {
+  if (shrink_edge_.has_value()) {
+    shrink(inbound_stream);
+  }
+  const uint64_t pushed_before = inbound_stream.bytes_pushed();
+  const uint64_t pending_before = reassembler.bytes_pending();
+  vector<Reassembler::Segment> batch;
+  batch.reserve(messages.size());
+  vector<const TCPSenderMessage*> accepted;
+  accepted.reserve(messages.size());
+  uint64_t payload_bytes = 0;
+  for (const auto& message : messages) {
+    if (isn_.has_value() && message.seqno == isn_) {
+      // A duplicate SYN: acknowledge it again
+      schedule_ack(message, false);
+      continue;
+    }
+    uint64_t first_index = 0;
+    if (message.SYN) {
+      isn_ = message.seqno;
+      window_shift_ = offered_window_shift_.has_value() &&
+                              message.window_scale.has_value()
+                          ? offered_window_shift_.value()
+                          : 0;
+    } else if (isn_.has_value()) {
+      // absolute seqno to streamindex, so needed to minus 1
+      first_index =
+          message.seqno.unwrap(isn_.value(), inbound_stream.bytes_pushed()) -
+          1;
+    } else {
+      continue;
+    }
+    if (message.FIN) {
+      FIN_seqno_ = message.seqno + (message.sequence_length() - 1);
+    }
+    // Buffers share their storage: the message keeps its payload
+    batch.push_back({first_index, message.payload, message.FIN});
+    accepted.push_back(&message);
+    payload_bytes += message.payload.size();
+  }
+  if (batch.empty()) {
+    return;
+  }
+
+  reassembler.insert_batch(batch, inbound_stream);
+  // streamindex to absolute seqno, so needed to plus 1
+  ackno_ = Wrap32::wrap(inbound_stream.bytes_pushed() + 1, isn_.value());
+  if (FIN_seqno_.has_value() && FIN_seqno_ == ackno_) {
+    ackno_ = ackno_ + 1;
+    inbound_stream.close();
+  }
+
+  const bool in_order =
+      inbound_stream.bytes_pushed() - pushed_before == payload_bytes &&
+      pending_before == 0 && reassembler.bytes_pending() == 0;
+  for (const auto* message : accepted) {
+    schedule_ack(*message, in_order);
+  }
+  holes_ = reassembler.bytes_pending() > 0;
+  if (payload_bytes > 0) {
+    last_data_ms_ = now_ms_;
+    if (auto_tune_) {
+      right_size(inbound_stream);
+    }
+  }
+}
+
+void TCPReceiver::right_size(Writer& inbound_stream) {
+  const uint64_t pushed = inbound_stream.bytes_pushed();
+  const uint64_t popped = inbound_stream.reader().bytes_popped();
+  if (!rtt_ms_.has_value() && !rtt_mark_.has_value()) {
+    measure_start_ms_ = now_ms_;
+    measure_start_popped_ = popped;
+  }
+  if (rtt_mark_.has_value() && pushed >= rtt_mark_->stream_index) {
+    // A window's worth arrived: the smaller samples are the better ones
+    const uint64_t sample = max<uint64_t>(now_ms_ - rtt_mark_->ms, 1);
+    rtt_ms_ = !rtt_ms_.has_value() || sample < rtt_ms_.value()
+                  ? sample
+                  : (7 * rtt_ms_.value() + sample) / 8;
+    rtt_mark_.reset();
+  }
+  if (!rtt_mark_.has_value()) {
+    // A full window past what has arrived
+    rtt_mark_ = RTTMark{pushed + inbound_stream.capacity(), now_ms_};
+  }
+
+  const uint64_t elapsed = now_ms_ - measure_start_ms_;
+  if (!rtt_ms_.has_value() || elapsed < rtt_ms_.value()) {
+    return;
+  }
+  const uint64_t drained_per_rtt =
+      (popped - measure_start_popped_) * rtt_ms_.value() / elapsed;
+  measure_start_ms_ = now_ms_;
+  measure_start_popped_ = popped;
+  const uint64_t target = min(max_capacity_, 2 * drained_per_rtt);
+  if (target > inbound_stream.capacity()) {
+    inbound_stream.set_capacity(target);
+    shrink_edge_.reset();
+  }
+}
+
+void TCPReceiver::shrink(Writer& inbound_stream) {
+  // Room up to the held edge and no further; never below what is buffered,
+  // as the edge is never behind the bytes pushed
+  const uint64_t popped = inbound_stream.reader().bytes_popped();
+  const uint64_t capacity = max(min_capacity_, shrink_edge_.value() - popped);
+  inbound_stream.set_capacity(capacity);
+  if (capacity == min_capacity_) {
+    shrink_edge_.reset();
+  }
+}
+
+void TCPReceiver::schedule_ack(const TCPSenderMessage& message,
+                               bool in_order) {
+  if (message.sequence_length() == 0) {
+    return;
+  }
+  unacked_segments_ += 1;
+  if (!delayed_ack_ || !in_order || message.SYN || message.FIN) {
+    ack_now_ = true;
+    return;
+  }
+  unacked_bytes_ += message.payload.size();
+  if (unacked_bytes_ >= 2 * mss_) {
+    ack_now_ = true;
+  } else if (!ack_delayed_ms_.has_value()) {
+    ack_delayed_ms_ = 0;
+  }
+}
+
+void TCPReceiver::tick(uint64_t ms_since_last_tick) {
+  now_ms_ += ms_since_last_tick;
+  if (ack_delayed_ms_.has_value()) {
+    ack_delayed_ms_ = ack_delayed_ms_.value() + ms_since_last_tick;
+  }
+}
+
+void TCPReceiver::tick(uint64_t ms_since_last_tick, Writer& inbound_stream) {
+  tick(ms_since_last_tick);
+  if (shrink_edge_.has_value()) {
+    shrink(inbound_stream);
+    return;
+  }
+  if (!auto_tune_ || holes_ || inbound_stream.capacity() <= min_capacity_ ||
+      inbound_stream.available_capacity() < inbound_stream.capacity() ||
+      now_ms_ - last_data_ms_ < TCPConfig::RECV_IDLE_MS) {
+    return;
+  }
+  // Idle, and drained: give the memory back as the peer uses up the window
+  // it may have been offered, and measure afresh when data comes again
+  shrink_edge_ = inbound_stream.bytes_pushed() + inbound_stream.capacity();
+  rtt_mark_.reset();
+  measure_start_ms_ = now_ms_;
+  measure_start_popped_ = inbound_stream.reader().bytes_popped();
+}
+
+// The window to offer, in bytes, before scaling
+uint64_t TCPReceiver::room(const Writer& inbound_stream) const {
+  const uint64_t available = inbound_stream.available_capacity();
+  if (!shrink_edge_.has_value()) {
+    return available;
+  }
+  // Shrinking: bytes the application has read since the last tick do not
+  // reopen the window
+  const uint64_t pushed = inbound_stream.bytes_pushed();
+  return min(available,
+             shrink_edge_.value() > pushed ? shrink_edge_.value() - pushed : 0);
 }
 
 TCPReceiverMessage TCPReceiver::send(const Writer& inbound_stream) const {
+  // Rounded down to the scale's granularity, never overstating the room
   const uint16_t window_size =
-      min(MAX_RWND_SIZE, inbound_stream.available_capacity());
+      min(MAX_RWND_SIZE, room(inbound_stream) >> window_shift_);
   if (!isn_.has_value()) {
     return {{}, window_size};
   }
-  return {ackno_, window_size};
+  return {ackno_, window_size, {}, window_shift_};
+}
+
+TCPReceiverMessage TCPReceiver::send(const Writer& inbound_stream,
+                                     const Reassembler& reassembler) const {
+  TCPReceiverMessage message = send(inbound_stream);
+  if (!isn_.has_value()) {
+    return message;
+  }
+  // stream index to absolute seqno, so needed to plus 1
+  for (const auto& [first, end] : reassembler.sack_blocks(MAX_SACK_BLOCKS)) {
+    message.sack_blocks.push_back(
+        {Wrap32::wrap(first + 1, isn_.value()),
+         Wrap32::wrap(end + 1, isn_.value())});
+  }
+  return message;
+}
+
+optional<TCPReceiverMessage> TCPReceiver::maybe_send(
+    const Writer& inbound_stream, const Reassembler& reassembler) {
+  TCPReceiverMessage message = send(inbound_stream, reassembler);
+  const uint64_t window = message.window();
+  const bool window_update =
+      isn_.has_value() &&
+      (window >= last_window_ + mss_ || (last_window_ == 0 && window > 0));
+  const bool timer_expired = ack_delayed_ms_.has_value() &&
+                             ack_delayed_ms_.value() >= delayed_ack_ms_;
+  if (!ack_now_ && !window_update && !timer_expired) {
+    return {};
+  }
+  ack_sent(window);
+  return message;
+}
+
+TCPReceiverMessage TCPReceiver::piggyback(const Writer& inbound_stream,
+                                          const Reassembler& reassembler,
+                                          bool syn) {
+  TCPReceiverMessage message = send(inbound_stream, reassembler);
+  if (syn) {
+    message.window_size = min(MAX_RWND_SIZE, room(inbound_stream));
+    message.window_shift = 0;
+  }
+  if (isn_.has_value()) {
+    ack_sent(message.window());
+  }
+  return message;
+}
+
+void TCPReceiver::ack_sent(uint64_t window) {
+  acks_sent_ += 1;
+  acks_suppressed_ += unacked_segments_ > 1 ? unacked_segments_ - 1 : 0;
+  ack_now_ = false;
+  unacked_bytes_ = 0;
+  unacked_segments_ = 0;
+  ack_delayed_ms_.reset();
+  last_window_ = window;
 }
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <span>
+
 #include "reassembler.hh"
+#include "tcp_config.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 
 #define MAX_RWND_SIZE ((1UL << 16) - 1)
+// The most SACK blocks that fit in the TCP options space
+#define MAX_SACK_BLOCKS 4
 
 class TCPReceiver {
  private:
@@ -12,7 +17,69 @@ class TCPReceiver {
   std::optional<Wrap32> FIN_seqno_{};
   Wrap32 ackno_{0};
 
+  // Window scaling (RFC 7323): the shift our own SYN offered, if any, and
+  // the one in effect, nonzero once the peer's SYN has offered scaling too
+  std::optional<uint8_t> offered_window_shift_{};
+  uint8_t window_shift_ = 0;
+
+  // Delayed ACKs (RFC 1122, RFC 5681): in-order data is acknowledged every
+  // second full-sized segment, or once the oldest unacknowledged segment
+  // has waited delayed_ack_ms_. Anything else is acknowledged at once.
+  bool delayed_ack_ = false;
+  uint64_t delayed_ack_ms_ = 0;
+  uint64_t mss_ = TCPConfig::MAX_PAYLOAD_SIZE;
+  bool ack_now_ = false;
+  uint64_t unacked_bytes_ = 0;     // in-order payload awaiting an ACK
+  uint64_t unacked_segments_ = 0;  // segments awaiting an ACK
+  std::optional<uint64_t> ack_delayed_ms_{};  // how long they have waited
+  uint64_t last_window_ = 0;                  // as of the last ACK sent
+  uint64_t acks_sent_ = 0;
+  uint64_t acks_suppressed_ = 0;
+
+  // Receive-buffer auto-tuning (dynamic right-sizing, as in Linux): about
+  // once per round trip, the inbound stream grows to twice what the
+  // application drained from it per round trip, up to max_capacity_. After
+  // RECV_IDLE_MS without data, and once drained, it shrinks back to
+  // min_capacity_, but no faster than the window already advertised is used
+  // up: the right edge is held at shrink_edge_, not reopened as the stream
+  // drains. The round trip is estimated as the time taken to receive a full
+  // buffer of data.
+  struct RTTMark {
+    uint64_t stream_index;  // a full buffer past what had arrived at `ms`
+    uint64_t ms;
+  };
+  bool auto_tune_ = false;
+  uint64_t min_capacity_ = 0;
+  uint64_t max_capacity_ = 0;
+  uint64_t now_ms_ = 0;  // sum of tick()s
+  uint64_t last_data_ms_ = 0;
+  bool holes_ = false;  // is the reassembler holding bytes?
+  std::optional<RTTMark> rtt_mark_{};
+  std::optional<uint64_t> rtt_ms_{};
+  uint64_t measure_start_ms_ = 0;
+  uint64_t measure_start_popped_ = 0;
+  std::optional<uint64_t> shrink_edge_{};  // stream index, while shrinking
+
+  void schedule_ack(const TCPSenderMessage& message, bool in_order);
+  void ack_sent(uint64_t window);
+  uint64_t room(const Writer& inbound_stream) const;
+  void right_size(Writer& inbound_stream);
+  void shrink(Writer& inbound_stream);
+
  public:
+  TCPReceiver() = default;
+
+  /*
+   * A TCPReceiver that scales its advertised windows by 2^window_shift, if
+   * the peer's SYN carries the window scale option. `window_shift` must be
+   * the shift offered in this side's own SYN (TCPConfig::window_shift()).
+   */
+  explicit TCPReceiver(uint8_t window_shift)
+      : offered_window_shift_(window_shift) {}
+
+  /* A TCPReceiver with the window scaling and delayed ACKs of `config`. */
+  explicit TCPReceiver(const TCPConfig& config);
+
   /*
    * The TCPReceiver receives TCPSenderMessages, inserting their payload into
    * the Reassembler at the correct stream index.
@@ -20,6 +87,47 @@ class TCPReceiver {
   void receive(TCPSenderMessage message, Reassembler& reassembler,
                Writer& inbound_stream);
 
+  /*
+   * As above, for a burst of messages. The payloads go into the Reassembler
+   * with one insert_batch(), and whether an ACK is due is worked out once
+   * for the burst: in order only if all of it went straight into the stream.
+   */
+  void receive(std::span<TCPSenderMessage> messages, Reassembler& reassembler,
+               Writer& inbound_stream);
+
   /* The TCPReceiver sends TCPReceiverMessages back to the TCPSender. */
   TCPReceiverMessage send(const Writer& inbound_stream) const;
+
+  /* As above, also reporting the out-of-order ranges held by `reassembler`
+   * as SACK blocks. */
+  TCPReceiverMessage send(const Writer& inbound_stream,
+                          const Reassembler& reassembler) const;
+
+  /* As above, but only when an ACK is due: for every segment received,
+   * unless delayed ACKs hold it back, or when the window has opened by at
+   * least one MSS (or from zero) since the last ACK. */
+  std::optional<TCPReceiverMessage> maybe_send(const Writer& inbound_stream,
+                                               const Reassembler& reassembler);
+
+  /* The acknowledgment to carry on an outgoing data segment. It stands in
+   * for any ACK maybe_send() would otherwise have sent. On a SYN, pass
+   * `syn`: the window then goes unscaled (RFC 7323), and is recorded so. */
+  TCPReceiverMessage piggyback(const Writer& inbound_stream,
+                               const Reassembler& reassembler,
+                               bool syn = false);
+
+  /* Time has passed: a delayed ACK may now be due. */
+  void tick(uint64_t ms_since_last_tick);
+
+  /* As above; with auto-tuning, also shrink the capacity of an idle stream.
+   * It shrinks as the peer uses up the window already advertised, which is
+   * never retracted. */
+  void tick(uint64_t ms_since_last_tick, Writer& inbound_stream);
+
+  /* The round-trip time estimate auto-tuning uses, once there is one */
+  std::optional<uint64_t> rtt_ms() const { return rtt_ms_; }
+
+  uint64_t acks_sent() const { return acks_sent_; }
+  /* Segments acknowledged only by the ACK of a later one */
+  uint64_t acks_suppressed() const { return acks_suppressed_; }
 };
@@ -0,0 +1,267 @@
+#include "tcp_segment.hh"
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <sstream>
+#include <string_view>
+
+#include "checksum.hh"
+
+using namespace std;
+
+static constexpr size_t SACK_BLOCK_LENGTH = 8;
+
+// Each option is laid out as Linux does, padded with NOPs in front to a
+// multiple of 4 bytes: MSS (4), SACK-permitted and timestamps (4 or 12),
+// window scale (4), then SACK (4 + 8 per block).
+size_t TCPSegment::sack_blocks_sent() const {
+  size_t length = mss.has_value() ? 4 : 0;
+  length += timestamps.has_value() ? 12 : (sack_permitted ? 4 : 0);
+  length += sender_message.window_scale.has_value() ? 4 : 0;
+  if (length + 4 + SACK_BLOCK_LENGTH > MAX_OPTIONS_LENGTH) {
+    return 0;
+  }
+  return min(receiver_message.sack_blocks.size(),
+             (MAX_OPTIONS_LENGTH - length - 4) / SACK_BLOCK_LENGTH);
+}
+
+size_t TCPSegment::header_length() const {
+  size_t length = LENGTH;
+  length += mss.has_value() ? 4 : 0;
+  length += timestamps.has_value() ? 12 : (sack_permitted ? 4 : 0);
+  length += sender_message.window_scale.has_value() ? 4 : 0;
+  const size_t sack_blocks = sack_blocks_sent();
+  length += sack_blocks > 0 ? 4 + sack_blocks * SACK_BLOCK_LENGTH : 0;
+  return length;
+}
+
+void TCPSegment::serialize(Serializer& serializer) const {
+  serializer.integer(sport);
+  serializer.integer(dport);
+  serializer.integer(sender_message.seqno.raw_value());
+  serializer.integer(receiver_message.ackno.has_value()
+                         ? receiver_message.ackno.value().raw_value()
+                         : uint32_t{0});
+
+  const uint8_t data_offset = header_length() / 4;
+  serializer.integer(static_cast<uint8_t>(data_offset << 4));
+  const uint8_t flags = (sender_message.FIN ? FLAG_FIN : 0) |
+                        (sender_message.SYN ? FLAG_SYN : 0) |
+                        (reset ? FLAG_RST : 0) | (push ? FLAG_PSH : 0) |
+                        (receiver_message.ackno.has_value() ? FLAG_ACK : 0);
+  serializer.integer(flags);
+  serializer.integer(receiver_message.window_size);
+  serializer.integer(cksum);
+  serializer.integer(uint16_t{0});  // urgent pointer
+
+  if (mss.has_value()) {
+    serializer.integer(OPTION_MSS);
+    serializer.integer(uint8_t{4});
+    serializer.integer(mss.value());
+  }
+  if (timestamps.has_value()) {
+    if (sack_permitted) {
+      serializer.integer(OPTION_SACK_PERMITTED);
+      serializer.integer(uint8_t{2});
+    } else {
+      serializer.integer(OPTION_NOP);
+      serializer.integer(OPTION_NOP);
+    }
+    serializer.integer(OPTION_TIMESTAMPS);
+    serializer.integer(uint8_t{10});
+    serializer.integer(timestamps->value);
+    serializer.integer(timestamps->echo_reply);
+  } else if (sack_permitted) {
+    serializer.integer(OPTION_NOP);
+    serializer.integer(OPTION_NOP);
+    serializer.integer(OPTION_SACK_PERMITTED);
+    serializer.integer(uint8_t{2});
+  }
+  if (sender_message.window_scale.has_value()) {
+    serializer.integer(OPTION_NOP);
+    serializer.integer(OPTION_WINDOW_SCALE);
+    serializer.integer(uint8_t{3});
+    serializer.integer(sender_message.window_scale.value());
+  }
+  const size_t sack_blocks = sack_blocks_sent();
+  if (sack_blocks > 0) {
+    serializer.integer(OPTION_NOP);
+    serializer.integer(OPTION_NOP);
+    serializer.integer(OPTION_SACK);
+    serializer.integer(static_cast<uint8_t>(2 + sack_blocks * 8));
+    for (size_t i = 0; i < sack_blocks; ++i) {
+      const auto& block = receiver_message.sack_blocks[i];
+      serializer.integer(block.left_edge.raw_value());
+      serializer.integer(block.right_edge.raw_value());
+    }
+  }
+
+  if (!sender_message.payload.empty()) {
+    serializer.buffer(sender_message.payload);
+  }
+}
+
+// Read the options in `options` into `segment`. Unknown options are skipped;
+// returns false if any is malformed.
+static bool parse_options(string_view options, TCPSegment& segment) {
+  const auto u8 = [&](size_t i) { return static_cast<uint8_t>(options[i]); };
+  const auto u16 = [&](size_t i) {
+    return static_cast<uint16_t>(u8(i) << 8 | u8(i + 1));
+  };
+  const auto u32 = [&](size_t i) {
+    return static_cast<uint32_t>(u16(i)) << 16 | u16(i + 2);
+  };
+
+  size_t i = 0;
+  while (i < options.size()) {
+    const uint8_t kind = u8(i);
+    if (kind == TCPSegment::OPTION_END) {
+      return true;
+    }
+    if (kind == TCPSegment::OPTION_NOP) {
+      ++i;
+      continue;
+    }
+    if (i + 1 >= options.size()) {
+      return false;
+    }
+    const uint8_t length = u8(i + 1);
+    if (length < 2 || i + length > options.size()) {
+      return false;
+    }
+    switch (kind) {
+      case TCPSegment::OPTION_MSS:
+        if (length != 4) {
+          return false;
+        }
+        segment.mss = u16(i + 2);
+        break;
+      case TCPSegment::OPTION_WINDOW_SCALE:
+        if (length != 3) {
+          return false;
+        }
+        segment.sender_message.window_scale = u8(i + 2);
+        break;
+      case TCPSegment::OPTION_SACK_PERMITTED:
+        if (length != 2) {
+          return false;
+        }
+        segment.sack_permitted = true;
+        break;
+      case TCPSegment::OPTION_SACK:
+        if ((length - 2) % SACK_BLOCK_LENGTH != 0) {
+          return false;
+        }
+        for (size_t j = i + 2; j < i + length; j += SACK_BLOCK_LENGTH) {
+          segment.receiver_message.sack_blocks.push_back(
+              {Wrap32{u32(j)}, Wrap32{u32(j + 4)}});
+        }
+        break;
+      case TCPSegment::OPTION_TIMESTAMPS:
+        if (length != 10) {
+          return false;
+        }
+        segment.timestamps = TCPSegment::Timestamps{u32(i + 2), u32(i + 6)};
+        break;
+      default:
+        break;
+    }
+    i += length;
+  }
+  return true;
+}
+
+void TCPSegment::parse(Parser& parser,
+                       uint32_t datagram_layer_pseudo_checksum) {
+  // Verify checksum, over the whole segment as it arrived
+  InternetChecksum check{datagram_layer_pseudo_checksum};
+  parser.input().for_each([&](string_view data) { check.add(data); });
+  if (check.value() != 0) {
+    parser.set_error();
+    return;
+  }
+
+  *this = {};
+  parser.integer(sport);
+  parser.integer(dport);
+  uint32_t seqno{};
+  parser.integer(seqno);
+  uint32_t ackno{};
+  parser.integer(ackno);
+  uint8_t data_offset{};
+  parser.integer(data_offset);
+  data_offset >>= 4;
+  uint8_t flags{};
+  parser.integer(flags);
+  parser.integer(receiver_message.window_size);
+  parser.integer(cksum);
+  uint16_t urgent_pointer{};
+  parser.integer(urgent_pointer);
+
+  if (data_offset * 4 < LENGTH) {
+    parser.set_error();
+    return;
+  }
+  array<char, MAX_OPTIONS_LENGTH> options{};
+  const size_t options_length = data_offset * 4 - LENGTH;
+  parser.string(span{options.data(), options_length});
+  if (parser.has_error()) {
+    return;
+  }
+  if (!parse_options({options.data(), options_length}, *this)) {
+    parser.set_error();
+    return;
+  }
+
+  sender_message.seqno = Wrap32{seqno};
+  sender_message.SYN = flags & FLAG_SYN;
+  sender_message.FIN = flags & FLAG_FIN;
+  reset = flags & FLAG_RST;
+  push = flags & FLAG_PSH;
+  if (flags & FLAG_ACK) {
+    receiver_message.ackno = Wrap32{ackno};
+  }
+  parser.all_remaining(sender_message.payload);
+}
+
+void TCPSegment::compute_checksum(uint32_t datagram_layer_pseudo_checksum) {
+  cksum = 0;
+  Serializer s;
+  serialize(s);
+
+  InternetChecksum check{datagram_layer_pseudo_checksum};
+  check.add(s.output());
+  cksum = check.value();
+}
+
+string TCPSegment::to_string() const {
+  stringstream ss{};
+  ss << "TCP " << sport << " > " << dport
+     << ", seqno=" << sender_message.seqno.raw_value();
+  if (receiver_message.ackno.has_value()) {
+    ss << ", ackno=" << receiver_message.ackno.value().raw_value();
+  }
+  ss << ", win=" << receiver_message.window_size;
+  ss << (sender_message.SYN ? ", SYN" : "")
+     << (sender_message.FIN ? ", FIN" : "") << (reset ? ", RST" : "")
+     << (push ? ", PSH" : "");
+  if (mss.has_value()) {
+    ss << ", mss=" << mss.value();
+  }
+  if (sender_message.window_scale.has_value()) {
+    ss << ", wscale=" << +sender_message.window_scale.value();
+  }
+  if (sack_permitted) {
+    ss << ", sackOK";
+  }
+  if (!receiver_message.sack_blocks.empty()) {
+    ss << ", sack=" << receiver_message.sack_blocks.size();
+  }
+  if (timestamps.has_value()) {
+    ss << ", TS val " << timestamps->value << " ecr "
+       << timestamps->echo_reply;
+  }
+  ss << ", payload_len=" << sender_message.payload.size();
+  return ss.str();
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "parser.hh"
+#include "tcp_receiver_message.hh"
+#include "tcp_sender_message.hh"
+
+// A TCP segment (RFC 9293) as it travels inside an IPv4 datagram: one peer's
+// TCPSenderMessage and TCPReceiverMessage, with the header fields and options
+// around them.
+//
+// The TCPSenderMessage gives the sequence number, SYN, FIN, payload and (on a
+// SYN) the window scale option. The TCPReceiverMessage gives the ACK flag and
+// ackno, the window and the SACK blocks. Its window_shift is not on the wire:
+// parse() leaves it zero, for the caller to set from what was negotiated.
+struct TCPSegment {
+  static constexpr size_t LENGTH = 20;  // TCP header length, without options
+  static constexpr size_t MAX_OPTIONS_LENGTH = 40;
+
+  static constexpr uint8_t FLAG_FIN = 0x01;
+  static constexpr uint8_t FLAG_SYN = 0x02;
+  static constexpr uint8_t FLAG_RST = 0x04;
+  static constexpr uint8_t FLAG_PSH = 0x08;
+  static constexpr uint8_t FLAG_ACK = 0x10;
+  static constexpr uint8_t FLAG_URG = 0x20;
+
+  static constexpr uint8_t OPTION_END = 0;
+  static constexpr uint8_t OPTION_NOP = 1;
+  static constexpr uint8_t OPTION_MSS = 2;
+  static constexpr uint8_t OPTION_WINDOW_SCALE = 3;
+  static constexpr uint8_t OPTION_SACK_PERMITTED = 4;
+  static constexpr uint8_t OPTION_SACK = 5;
+  static constexpr uint8_t OPTION_TIMESTAMPS = 8;
+
+  /*
+   *   0                   1                   2                   3
+   *   0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |          Source Port          |       Destination Port        |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |                        Sequence Number                        |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |                    Acknowledgment Number                      |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |  Data |       |C|E|U|A|P|R|S|F|                               |
+   *  | Offset| Rsrvd |W|C|R|C|S|S|Y|I|            Window             |
+   *  |       |       |R|E|G|K|H|T|N|N|                               |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |           Checksum            |         Urgent Pointer        |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |                    Options                    |    Padding    |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   */
+
+  struct Timestamps {
+    uint32_t value{};       // TSval: the sender's clock
+    uint32_t echo_reply{};  // TSecr: the TSval most recently received
+  };
+
+  uint16_t sport = 0;  // source port
+  uint16_t dport = 0;  // destination port
+  TCPSenderMessage sender_message{};
+  TCPReceiverMessage receiver_message{};
+  bool reset = false;  // RST flag
+  bool push = false;   // PSH flag
+  uint16_t cksum = 0;  // checksum field
+
+  // Options, besides the window scale (sender_message) and SACK blocks
+  // (receiver_message). On serialize(), SACK blocks that do not fit in the
+  // options space are left out.
+  std::optional<uint16_t> mss{};           // maximum segment size, on a SYN
+  bool sack_permitted = false;             // on a SYN (RFC 2018)
+  std::optional<Timestamps> timestamps{};  // RFC 7323
+
+  // Length of the header, options included
+  size_t header_length() const;
+
+  // Set checksum to correct value, given the IPv4 header's pseudo_checksum()
+  void compute_checksum(uint32_t datagram_layer_pseudo_checksum);
+
+  // Return a string containing a header in human-readable format
+  std::string to_string() const;
+
+  // Parse a segment, checking its checksum against the IPv4 header's
+  // pseudo_checksum()
+  void parse(Parser& parser, uint32_t datagram_layer_pseudo_checksum);
+  // Serialize the segment (does not recompute the checksum)
+  void serialize(Serializer& serializer) const;
+
+ private:
+  // How many SACK blocks serialize() includes
+  size_t sack_blocks_sent() const;
+};
@@ -11,50 +11,136 @@ TCPSender::TCPSender(uint64_t initial_RTO_ms, optional<Wrap32> fixed_isn)
     : isn_(fixed_isn.value_or(Wrap32{random_device()()})),
       timer_(make_unique<Timer>(initial_RTO_ms)) {}
 
+TCPSender::TCPSender(const TCPConfig& config)
+    : TCPSender(config.rt_timeout, config.fixed_isn) {
+  mss_ = config.mss;
+  super_segments_ = config.super_segments;
+  hold_unacked_ = config.hold_unacked;
+  if (config.window_scaling) {
+    window_scale_offer_ = config.window_shift();
+  }
+  pacer_ = Pacer{mss_};
+  congestion_controller_ =
+      CongestionController::make(config.congestion_control, mss_);
+  fast_retransmit_ = config.fast_retransmit;
+  // The scoreboard tracks whole queued messages, too coarse for super-segments
+  sack_ = config.sack && config.fast_retransmit && !super_segments_;
+  pacing_ = config.pacing;
+  pacing_gain_ = config.pacing_gain;
+  adaptive_rto_ = config.adaptive_rto;
+  if (adaptive_rto_) {
+    min_rto_ms_ = config.min_rto_ms;
+    max_rto_ms_ = config.max_rto_ms;
+  }
+}
+
 optional<TCPSenderMessage> TCPSender::maybe_send() {
+  sync_clock();
   if (retransmit_flag_ && has_outstanding_segment()) {
     timer_->run();
     retransmit_flag_ = false;
-    return segments_.front();
+    rtt_probe_.reset();
+    // Resend from the first unacked sequence number, no more than was sent
+    const TCPSenderMessage& front = segments_.front();
+    const uint64_t sent =
+        next_segment_ > 0 ? front.sequence_length() : sent_offset_;
+    return slice(front, 0, min(sent, slice_length(front, 0)));
   }
-  if (has_cached_segment()) {
+  if (in_fast_recovery_ && sack_) {
+    const auto hole = next_hole();
+    const uint64_t cwnd = congestion_controller_
+                              ? congestion_controller_->cwnd()
+                              : UINT64_MAX;
+    if (hole.has_value() && pipe() < cwnd && pacer_.ready()) {
+      timer_->run();
+      rtt_probe_.reset();
+      ScoreboardEntry entry = scoreboard_[hole.value()];
+      entry.retransmitted = true;
+      set_entry(hole.value(), entry);
+      pacer_.consume(segments_[hole.value()].sequence_length());
+      return segments_[hole.value()];
+    }
+  }
+  if (has_cached_segment() && pacer_.ready()) {
     timer_->run();
-    return segments_[next_segment_++];
+    const TCPSenderMessage& queued = segments_[next_segment_];
+    const TCPSenderMessage msg =
+        slice(queued, sent_offset_, slice_length(queued, sent_offset_));
+    sent_offset_ += msg.sequence_length();
+    pipe_ += msg.sequence_length();
+    if (sent_offset_ == queued.sequence_length()) {
+      sent_offset_ = 0;
+      next_segment_ += 1;
+    }
+    pacer_.consume(msg.sequence_length());
+    highest_sent_ =
+        msg.seqno.unwrap(isn_, absolute_seqno_) + msg.sequence_length();
+    if (!rtt_probe_.has_value()) {
+      rtt_probe_ = {highest_sent_, now_ms_};
+    }
+    return msg;
   }
   return {};
 }
 
 void TCPSender::push(Reader& outbound_stream) {
+  sync_clock();
+  if (hold_unacked_) {
+    // Release what has been acked since the last push
+    outbound_stream.pop(acked_unpopped_bytes_);
+    held_bytes_ -= acked_unpopped_bytes_;
+    acked_unpopped_bytes_ = 0;
+  }
   uint64_t window_size = remaining_window_size_;
   if (window_size == 0 && can_use_magic_) {
     can_use_magic_ = false;
     window_size = 1;
   }
-  while (window_size > 0) {
+  // Room left in the congestion window, on top of the receiver's window
+  uint64_t cwnd_room = UINT64_MAX;
+  if (congestion_controller_) {
+    const uint64_t cwnd =
+        congestion_controller_->cwnd() + recovery_inflation_;
+    // Resending the holes comes before any new data, and so does what is
+    // queued already
+    const uint64_t outstanding =
+        in_fast_recovery_ && sack_
+            ? pipe_ + hole_bytes_ + (absolute_seqno_ - highest_sent_)
+            : sequence_numbers_in_flight_;
+    cwnd_room = cwnd > outstanding ? cwnd - outstanding : 0;
+  }
+  while (window_size > 0 && cwnd_room > 0) {
     TCPSenderMessage msg{};
+    // Bytes in the stream not yet in a segment
+    const uint64_t unsent = outbound_stream.bytes_buffered() - held_bytes_;
 
     // Deal with SYN
     if (absolute_seqno_ == 0) {
       window_size -= 1;
+      cwnd_room -= 1;
       msg.SYN = true;
+      msg.window_scale = window_scale_offer_;
     }
 
-    // Deal with payload
-    uint64_t payload_size = min({TCPConfig::MAX_PAYLOAD_SIZE, window_size,
-                                 outbound_stream.bytes_buffered()});
+    // Deal with payload, a slice of the stream's own storage where possible
+    const uint64_t max_payload =
+        super_segments_ ? mss_ * TCPConfig::SUPER_SEGMENT_MSS : mss_;
+    const uint64_t payload_size =
+        min({max_payload, window_size, cwnd_room, unsent});
     if (payload_size > 0) {
-      string payload{};
-      read(outbound_stream, payload_size, payload);
-      window_size -= payload.size();
-      msg.payload = std::move(payload);
+      msg.payload = outbound_stream.peek_buffer(held_bytes_, payload_size);
+      window_size -= payload_size;
+      cwnd_room -= payload_size;
     }
 
     // Deal with FIN
-    if (window_size > 0 && outbound_stream.is_finished() &&
+    if (window_size > 0 && cwnd_room > 0 &&
+        outbound_stream.writer().is_closed() && payload_size == unsent &&
         !pre_segment_has_FIN_) {
       msg.FIN = true;
       pre_segment_has_FIN_ = true;
       window_size--;
+      cwnd_room--;
     }
     if (msg.sequence_length() == 0) {
       return;
@@ -64,10 +150,19 @@ void TCPSender::push(Reader& outbound_stream) {
       return;
     }
 
+    // The segment keeps its payload alive: the stream either drops it now,
+    // or holds it too until it is acked
+    if (hold_unacked_) {
+      held_bytes_ += payload_size;
+    } else {
+      outbound_stream.pop(payload_size);
+    }
+
     msg.seqno = Wrap32::wrap(absolute_seqno_, isn_);
     absolute_seqno_ += msg.sequence_length();
     sequence_numbers_in_flight_ += msg.sequence_length();
     segments_.push_back(std::move(msg));
+    scoreboard_.emplace_back();
 
     remaining_window_size_ = window_size;
   }
@@ -78,6 +173,7 @@ TCPSenderMessage TCPSender::send_empty_message() const {
 }
 
 void TCPSender::receive(const TCPReceiverMessage& msg) {
+  sync_clock();
   uint64_t current_unwraped_ackno = 0;
 
   // The msg's ackno field is possibly empty if the receiver hasn't received the
@@ -86,30 +182,220 @@ void TCPSender::receive(const TCPReceiverMessage& msg) {
     current_unwraped_ackno = msg.ackno.value().unwrap(isn_, absolute_seqno_);
   }
 
-  // Receive ack for segment not yet sent
-  if (current_unwraped_ackno > absolute_seqno_) {
+  // Receive ack for segment not yet sent (queued doesn't count: nothing
+  // past highest_sent_ can have reached the peer)
+  if (current_unwraped_ackno > highest_sent_) {
     return;
   }
 
   // Don't add FIN if this would make the segment exceed the receiver's window
-  available_to_send_FIN_ =
-      msg.window_size + current_unwraped_ackno > absolute_seqno_;
-  if (msg.window_size == 0) {
+  const uint64_t window = msg.window();
+  available_to_send_FIN_ = window + current_unwraped_ackno > absolute_seqno_;
+  if (window == 0) {
     available_to_send_FIN_ = current_unwraped_ackno >= absolute_seqno_;
     can_use_magic_ = true;
   }
 
-  //
+  // Room left in the receiver's window (none if it has shrunk below what was
+  // already sent)
+  const uint64_t window_end = current_unwraped_ackno + window;
   remaining_window_size_ =
-      current_unwraped_ackno + msg.window_size - absolute_seqno_;
-  window_is_zero_ = remaining_window_size_ == 0;
+      window_end > absolute_seqno_ ? window_end - absolute_seqno_ : 0;
+  window_is_zero_ = window == 0;
+
+  if (sack_) {
+    update_scoreboard(msg);
+  }
 
   if (pre_unwarped_ackno_ < current_unwraped_ackno) {
     receive_new_ack(current_unwraped_ackno);
+  } else if (fast_retransmit_ && msg.ackno.has_value() &&
+             current_unwraped_ackno == pre_unwarped_ackno_ &&
+             window == last_window_size_ &&
+             has_outstanding_segment()) {
+    receive_duplicate_ack();
+  }
+  last_window_size_ = window;
+  update_pacing_rate();
+
+  // With SACK, the first unacked segment can be judged lost without three
+  // duplicate ACKs (e.g. when the ACKs themselves were lost)
+  if (sack_ && !in_fast_recovery_ && has_outstanding_segment() &&
+      scoreboard_.front().lost && pre_unwarped_ackno_ > recover_) {
+    enter_fast_recovery();
+  }
+}
+
+void TCPSender::update_scoreboard(const TCPReceiverMessage& msg) {
+  const auto sent_begin = segments_.cbegin();
+  const auto sent_end =
+      segments_.cbegin() + static_cast<ptrdiff_t>(next_segment_);
+  for (const auto& block : msg.sack_blocks) {
+    const uint64_t left = block.left_edge.unwrap(isn_, absolute_seqno_);
+    const uint64_t right = block.right_edge.unwrap(isn_, absolute_seqno_);
+    // Segments are in sequence order: find the first inside the block
+    auto it = partition_point(sent_begin, sent_end, [&](const auto& segment) {
+      return segment.seqno.unwrap(isn_, absolute_seqno_) < left;
+    });
+    for (; it != sent_end; ++it) {
+      const uint64_t start = it->seqno.unwrap(isn_, absolute_seqno_);
+      if (start + it->sequence_length() > right) {
+        break;
+      }
+      const auto i = static_cast<size_t>(it - sent_begin);
+      if (!scoreboard_[i].sacked) {
+        ScoreboardEntry entry = scoreboard_[i];
+        entry.sacked = true;
+        set_entry(i, entry);
+      }
+    }
+  }
+
+  // IsLost(): a segment is lost once enough is SACKed above it, i.e. three
+  // segments, or more than two segments' worth of bytes. Everything below
+  // the highest such segment is lost too, so only the top of the sent
+  // segments is scanned, and only what lies above lost_end_ is marked.
+  uint64_t sacked_segments = 0;
+  uint64_t sacked_bytes = 0;
+  size_t lost_end = 0;
+  for (size_t i = next_segment_; i-- > lost_end_;) {
+    if (sacked_segments >= 3 || sacked_bytes > 2 * mss_) {
+      lost_end = i + 1;
+      break;
+    }
+    if (scoreboard_[i].sacked) {
+      sacked_segments += 1;
+      sacked_bytes += segments_[i].sequence_length();
+    }
+  }
+  for (size_t i = lost_end_; i < lost_end; ++i) {
+    if (!scoreboard_[i].sacked && !scoreboard_[i].lost) {
+      ScoreboardEntry entry = scoreboard_[i];
+      entry.lost = true;
+      set_entry(i, entry);
+    }
+  }
+  lost_end_ = max(lost_end_, lost_end);
+}
+
+// Change a sent segment's scoreboard entry, keeping pipe_ and hole_bytes_
+// up to date
+void TCPSender::set_entry(size_t i, ScoreboardEntry entry) {
+  pipe_ -= pipe_share(i);
+  hole_bytes_ -= hole_share(i);
+  scoreboard_[i] = entry;
+  pipe_ += pipe_share(i);
+  hole_bytes_ += hole_share(i);
+}
+
+// SetPipe(): a sent segment not SACKed counts unless judged lost, and again
+// if it was resent. Segments queued but not yet sent are not in the network.
+uint64_t TCPSender::pipe_share(size_t i) const {
+  const auto& entry = scoreboard_[i];
+  const uint64_t length = segments_[i].sequence_length();
+  if (entry.sacked) {
+    return 0;
+  }
+  return (entry.lost ? 0 : length) + (entry.retransmitted ? length : 0);
+}
+
+uint64_t TCPSender::hole_share(size_t i) const {
+  const auto& entry = scoreboard_[i];
+  return !entry.sacked && entry.lost && !entry.retransmitted
+             ? segments_[i].sequence_length()
+             : 0;
+}
+
+// The first segment judged lost and not yet resent in this recovery
+optional<size_t> TCPSender::next_hole() {
+  if (hole_bytes_ == 0) {
+    return nullopt;
+  }
+  for (; hole_cursor_ < next_segment_; ++hole_cursor_) {
+    if (hole_share(hole_cursor_) > 0) {
+      return hole_cursor_;
+    }
+  }
+  return nullopt;
+}
+
+uint64_t TCPSender::pipe() const { return pipe_; }
+
+void TCPSender::receive_duplicate_ack() {
+  duplicate_acks_ += 1;
+  if (in_fast_recovery_) {
+    // Another segment has left the network (the pipe counts this with SACK)
+    if (!sack_) {
+      recovery_inflation_ += mss_;
+    }
+    return;
+  }
+  // Only once per window: not again for losses from before the last recovery
+  if (duplicate_acks_ == 3 && pre_unwarped_ackno_ > recover_) {
+    enter_fast_recovery();
+  }
+}
+
+void TCPSender::enter_fast_recovery() {
+  in_fast_recovery_ = true;
+  recover_ = highest_sent_;
+  fast_retransmissions_ += 1;
+  if (congestion_controller_) {
+    congestion_controller_->on_loss(flight_size(), now_ms_);
+  }
+  if (sack_) {
+    // maybe_send() resends the holes, starting with the first segment
+    for (size_t i = 0; i < next_segment_; ++i) {
+      if (scoreboard_[i].retransmitted) {
+        ScoreboardEntry entry = scoreboard_[i];
+        entry.retransmitted = false;
+        set_entry(i, entry);
+      }
+    }
+    ScoreboardEntry front = scoreboard_.front();
+    front.lost = true;
+    set_entry(0, front);
+    hole_cursor_ = 0;
+  } else {
+    recovery_inflation_ = 3 * mss_;
+    retransmit_flag_ = true;
   }
 }
 
+void TCPSender::exit_fast_recovery() {
+  in_fast_recovery_ = false;
+  recovery_inflation_ = 0;
+}
+
 void TCPSender::receive_new_ack(uint64_t new_unwraped_ackno) {
+  if (rtt_probe_.has_value() &&
+      new_unwraped_ackno >= rtt_probe_->end_absolute_seqno) {
+    rtt_.add_sample(now_ms_ - rtt_probe_->sent_ms);
+    rtt_probe_.reset();
+    if (congestion_controller_) {
+      congestion_controller_->on_rtt(rtt_.srtt_ms().value());
+    }
+    if (adaptive_rto_) {
+      timer_->set_initial_RTO(rtt_.rto_ms(min_rto_ms_, max_rto_ms_));
+    }
+  }
+  const uint64_t bytes_acked = new_unwraped_ackno - pre_unwarped_ackno_;
+  duplicate_acks_ = 0;
+  if (in_fast_recovery_ && new_unwraped_ackno < recover_) {
+    // Partial ACK: the next hole is lost too. Resend it at once, and deflate
+    // the window by what was acked, less the segment resent. (With SACK, the
+    // scoreboard already knows which holes to resend.)
+    if (!sack_) {
+      recovery_inflation_ -= min(recovery_inflation_, bytes_acked);
+      recovery_inflation_ += mss_;
+      retransmit_flag_ = true;
+    }
+  } else if (in_fast_recovery_) {
+    // Full ACK: back to cwnd = ssthresh
+    exit_fast_recovery();
+  } else if (congestion_controller_) {
+    congestion_controller_->on_ack(bytes_acked, now_ms_);
+  }
   timer_->set_RTO_by_factor(0);
   if (has_outstanding_segment()) {
     timer_->restart();
@@ -117,6 +403,10 @@ void TCPSender::receive_new_ack(uint64_t new_unwraped_ackno) {
   consecutive_retransmissions_ = 0;
   pre_unwarped_ackno_ = new_unwraped_ackno;
   remove_acked_segment(new_unwraped_ackno);
+  // Stop now, as the next tick would, so a timing wheel isn't woken for it
+  if (!has_outstanding_segment() && !has_cached_segment()) {
+    timer_->stop();
+  }
 }
 
 void TCPSender::remove_acked_segment(uint64_t unwraped_ackno) {
@@ -126,15 +416,115 @@ void TCPSender::remove_acked_segment(uint64_t unwraped_ackno) {
         it->seqno.unwrap(isn_, absolute_seqno_) + it->sequence_length();
     if (unwraped_ackno < end_absolute_seqno) {
       // This segment hasn't been fully acked yet.
-      return;
+      break;
     }
     sequence_numbers_in_flight_ -= it->sequence_length();
+    acked_unpopped_bytes_ += hold_unacked_ ? it->payload.size() : 0;
+    pipe_ -= pipe_share(0);
+    hole_bytes_ -= hole_share(0);
     segments_.pop_front();
+    scoreboard_.pop_front();
     next_segment_ -= 1;
+    lost_end_ -= min<size_t>(lost_end_, 1);
+    hole_cursor_ -= min<size_t>(hole_cursor_, 1);
+  }
+
+  // A super-segment can be acked in part: drop what the peer has
+  if (super_segments_ && has_outstanding_segment()) {
+    TCPSenderMessage& front = segments_.front();
+    const uint64_t start = front.seqno.unwrap(isn_, absolute_seqno_);
+    if (unwraped_ackno > start) {
+      const uint64_t acked = unwraped_ackno - start;
+      const uint64_t payload_before = front.payload.size();
+      front = slice(front, acked, front.sequence_length() - acked);
+      acked_unpopped_bytes_ +=
+          hold_unacked_ ? payload_before - front.payload.size() : 0;
+      sequence_numbers_in_flight_ -= acked;
+      pipe_ -= acked;
+      if (next_segment_ == 0) {
+        sent_offset_ -= acked;
+      }
+    }
+  }
+}
+
+// Sequence numbers of the next segment cut from `msg` at `offset`: up to one
+// MSS of payload, plus the SYN and FIN if they fall in it
+uint64_t TCPSender::slice_length(const TCPSenderMessage& msg,
+                                 uint64_t offset) const {
+  if (!super_segments_) {
+    return msg.sequence_length() - offset;
+  }
+  const bool syn = msg.SYN && offset == 0;
+  const uint64_t payload_start = offset == 0 || !msg.SYN ? offset : offset - 1;
+  const uint64_t payload_size =
+      min<uint64_t>(mss_, msg.payload.size() - payload_start);
+  const bool fin =
+      msg.FIN && payload_start + payload_size == msg.payload.size();
+  return syn + payload_size + fin;
+}
+
+// The part of `msg` covering its sequence numbers [offset, offset + length)
+TCPSenderMessage TCPSender::slice(const TCPSenderMessage& msg, uint64_t offset,
+                                  uint64_t length) {
+  if (offset == 0 && length == msg.sequence_length()) {
+    return msg;
+  }
+  const uint64_t end = offset + length;
+  const uint64_t syn = msg.SYN ? 1 : 0;
+  const uint64_t payload_start = offset > 0 ? offset - syn : 0;
+  const uint64_t payload_end = min<uint64_t>(msg.payload.size(), end - syn);
+
+  TCPSenderMessage out{};
+  out.seqno = msg.seqno + static_cast<uint32_t>(offset);
+  out.SYN = msg.SYN && offset == 0;
+  if (out.SYN) {
+    out.window_scale = msg.window_scale;
+  }
+  out.payload = msg.payload.substr(payload_start, payload_end - payload_start);
+  out.FIN = msg.FIN && end == msg.sequence_length();
+  return out;
+}
+
+void TCPSender::update_pacing_rate() {
+  const auto srtt = rtt_.srtt_ms();
+  if (!pacing_ || !srtt.has_value()) {
+    return;
   }
+  const uint64_t window = congestion_controller_
+                              ? congestion_controller_->cwnd()
+                              : max<uint64_t>(last_window_size_, 1);
+  // Sub-millisecond round trips pace at the tick resolution
+  pacer_.set_rate(pacing_gain_ * static_cast<double>(window) /
+                  max(srtt.value(), 1.0));
+}
+
+optional<uint64_t> TCPSender::next_send_ms() const {
+  if (!has_cached_segment()) {
+    return {};
+  }
+  return pacer_.ms_until_ready();
+}
+
+void TCPSender::use_timing_wheel(TimingWheel& wheel,
+                                 TimingWheel::Callback on_timeout) {
+  wheel_ = &wheel;
+  wheel_synced_ms_ = wheel.now();
+  timer_->use_timing_wheel(wheel, std::move(on_timeout));
+}
+
+void TCPSender::sync_clock() {
+  if (wheel_ == nullptr || wheel_->now() == wheel_synced_ms_) {
+    return;
+  }
+  const uint64_t elapsed = wheel_->now() - wheel_synced_ms_;
+  wheel_synced_ms_ = wheel_->now();
+  tick(elapsed);
 }
 
 void TCPSender::tick(uint64_t ms_since_last_tick) {
+  now_ms_ += ms_since_last_tick;
+  pacer_.elapse(ms_since_last_tick);
   if (!has_outstanding_segment() && !has_cached_segment()) {
     timer_->stop();
     return;
@@ -145,6 +535,22 @@ void TCPSender::tick(uint64_t ms_since_last_tick) {
     if (!window_is_zero_) {
       consecutive_retransmissions_ += 1;
       timer_->set_RTO_by_factor(2);
+      timer_->limit_RTO(max_rto_ms_);
+      if (congestion_controller_) {
+        congestion_controller_->on_rto(flight_size(), now_ms_);
+      }
+      update_pacing_rate();
+      exit_fast_recovery();
+      duplicate_acks_ = 0;
+      for (size_t i = 0; i < next_segment_; ++i) {
+        ScoreboardEntry entry = scoreboard_[i];
+        entry.lost = false;
+        entry.retransmitted = false;
+        set_entry(i, entry);
+      }
+      lost_end_ = 0;
+      hole_cursor_ = 0;
+      recover_ = highest_sent_;
     } else {
       timer_->set_RTO_by_factor(0);
     }
@@ -152,7 +558,13 @@ void TCPSender::tick(uint64_t ms_since_last_tick) {
   }
 }
 
-bool TCPSender::has_outstanding_segment() const { return next_segment_ != 0; }
+uint64_t TCPSender::flight_size() const {
+  return highest_sent_ - pre_unwarped_ackno_;
+}
+
+bool TCPSender::has_outstanding_segment() const {
+  return next_segment_ != 0 || sent_offset_ != 0;
+}
 
 bool TCPSender::has_cached_segment() const {
   return next_segment_ != segments_.size();
@@ -166,3 +578,23 @@ uint64_t TCPSender::sequence_numbers_in_flight() const {
 uint64_t TCPSender::consecutive_retransmissions() const {
   return consecutive_retransmissions_;
 }
+
+const CongestionController* TCPSender::congestion_controller() const {
+  return congestion_controller_.get();
+}
+
+optional<double> TCPSender::srtt_ms() const { return rtt_.srtt_ms(); }
+
+uint64_t TCPSender::current_RTO_ms() const { return timer_->current_RTO_ms(); }
+
+bool TCPSender::in_fast_recovery() const { return in_fast_recovery_; }
+
+uint64_t TCPSender::fast_retransmissions() const {
+  return fast_retransmissions_;
+}
+
+optional<double> TCPSender::pacing_rate() const { return pacer_.rate(); }
+
+bool TCPSender::FIN_queued() const { return pre_segment_has_FIN_; }
+
+uint64_t TCPSender::mss() const { return mss_; }
@@ -1,10 +1,16 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
+#include <optional>
 
 #include "byte_stream.hh"
+#include "congestion_control.hh"
+#include "tcp_config.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
+#include "timing_wheel.hh"
 
 class Timer {
  private:
@@ -13,11 +19,50 @@ class Timer {
   uint64_t time_elapsed_ = 0;
   uint64_t current_RTO_ms_;
 
+  // Optionally, a wakeup on a shared timing wheel for when the timer will
+  // expire, so the owner need not be ticked to find out
+  TimingWheel* wheel_ = nullptr;
+  TimingWheel::Callback on_expire_{};
+  TimingWheel::Handle wakeup_{};
+
+  void rearm() {
+    if (wheel_ == nullptr) {
+      return;
+    }
+    if (!is_running_) {
+      wakeup_.cancel();
+      return;
+    }
+    const uint64_t deadline = wheel_->now() + current_RTO_ms_ -
+                              std::min(time_elapsed_, current_RTO_ms_);
+    // Moving the pending wakeup leaves nothing behind in the wheel
+    if (!wakeup_.reschedule_at(deadline)) {
+      wakeup_ = wheel_->schedule_at(deadline, on_expire_);
+    }
+  }
+
  public:
   explicit Timer(uint64_t initial_RTO_ms)
       : initial_RTO_ms_(initial_RTO_ms), current_RTO_ms_(initial_RTO_ms) {}
+  ~Timer() = default;
+  Timer(const Timer& other) = delete;
+  Timer& operator=(const Timer& other) = delete;
+  Timer(Timer&& other) = default;
+  Timer& operator=(Timer&& other) = default;
 
-  void run() { is_running_ = true; }
+  // Call `on_expire` from wheel.advance() whenever the timer expires. The
+  // owner must still elapse() the timer, up to the wheel's time, before
+  // using or changing it.
+  void use_timing_wheel(TimingWheel& wheel, TimingWheel::Callback on_expire) {
+    wheel_ = &wheel;
+    on_expire_ = std::move(on_expire);
+    rearm();
+  }
+
+  void run() {
+    is_running_ = true;
+    rearm();
+  }
 
   void elapse(uint64_t time) {
     if (is_running()) {
@@ -28,6 +73,19 @@ class Timer {
     }
   }
 
+  // Change the RTO that set_RTO_by_factor(0) resets to
+  void set_initial_RTO(uint64_t initial_RTO_ms) {
+    initial_RTO_ms_ = initial_RTO_ms;
+  }
+
+  // Never let the RTO (after backoff) exceed `max_RTO_ms`
+  void limit_RTO(uint64_t max_RTO_ms) {
+    current_RTO_ms_ = std::min(current_RTO_ms_, max_RTO_ms);
+    rearm();
+  }
+
+  uint64_t current_RTO_ms() const { return current_RTO_ms_; }
+
   // Multiple current_RTO_ms by a factor greater or equal 0.
   // If factor == 0, reset RTO to initial_RTO_ms.
   void set_RTO_by_factor(uint8_t factor) {
@@ -36,18 +94,24 @@ class Timer {
     } else {
       current_RTO_ms_ *= factor;
     }
+    rearm();
   }
 
-  void stop() { is_running_ = false; }
+  void stop() {
+    is_running_ = false;
+    rearm();
+  }
 
   void expire() {
     is_running_ = false;
     time_elapsed_ = 0;
+    rearm();
   }
 
   void restart() {
     is_running_ = true;
     time_elapsed_ = 0;
+    rearm();
   }
 
   bool expired() const { return !is_running_ && time_elapsed_ == 0; }
@@ -55,6 +119,84 @@ class Timer {
   bool is_running() const { return is_running_; }
 };
 
+// Round-trip time estimation as in RFC 6298
+class RTTEstimator {
+ private:
+  std::optional<double> srtt_ms_{};
+  double rttvar_ms_ = 0;
+
+ public:
+  void add_sample(uint64_t rtt_ms) {
+    const auto r = static_cast<double>(rtt_ms);
+    if (!srtt_ms_.has_value()) {
+      srtt_ms_ = r;
+      rttvar_ms_ = r / 2;
+      return;
+    }
+    rttvar_ms_ = 0.75 * rttvar_ms_ + 0.25 * std::abs(srtt_ms_.value() - r);
+    srtt_ms_ = 0.875 * srtt_ms_.value() + 0.125 * r;
+  }
+
+  // Empty until the first sample
+  std::optional<double> srtt_ms() const { return srtt_ms_; }
+  double rttvar_ms() const { return rttvar_ms_; }
+
+  // SRTT + max(G, 4 * RTTVAR) with a clock granularity G of 1 ms, clamped
+  uint64_t rto_ms(uint64_t min_ms, uint64_t max_ms) const {
+    const double rto =
+        srtt_ms_.value_or(0) + std::max(1.0, 4 * rttvar_ms_);
+    return std::clamp(static_cast<uint64_t>(std::ceil(rto)), min_ms, max_ms);
+  }
+};
+
+// Token bucket that spaces segments out at a given rate. Tokens are bytes;
+// a segment may go out whenever the bucket is not in debt, so at most one
+// segment beyond the burst size leaves back to back.
+class Pacer {
+ private:
+  double burst_bytes_;
+  double tokens_;
+  // Bytes per millisecond; empty while unpaced
+  std::optional<double> rate_{};
+
+ public:
+  explicit Pacer(uint64_t burst_bytes)
+      : burst_bytes_(static_cast<double>(burst_bytes)),
+        tokens_(burst_bytes_) {}
+
+  void set_rate(std::optional<double> bytes_per_ms) {
+    rate_ = bytes_per_ms;
+    if (!rate_.has_value()) {
+      tokens_ = burst_bytes_;
+    }
+  }
+
+  std::optional<double> rate() const { return rate_; }
+
+  void elapse(uint64_t ms) {
+    if (rate_.has_value()) {
+      tokens_ = std::min(burst_bytes_,
+                         tokens_ + rate_.value() * static_cast<double>(ms));
+    }
+  }
+
+  bool ready() const { return !rate_.has_value() || tokens_ >= 0; }
+
+  void consume(uint64_t bytes) {
+    if (rate_.has_value()) {
+      tokens_ -= static_cast<double>(bytes);
+    }
+  }
+
+  // Milliseconds of elapse() before ready()
+  uint64_t ms_until_ready() const {
+    if (ready()) {
+      return 0;
+    }
+    return static_cast<uint64_t>(std::ceil(-tokens_ / rate_.value()));
+  }
+};
+
 class TCPSender {
   Wrap32 isn_;
   std::unique_ptr<Timer> timer_;
@@ -62,8 +204,11 @@ class TCPSender {
   // send msg with 1 byte when windowSize equals 0 for 1 time
   bool can_use_magic_ = false;
   bool window_is_zero_ = false;
-  // init this as 1 to send syn
-  uint16_t remaining_window_size_ = 1;
+  // init this as 1 to send syn. Windows are kept in sequence numbers, 64 bits
+  // wide, as a scaled window (RFC 7323) can exceed 16 bits.
+  uint64_t remaining_window_size_ = 1;
+  // Window scale option for the SYN: the shift our receiver applies
+  std::optional<uint8_t> window_scale_offer_{};
 
   // When timer is expired, set this flag to true.
   // Set this flag to false after retransmitting the segment.
@@ -78,17 +223,102 @@ class TCPSender {
 
   // nums of segment sent but not acked
   size_t next_segment_ = 0;
+  // With super-segments, sequence numbers of segments_[next_segment_]
+  // already sent
+  uint64_t sent_offset_ = 0;
   // segments not acked and not sent
   std::deque<TCPSenderMessage> segments_{};
 
+  // Largest payload per segment sent. With super-segments, push() queues up
+  // to SUPER_SEGMENT_MSS of them in one message, which maybe_send() cuts up.
+  uint64_t mss_ = TCPConfig::MAX_PAYLOAD_SIZE;
+  bool super_segments_ = false;
+
+  // Segment payloads are slices of the outbound stream's storage. With
+  // hold_unacked_, push() leaves the bytes in the stream until they are
+  // acked: the stream's capacity then covers the retransmission queue too.
+  bool hold_unacked_ = false;
+  uint64_t held_bytes_ = 0;            // in segments_, not yet popped
+  uint64_t acked_unpopped_bytes_ = 0;  // of those, acked since last push()
+
   uint64_t sequence_numbers_in_flight_ = 0;
   uint64_t consecutive_retransmissions_ = 0;
 
+  // Null without congestion control
+  std::unique_ptr<CongestionController> congestion_controller_{};
+  // Sum of all tick()s, the clock the congestion controller sees
+  uint64_t now_ms_ = 0;
+
+  // One segment at a time is timed. Karn's algorithm: a retransmission
+  // cancels the measurement, as its ACK could be for either transmission.
+  struct RTTProbe {
+    uint64_t end_absolute_seqno;
+    uint64_t sent_ms;
+  };
+  std::optional<RTTProbe> rtt_probe_{};
+  RTTEstimator rtt_{};
+
+  // Fast retransmit and NewReno fast recovery (RFC 5681, RFC 6582)
+  bool fast_retransmit_ = false;
+  uint64_t duplicate_acks_ = 0;
+  uint64_t last_window_size_ = 0;
+  bool in_fast_recovery_ = false;
+  // Recovery ends once everything sent before it began is acked
+  uint64_t recover_ = 0;
+  // Added to cwnd during recovery for segments that have left the network
+  uint64_t recovery_inflation_ = 0;
+  uint64_t highest_sent_ = 0;
+  uint64_t fast_retransmissions_ = 0;
+
+  // SACK scoreboard (RFC 6675), one entry per segment in segments_. With
+  // SACK, recovery resends every hole judged lost rather than only the
+  // first, as long as the pipe estimate leaves room in cwnd.
+  struct ScoreboardEntry {
+    bool sacked = false;
+    bool lost = false;
+    bool retransmitted = false;
+  };
+  bool sack_ = false;
+  std::deque<ScoreboardEntry> scoreboard_{};
+  // Kept up to date as entries change, rather than counted on each use:
+  // pipe() itself, and the sequence numbers judged lost and not yet resent
+  uint64_t pipe_ = 0;
+  uint64_t hole_bytes_ = 0;
+  // Sent segments before lost_end_ have all been judged lost or SACKed, and
+  // none before hole_cursor_ waits to be resent
+  size_t lost_end_ = 0;
+  size_t hole_cursor_ = 0;
+
+  // Pacing: new segments leave at gain * window / SRTT once there is an RTT
+  // sample, the window being cwnd or else the receiver's window. SACK
+  // recovery is paced too; retransmissions of the first segment are not.
+  bool pacing_ = false;
+  double pacing_gain_ = 1;
+  Pacer pacer_{TCPConfig::MAX_PAYLOAD_SIZE};
+
+  // With a shared timing wheel, the sender's clock is the wheel's, caught up
+  // on entry to push(), maybe_send() and receive()
+  TimingWheel* wheel_ = nullptr;
+  uint64_t wheel_synced_ms_ = 0;
+
+  bool adaptive_rto_ = false;
+  uint64_t min_rto_ms_ = 0;
+  uint64_t max_rto_ms_ = UINT64_MAX;
+
  public:
   /* Construct TCP sender with given default Retransmission Timeout and possible
    * ISN */
   TCPSender(uint64_t initial_RTO_ms, std::optional<Wrap32> fixed_isn);
 
+  /* Construct TCP sender from the sender settings of a TCPConfig */
+  explicit TCPSender(const TCPConfig& config);
+
+  ~TCPSender() = default;
+  TCPSender(const TCPSender& other) = delete;
+  TCPSender& operator=(const TCPSender& other) = delete;
+  TCPSender(TCPSender&& other) = default;
+  TCPSender& operator=(TCPSender&& other) = default;
+
   /* Push bytes from the outbound stream */
   void push(Reader& outbound_stream);
 
@@ -105,15 +335,53 @@ class TCPSender {
    * tick() method was called. */
   void tick(uint64_t ms_since_last_tick);
 
+  /* Take the time from `wheel` instead of tick(). When the retransmission
+   * timer expires, wheel.advance() calls `on_timeout`; maybe_send() then
+   * gives the retransmission. The wheel must outlive the sender. */
+  void use_timing_wheel(TimingWheel& wheel, TimingWheel::Callback on_timeout);
+
+  /* With pacing, how many ms until the next queued segment may be sent
+   * (0 if it may go now), or empty if no segment is waiting */
+  std::optional<uint64_t> next_send_ms() const;
+
   /* Accessors for use in testing */
   uint64_t sequence_numbers_in_flight()
       const;  // How many sequence numbers are outstanding?
   uint64_t consecutive_retransmissions()
       const;  // How many consecutive *re*transmissions have happened?
+  const CongestionController* congestion_controller()
+      const;  // The congestion controller, if any
+  std::optional<double> srtt_ms()
+      const;  // Smoothed round-trip time, once there is a sample
+  uint64_t current_RTO_ms() const;  // The retransmission timeout now
+  bool in_fast_recovery() const;
+  uint64_t fast_retransmissions()
+      const;  // How many times was fast recovery entered?
+  uint64_t mss() const;   // Largest payload in one segment
+  uint64_t pipe() const;  // Estimate of the sequence numbers in the network
+  std::optional<double> pacing_rate()
+      const;  // Bytes per ms, if pacing is on and has an RTT sample
+  bool FIN_queued() const;  // Has the FIN gone into a segment yet?
 
  private:
   void remove_acked_segment(uint64_t current_unwraped_ackno);
   void receive_new_ack(uint64_t new_unwraped_ackno);
+  void receive_duplicate_ack();
+  void enter_fast_recovery();
+  void exit_fast_recovery();
+  void update_scoreboard(const TCPReceiverMessage& msg);
+  void set_entry(size_t i, ScoreboardEntry entry);
+  uint64_t pipe_share(size_t i) const;
+  uint64_t hole_share(size_t i) const;
+  std::optional<size_t> next_hole();
+  void update_pacing_rate();
+  void sync_clock();
+  uint64_t slice_length(const TCPSenderMessage& msg, uint64_t offset) const;
+  static TCPSenderMessage slice(const TCPSenderMessage& msg, uint64_t offset,
+                                uint64_t length);
   bool has_outstanding_segment() const;  // sent but unacked
+  // Sequence numbers sent but unacked (RFC 5681's FlightSize); unlike
+  // sequence_numbers_in_flight_, not counting segments still queued
+  uint64_t flight_size() const;
   bool has_cached_segment() const;       // not yet send but usable
 };
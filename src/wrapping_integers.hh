@@ -36,6 +36,9 @@ class Wrap32 {
   // unassembled index
   uint64_t unwrap(Wrap32 zero_point, uint64_t checkpoint) const;
 
+  /* The 32-bit value itself, as it goes on the wire */
+  uint32_t raw_value() const { return raw_value_; }
+
   Wrap32 operator+(uint32_t n) const { return Wrap32{raw_value_ + n}; }
   bool operator==(const Wrap32& other) const {
     return raw_value_ == other.raw_value_;
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Counts calls to the global operator new, for the speed tests'
+// allocation-count assertion mode (--check-allocations). Include this from
+// exactly one translation unit of a test program.
+
+inline std::atomic<uint64_t> global_allocation_count{0};
+
+void* operator new(size_t size) {
+  global_allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {  // NOLINT(*-malloc)
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);  // NOLINT(*-malloc)
+}
+
+void operator delete(void* ptr, size_t /*unused*/) noexcept {
+  std::free(ptr);  // NOLINT(*-malloc)
+}
@@ -96,6 +96,28 @@ int main() {
       test.execute(BytesBuffered{1});
     }
 
+    {
+      ByteStreamTestHarness test{"set capacity", 2};
+
+      test.execute(Push{"cat"});
+      test.execute(SetCapacity{5});
+      test.execute(Capacity{5});
+      test.execute(AvailableCapacity{3});
+      test.execute(Push{"tac"});
+      test.execute(Peek{"catac"});
+      test.execute(SetCapacity{1});
+      test.execute(Capacity{5});
+      test.execute(Pop{3});
+      test.execute(SetCapacity{1});
+      test.execute(Capacity{2});
+      test.execute(AvailableCapacity{0});
+      test.execute(ReadAll{"ac"});
+      test.execute(SetCapacity{1});
+      test.execute(Capacity{1});
+      test.execute(Push{"xy"});
+      test.execute(ReadAll{"x"});
+    }
+
   } catch (const exception& e) {
     cerr << "Exception: " << e.what() << endl;
     return EXIT_FAILURE;
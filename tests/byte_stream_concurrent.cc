@@ -0,0 +1,114 @@
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "concurrent_byte_stream.hh"
+
+using namespace std;
+
+template <typename T>
+void expect(const string& property, const T& expected, const T& actual) {
+  if (expected != actual) {
+    throw runtime_error("The stream should have had " + property + " = " +
+                        to_string(expected) + ", but instead it was " +
+                        to_string(actual) + ".");
+  }
+}
+
+void expect_peek(ConcurrentReader& reader, const string& expected) {
+  if (reader.peek() != expected) {
+    throw runtime_error("Expected peek() to give \"" + expected +
+                        "\", but found \"" + string{reader.peek()} + "\"");
+  }
+}
+
+void single_thread() {
+  ConcurrentByteStream bs{5};
+  auto& writer = bs.writer();
+  auto& reader = bs.reader();
+
+  expect("push(\"abcd\")", uint64_t{4}, writer.push("abcd"));
+  reader.pop(3);
+  expect("push(\"efgh\")", uint64_t{4}, writer.push("efgh"));
+  expect("available_capacity", uint64_t{0}, writer.available_capacity());
+  expect("push(\"x\")", uint64_t{0}, writer.push("x"));
+  expect("bytes_buffered", uint64_t{5}, reader.bytes_buffered());
+  expect_peek(reader, "de");
+  reader.pop(2);
+  expect_peek(reader, "fgh");
+
+  writer.close();
+  expect("is_closed", true, writer.is_closed());
+  expect("is_finished", false, reader.is_finished());
+  reader.pop(10);
+  expect("bytes_popped", uint64_t{8}, reader.bytes_popped());
+  expect("is_finished", true, reader.is_finished());
+  expect("has_error", false, reader.has_error());
+  writer.set_error();
+  expect("has_error", true, reader.has_error());
+}
+
+void two_threads(size_t input_len, size_t capacity, size_t random_seed) {
+  default_random_engine rd{random_seed};
+  const string data = [&] {
+    uniform_int_distribution<char> ud;
+    string ret;
+    for (size_t i = 0; i < input_len; ++i) {
+      ret += ud(rd);
+    }
+    return ret;
+  }();
+
+  ConcurrentByteStream bs{capacity};
+
+  thread producer{[&, seed = rd()] {
+    default_random_engine prd{seed};
+    uniform_int_distribution<size_t> chunk_size{1, capacity * 2};
+    string_view remaining{data};
+    while (not remaining.empty()) {
+      const auto chunk = remaining.substr(0, chunk_size(prd));
+      const auto n = bs.writer().push(chunk);
+      remaining.remove_prefix(n);
+      if (n < chunk.size()) {
+        bs.writer().wait_for_capacity(chunk.size() - n);
+      }
+    }
+    bs.writer().close();
+  }};
+
+  uniform_int_distribution<size_t> read_size{1, capacity};
+  string output;
+  while (not bs.reader().is_finished()) {
+    const auto peeked = bs.reader().peek().substr(0, read_size(rd));
+    if (peeked.empty()) {
+      bs.reader().wait_for_data();
+      continue;
+    }
+    output += peeked;
+    bs.reader().pop(peeked.size());
+  }
+  producer.join();
+
+  if (output != data) {
+    throw runtime_error("Mismatch between data written and read across "
+                        "threads (capacity=" +
+                        to_string(capacity) + ")");
+  }
+}
+
+int main() {
+  try {
+    single_thread();
+    two_threads(100000, 1, 11);
+    two_threads(1000000, 97, 12);
+    two_threads(1000000, 4096, 13);
+  } catch (const exception& e) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+#include <unistd.h>
+
+#include <array>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <stdexcept>
+
+#include "byte_stream.hh"
+#include "file_descriptor.hh"
+
+using namespace std;
+
+pair<FileDescriptor, FileDescriptor> make_pipe() {
+  array<int, 2> fds{};
+  if (::pipe(fds.data()) != 0) {
+    throw runtime_error("pipe() failed");
+  }
+  return {FileDescriptor{fds[0]}, FileDescriptor{fds[1]}};
+}
+
+// Move `data` through file descriptor -> ByteStream -> file descriptor using
+// push_from() and pop_to(), with a stream much smaller than the data.
+void round_trip(ByteStream::Storage storage, uint64_t capacity,
+                size_t input_len) {
+  default_random_engine rd{capacity};
+  uniform_int_distribution<char> ud;
+  string data;
+  for (size_t i = 0; i < input_len; ++i) {
+    data += ud(rd);
+  }
+
+  auto [in_read, in_write] = make_pipe();
+  auto [out_read, out_write] = make_pipe();
+  for (auto* fd : {&in_read, &in_write, &out_read, &out_write}) {
+    fd->set_blocking(false);
+  }
+
+  ByteStream bs{capacity, storage};
+  string output;
+  string_view to_send{data};
+  string buffer;
+  while (output.size() < data.size()) {
+    if (not to_send.empty()) {
+      to_send.remove_prefix(in_write.write(to_send.substr(0, 1000)));
+    }
+    bs.writer().push_from(in_read);
+    bs.reader().pop_to(out_write);
+    out_read.read(buffer);
+    output += buffer;
+    if (bs.reader().bytes_buffered() > capacity) {
+      throw runtime_error("push_from() exceeded the stream's capacity");
+    }
+  }
+
+  if (output != data or bs.writer().bytes_pushed() != data.size() or
+      bs.reader().bytes_popped() != data.size()) {
+    throw runtime_error("Mismatch between data pushed from and popped to fds");
+  }
+
+  in_write.close();
+  if (bs.writer().push_from(in_read) != 0 or not in_read.eof()) {
+    throw runtime_error("push_from() should report EOF after close");
+  }
+}
+
+// Many small pushes leave more chunks than one writev takes
+void many_chunks() {
+  auto [out_read, out_write] = make_pipe();
+  out_read.set_blocking(false);
+  out_write.set_blocking(false);
+  ByteStream bs{10000, ByteStream::Storage::Chunked};
+  string data;
+  for (size_t i = 0; i < 3000; ++i) {
+    data += static_cast<char>('a' + i % 26);
+    bs.writer().push(data.substr(i));
+  }
+  string output;
+  string buffer;
+  while (bs.reader().bytes_buffered() > 0) {
+    bs.reader().pop_to(out_write);
+    out_read.read(buffer);
+    output += buffer;
+  }
+  if (output != data) {
+    throw runtime_error("pop_to() lost bytes across many chunks");
+  }
+}
+
+int main() {
+  try {
+    many_chunks();
+    for (const auto storage :
+         {ByteStream::Storage::Chunked, ByteStream::Storage::Ring}) {
+      round_trip(storage, 1, 1000);
+      round_trip(storage, 333, 100000);
+      round_trip(storage, 65536, 1000000);
+    }
+  } catch (const exception& e) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+#include <exception>
+#include <iostream>
+
+#include "byte_stream.hh"
+#include "byte_stream_test_harness.hh"
+
+using namespace std;
+
+constexpr auto RING = ByteStream::Storage::Ring;
+
+int main() {
+  try {
+    {
+      ByteStreamTestHarness test{"ring overwrite", 2, RING};
+
+      test.execute(Push{"cat"});
+      test.execute(BytesPushed{2});
+      test.execute(AvailableCapacity{0});
+      test.execute(Peek{"ca"});
+      test.execute(Pop{1});
+      test.execute(Push{"tac"});
+      test.execute(BytesPushed{3});
+      test.execute(BytesBuffered{2});
+      test.execute(Peek{"at"});
+    }
+
+    {
+      ByteStreamTestHarness test{"ring wraps around", 5, RING};
+
+      test.execute(Push{"abcd"});
+      test.execute(Pop{3});
+      test.execute(Push{"efgh"});
+      test.execute(BytesBuffered{5});
+      test.execute(AvailableCapacity{0});
+      test.execute(PeekOnce{"de"});
+      test.execute(Peek{"defgh"});
+      test.execute(Pop{2});
+      test.execute(PeekOnce{"fgh"});
+      test.execute(Push{"ijk"});
+      test.execute(Peek{"fghij"});
+      test.execute(Close{});
+      test.execute(ReadAll{"fghij"});
+      test.execute(IsFinished{true});
+      test.execute(BytesPopped{10});
+    }
+
+    {
+      ByteStreamTestHarness test{"ring many writes", 7, RING};
+
+      for (size_t i = 0; i < 100; ++i) {
+        test.execute(Push{"xyz"});
+        test.execute(Push{"0123"});
+        test.execute(AvailableCapacity{0});
+        test.execute(ReadAll{"xyz0123"});
+      }
+      test.execute(BytesPushed{700});
+      test.execute(BytesPopped{700});
+    }
+
+    {
+      ByteStreamTestHarness test{"ring zero capacity", 0, RING};
+
+      test.execute(Push{"cat"});
+      test.execute(BytesPushed{0});
+      test.execute(BufferEmpty{true});
+      test.execute(PeekOnce{""});
+      test.execute(Pop{1});
+      test.execute(BytesPopped{0});
+    }
+
+    {
+      ByteStreamTestHarness test{"ring resized while wrapped", 5, RING};
+
+      test.execute(Push{"abcd"});
+      test.execute(Pop{3});
+      test.execute(Push{"efgh"});
+      test.execute(PeekOnce{"de"});
+      test.execute(SetCapacity{8});
+      test.execute(Capacity{8});
+      test.execute(PeekOnce{"defgh"});
+      test.execute(Push{"ijklm"});
+      test.execute(BytesBuffered{8});
+      test.execute(Peek{"defghijk"});
+      test.execute(Pop{6});
+      test.execute(SetCapacity{3});
+      test.execute(Capacity{3});
+      test.execute(AvailableCapacity{1});
+      test.execute(Push{"lm"});
+      test.execute(ReadAll{"jkl"});
+      test.execute(SetCapacity{0});
+      test.execute(Push{"n"});
+      test.execute(BytesBuffered{0});
+      test.execute(SetCapacity{4});
+      test.execute(Push{"nopq"});
+      test.execute(ReadAll{"nopq"});
+    }
+  } catch (const exception& e) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
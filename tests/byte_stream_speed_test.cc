@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <cstddef>
 #include <fstream>
@@ -5,8 +6,14 @@
 #include <iostream>
 #include <queue>
 #include <random>
+#include <string_view>
+#include <thread>
+#include <vector>
 
+#include "allocation_counter.hh"
 #include "byte_stream.hh"
+#include "chunk_pool.hh"
+#include "concurrent_byte_stream.hh"
 
 using namespace std;
 using namespace std::chrono;
@@ -16,8 +23,8 @@ void speed_test(
     const size_t capacity,     // NOLINT(bugprone-easily-swappable-parameters)
     const size_t random_seed,  // NOLINT(bugprone-easily-swappable-parameters)
     const size_t write_size,   // NOLINT(bugprone-easily-swappable-parameters)
-    const size_t read_size)    // NOLINT(bugprone-easily-swappable-parameters)
-{
+    const size_t read_size,    // NOLINT(bugprone-easily-swappable-parameters)
+    const ByteStream::Storage storage, const bool check_allocations) {
   // Generate the data to be written
   const string data = [&random_seed, &input_len] {
     default_random_engine rd{random_seed};
@@ -35,10 +42,12 @@ void speed_test(
     split_data.emplace(data.substr(i, write_size));
   }
 
-  ByteStream bs{capacity};
+  ByteStream bs{capacity, storage};
   string output_data;
   output_data.reserve(data.size());
 
+  ChunkPool::reset_stats();
+  const uint64_t allocations_before = global_allocation_count;
   const auto start_time = steady_clock::now();
   while (not bs.reader().is_finished()) {
     if (split_data.empty()) {
@@ -63,6 +72,8 @@ void speed_test(
   }
 
   const auto stop_time = steady_clock::now();
+  const uint64_t allocations = global_allocation_count - allocations_before;
+  const auto pool = ChunkPool::stats();
 
   if (data != output_data) {
     throw runtime_error("Mismatch between data written and read");
@@ -77,24 +88,143 @@ void speed_test(
   fstream debug_output;
   debug_output.open("/dev/tty");
 
-  cout << "ByteStream with capacity=" << capacity
+  const string backend =
+      storage == ByteStream::Storage::Ring ? "ring" : "chunked";
+
+  cout << "ByteStream (" << backend << ") with capacity=" << capacity
        << ", write_size=" << write_size << ", read_size=" << read_size
        << " reached " << fixed << setprecision(2) << gigabits_per_second
-       << " Gbit/s.\n";
+       << " Gbit/s, " << allocations << " heap allocations (chunk pool "
+       << pool.hits << " hits, " << pool.misses << " misses).\n";
 
-  debug_output << "             ByteStream throughput: " << fixed
+  debug_output << "             ByteStream (" << backend
+               << ") throughput: " << fixed
                << setprecision(2) << gigabits_per_second << " Gbit/s\n";
 
   if (gigabits_per_second < 0.1) {
     throw runtime_error("ByteStream did not meet minimum speed of 0.1 Gbit/s.");
   }
+
+  // Once the pool is warm, pushing and popping should not touch the heap
+  const auto num_chunks = input_len / write_size;
+  if (check_allocations and allocations * 100 > num_chunks) {
+    throw runtime_error("ByteStream made " + to_string(allocations) +
+                        " heap allocations for " + to_string(num_chunks) +
+                        " chunks (expected under 1%).");
+  }
 }
 
-void program_body() { speed_test(1e7, 32768, 789, 1500, 128); }
+// Two-thread mode: a producer thread pushes into a ConcurrentByteStream
+// while this thread reads, measuring cross-core throughput and the time from
+// starting to push each chunk to having popped all of it.
+void concurrent_speed_test(
+    const size_t input_len,    // NOLINT(bugprone-easily-swappable-parameters)
+    const size_t capacity,     // NOLINT(bugprone-easily-swappable-parameters)
+    const size_t random_seed,  // NOLINT(bugprone-easily-swappable-parameters)
+    const size_t write_size,   // NOLINT(bugprone-easily-swappable-parameters)
+    const size_t read_size)    // NOLINT(bugprone-easily-swappable-parameters)
+{
+  const string data = [&random_seed, &input_len] {
+    default_random_engine rd{random_seed};
+    uniform_int_distribution<char> ud;
+    string ret;
+    for (size_t i = 0; i < input_len; ++i) {
+      ret += ud(rd);
+    }
+    return ret;
+  }();
+
+  const size_t num_chunks = (data.size() + write_size - 1) / write_size;
+  // Written by the producer before the chunk's bytes are published
+  vector<steady_clock::time_point> push_times(num_chunks);
+  vector<double> latencies_us;
+  latencies_us.reserve(num_chunks);
+
+  ConcurrentByteStream bs{capacity};
+  string output_data;
+  output_data.reserve(data.size());
+
+  const auto start_time = steady_clock::now();
+  thread producer{[&] {
+    auto& writer = bs.writer();
+    for (size_t i = 0; i < num_chunks; ++i) {
+      auto chunk = string_view{data}.substr(i * write_size, write_size);
+      push_times[i] = steady_clock::now();
+      while (not chunk.empty()) {
+        chunk.remove_prefix(writer.push(chunk));
+        if (not chunk.empty()) {
+          writer.wait_for_capacity(chunk.size());
+        }
+      }
+    }
+    writer.close();
+  }};
+
+  auto& reader = bs.reader();
+  size_t next_chunk = 0;
+  while (not reader.is_finished()) {
+    auto peeked = reader.peek().substr(0, read_size);
+    if (peeked.empty()) {
+      reader.wait_for_data();
+      continue;
+    }
+    output_data += peeked;
+    reader.pop(peeked.size());
+
+    const auto now = steady_clock::now();
+    while (next_chunk < num_chunks and
+           (next_chunk + 1) * write_size <= output_data.size()) {
+      latencies_us.push_back(
+          duration<double, micro>(now - push_times[next_chunk]).count());
+      ++next_chunk;
+    }
+  }
+  const auto stop_time = steady_clock::now();
+  producer.join();
+
+  if (data != output_data) {
+    throw runtime_error("Mismatch between data written and read");
+  }
+
+  auto test_duration = duration_cast<duration<double>>(stop_time - start_time);
+  auto gigabits_per_second =
+      8 * static_cast<double>(input_len) / test_duration.count() / 1e9;
+
+  sort(latencies_us.begin(), latencies_us.end());
+  const double median_us =
+      latencies_us.empty() ? 0 : latencies_us[latencies_us.size() / 2];
+  const double p99_us =
+      latencies_us.empty() ? 0 : latencies_us[latencies_us.size() * 99 / 100];
+
+  fstream debug_output;
+  debug_output.open("/dev/tty");
+
+  cout << "ConcurrentByteStream (two threads) with capacity=" << capacity
+       << ", write_size=" << write_size << ", read_size=" << read_size
+       << " reached " << fixed << setprecision(2) << gigabits_per_second
+       << " Gbit/s, chunk handoff median " << median_us << " us, p99 "
+       << p99_us << " us.\n";
+
+  debug_output << "             ConcurrentByteStream throughput: " << fixed
+               << setprecision(2) << gigabits_per_second << " Gbit/s\n";
+
+  if (gigabits_per_second < 0.1) {
+    throw runtime_error(
+        "ConcurrentByteStream did not meet minimum speed of 0.1 Gbit/s.");
+  }
+}
+
+void program_body(bool check_allocations) {
+  speed_test(1e7, 32768, 789, 1500, 128, ByteStream::Storage::Chunked,
+             check_allocations);
+  speed_test(1e7, 32768, 789, 1500, 128, ByteStream::Storage::Ring,
+             check_allocations);
+  concurrent_speed_test(1e7, 32768, 789, 1500, 128);
+}
 
-int main() {
+int main(int argc, char* argv[]) {
   try {
-    program_body();
+    program_body(argc > 1 and string_view{argv[1]} == "--check-allocations");
   } catch (const exception& e) {
     cerr << "Exception: " << e.what() << "\n";
     return EXIT_FAILURE;
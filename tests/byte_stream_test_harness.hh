@@ -1,8 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <concepts>
 #include <optional>
 #include <utility>
+#include <vector>
 
 #include "byte_stream.hh"
 #include "common.hh"
@@ -17,9 +19,13 @@ static_assert(sizeof(Writer) == sizeof(ByteStream),
 
 class ByteStreamTestHarness : public TestHarness<ByteStream> {
  public:
-  ByteStreamTestHarness(std::string test_name, uint64_t capacity)
-      : TestHarness(move(test_name), "capacity=" + std::to_string(capacity),
-                    ByteStream{capacity}) {}
+  ByteStreamTestHarness(
+      std::string test_name, uint64_t capacity,
+      ByteStream::Storage storage = ByteStream::Storage::Chunked)
+      : TestHarness(move(test_name),
+                    "capacity=" + std::to_string(capacity) +
+                        (storage == ByteStream::Storage::Ring ? ", ring" : ""),
+                    ByteStream{capacity, storage}) {}
 
   size_t peek_size() { return object().reader().peek().size(); }
 };
@@ -36,6 +42,45 @@ struct Push : public Action<ByteStream> {
   void execute(ByteStream& bs) const override { bs.writer().push(data_); }
 };
 
+struct PushView : public Push {
+  using Push::Push;
+  std::string description() const override {
+    return "push view \"" + Printer::prettify(data_) + "\" to the stream";
+  }
+  void execute(ByteStream& bs) const override {
+    bs.writer().push(std::string_view{data_});
+  }
+};
+
+// Pushes a slice of a shared Buffer, then checks the stream did not copy it
+struct PushSlice : public Action<ByteStream> {
+  Buffer data_;
+  size_t pos_;
+  size_t len_;
+
+  PushSlice(Buffer data, size_t pos, size_t len)
+      : data_(std::move(data)), pos_(pos), len_(len) {}
+  std::string description() const override {
+    return "push slice \"" +
+           Printer::prettify(std::string_view{data_}.substr(pos_, len_)) +
+           "\" to the stream";
+  }
+  void execute(ByteStream& bs) const override {
+    const Buffer slice = data_.substr(pos_, len_);
+    const auto before = bs.reader().bytes_buffered();
+    bs.writer().push(slice);
+    if (bs.storage() == ByteStream::Storage::Ring or
+        bs.reader().bytes_buffered() == before) {
+      return;
+    }
+    std::vector<std::string_view> views;
+    bs.reader().peek_vectored(views);
+    if (views.back().data() != std::string_view{slice}.data()) {
+      throw ExpectationViolation{"Writer::push(Buffer) copied the payload"};
+    }
+  }
+};
+
 struct Close : public Action<ByteStream> {
   std::string description() const override { return "close"; }
   void execute(ByteStream& bs) const override { bs.writer().close(); }
@@ -56,6 +101,18 @@ struct Pop : public Action<ByteStream> {
   void execute(ByteStream& bs) const override { bs.reader().pop(len_); }
 };
 
+struct SetCapacity : public Action<ByteStream> {
+  uint64_t capacity_;
+
+  explicit SetCapacity(uint64_t capacity) : capacity_(capacity) {}
+  std::string description() const override {
+    return "set_capacity( " + std::to_string(capacity_) + " )";
+  }
+  void execute(ByteStream& bs) const override {
+    bs.writer().set_capacity(capacity_);
+  }
+};
+
 /* expectations */
 
 struct Peek : public Expectation<ByteStream> {
@@ -108,6 +165,79 @@ struct PeekOnce : public Peek {
   }
 };
 
+struct PeekVectored : public Expectation<ByteStream> {
+  std::vector<std::string> output_;
+  uint64_t limit_;
+
+  explicit PeekVectored(std::vector<std::string> output,
+                        uint64_t limit = UINT64_MAX)
+      : output_(move(output)), limit_(limit) {}
+
+  std::string description() const override {
+    std::string ret = "peek_vectored(";
+    ret += limit_ == UINT64_MAX ? "" : std::to_string(limit_);
+    ret += ") gives {";
+    for (const auto& s : output_) {
+      ret += " \"" + Printer::prettify(s) + "\"";
+    }
+    return ret + " }";
+  }
+
+  void execute(ByteStream& bs) const override {
+    std::vector<std::string_view> views;
+    bs.reader().peek_vectored(views, limit_);
+    if (views.size() != output_.size() or
+        not std::equal(views.begin(), views.end(), output_.begin())) {
+      std::string got;
+      for (const auto view : views) {
+        got += " \"" + Printer::prettify(view) + "\"";
+      }
+      throw ExpectationViolation{"Expected different regions, found {" + got +
+                                 " }"};
+    }
+  }
+};
+
+struct PeekBuffer : public Expectation<ByteStream> {
+  uint64_t offset_;
+  uint64_t len_;
+  std::string output_;
+  bool shared_;
+
+  PeekBuffer(uint64_t offset, uint64_t len, std::string output, bool shared)
+      : offset_(offset), len_(len), output_(move(output)), shared_(shared) {}
+
+  std::string description() const override {
+    return "peek_buffer(" + std::to_string(offset_) + ", " +
+           std::to_string(len_) + ") gives " + (shared_ ? "shared" : "copied") +
+           " \"" + Printer::prettify(output_) + "\"";
+  }
+
+  void execute(ByteStream& bs) const override {
+    const Buffer got = bs.reader().peek_buffer(offset_, len_);
+    const std::string_view view = got;
+    if (view != output_) {
+      throw ExpectationViolation{"Expected \"" + Printer::prettify(output_) +
+                                 "\", but found \"" +
+                                 Printer::prettify(view) + "\""};
+    }
+
+    std::vector<std::string_view> regions;
+    bs.reader().peek_vectored(regions);
+    const bool shared =
+        not view.empty() and
+        std::any_of(regions.begin(), regions.end(), [&](auto region) {
+          return view.data() >= region.data() and
+                 view.data() < region.data() + region.size();
+        });
+    if (shared != shared_) {
+      throw ExpectationViolation{std::string{"Expected the Buffer to "} +
+                                 (shared_ ? "share" : "not share") +
+                                 " the stream's storage"};
+    }
+  }
+};
+
 struct IsClosed : public ExpectBool<ByteStream> {
   using ExpectBool::ExpectBool;
   std::string name() const override { return "is_closed"; }
@@ -144,6 +274,14 @@ struct BufferEmpty : public ExpectBool<ByteStream> {
   }
 };
 
+struct Capacity : public ExpectNumber<ByteStream, uint64_t> {
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "capacity"; }
+  uint64_t value(ByteStream& bs) const override {
+    return bs.writer().capacity();
+  }
+};
+
 struct AvailableCapacity : public ExpectNumber<ByteStream, uint64_t> {
   using ExpectNumber::ExpectNumber;
   std::string name() const override { return "available_capacity"; }
@@ -0,0 +1,59 @@
+#include <exception>
+#include <iostream>
+
+#include "byte_stream.hh"
+#include "byte_stream_test_harness.hh"
+
+using namespace std;
+
+int main() {
+  try {
+    {
+      ByteStreamTestHarness test{"vectored chunks", 15};
+
+      test.execute(PeekVectored{{}});
+      test.execute(Push{"cat"});
+      test.execute(Push{"dog"});
+      test.execute(Push{"bird"});
+      test.execute(PeekVectored{{"cat", "dog", "bird"}});
+      test.execute(Pop{1});
+      test.execute(PeekVectored{{"at", "dog", "bird"}});
+      test.execute(PeekVectored{{"at", "do"}, 4});
+      test.execute(PeekVectored{{"at"}, 2});
+      test.execute(PeekVectored{{}, 0});
+      test.execute(Pop{4});
+      test.execute(PeekVectored{{"g", "bird"}});
+      test.execute(BytesBuffered{5});
+    }
+
+    {
+      ByteStreamTestHarness test{"vectored ring", 6, ByteStream::Storage::Ring};
+
+      test.execute(Push{"abcd"});
+      test.execute(PeekVectored{{"abcd"}});
+      test.execute(Pop{3});
+      test.execute(Push{"efgh"});
+      test.execute(PeekVectored{{"def", "gh"}});
+      test.execute(PeekVectored{{"def", "g"}, 4});
+      test.execute(PeekVectored{{"de"}, 2});
+      test.execute(Pop{3});
+      test.execute(PeekVectored{{"gh"}});
+    }
+
+    {
+      ByteStreamTestHarness test{"vectored read", 10};
+
+      test.execute(Push{"ab"});
+      test.execute(Push{"cde"});
+      test.execute(Push{"fghij"});
+      test.execute(Pop{1});
+      test.execute(ReadAll{"bcdefghij"});
+      test.execute(BytesPopped{10});
+    }
+  } catch (const exception& e) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+#include <exception>
+#include <iostream>
+
+#include "byte_stream.hh"
+#include "byte_stream_test_harness.hh"
+
+using namespace std;
+
+int main() {
+  try {
+    for (const auto storage :
+         {ByteStream::Storage::Chunked, ByteStream::Storage::Ring}) {
+      {
+        ByteStreamTestHarness test{"push views", 5, storage};
+
+        test.execute(PushView{"cat"});
+        test.execute(PushView{"dog"});
+        test.execute(BytesPushed{5});
+        test.execute(AvailableCapacity{0});
+        test.execute(Peek{"catdo"});
+        test.execute(Pop{4});
+        test.execute(PushView{"bird"});
+        test.execute(Peek{"obird"});
+      }
+
+      {
+        ByteStreamTestHarness test{"push slices", 6, storage};
+
+        const Buffer shared{string{"0123456789"}};
+        test.execute(PushSlice{shared, 2, 3});
+        test.execute(PushSlice{shared, 0, 10});
+        test.execute(BytesPushed{6});
+        test.execute(Peek{"234012"});
+        test.execute(Pop{6});
+        test.execute(PushSlice{shared, 7, 5});
+        test.execute(Close{});
+        test.execute(ReadAll{"789"});
+        test.execute(IsFinished{true});
+      }
+    }
+
+    {
+      ByteStreamTestHarness test{"peek buffers", 20};
+
+      test.execute(Push{"hello"});
+      test.execute(Push{"world"});
+      test.execute(PeekBuffer{1, 3, "ell", true});
+      test.execute(PeekBuffer{5, 100, "world", true});
+      test.execute(PeekBuffer{3, 4, "lowo", false});
+      test.execute(PeekBuffer{10, 1, "", false});
+
+      // A slice outlives the bytes being popped
+      test.execute(Pop{7});
+      test.execute(PeekBuffer{0, 3, "rld", true});
+      test.execute(BytesBuffered{3});
+    }
+
+    {
+      ByteStreamTestHarness test{"peek buffers deep in the queue", 100};
+
+      for (const char* chunk : {"ab", "cde", "f", "ghij", "klm", "nop"}) {
+        test.execute(Push{chunk});
+      }
+      test.execute(PeekBuffer{6, 4, "ghij", true});
+      test.execute(PeekBuffer{13, 2, "no", true});
+      test.execute(PeekBuffer{4, 7, "efghijk", false});
+
+      // Offsets count from the trimmed front chunk
+      test.execute(Pop{3});
+      test.execute(PeekBuffer{0, 2, "de", true});
+      test.execute(PeekBuffer{3, 4, "ghij", true});
+      test.execute(PeekBuffer{1, 12, "efghijklmnop", false});
+      test.execute(Pop{8});
+      test.execute(PeekBuffer{0, 5, "lmnop", false});
+      test.execute(PeekBuffer{2, 10, "nop", true});
+    }
+
+    {
+      ByteStreamTestHarness test{"peek buffers in a ring", 8,
+                                 ByteStream::Storage::Ring};
+
+      test.execute(Push{"abcdef"});
+      test.execute(Pop{5});
+      test.execute(Push{"ghijk"});
+      test.execute(PeekBuffer{0, 8, "fghijk", false});
+      test.execute(PeekBuffer{2, 2, "hi", false});
+    }
+  } catch (const exception& e) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,238 @@
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "byte_stream.hh"
+#include "eventloop.hh"
+#include "eventloop_streams.hh"
+#include "file_descriptor.hh"
+
+using namespace std;
+using namespace std::chrono;
+
+static void check(bool condition, const string& what) {
+  if (not condition) {
+    throw runtime_error("EventLoop test failed: " + what);
+  }
+}
+
+static pair<FileDescriptor, FileDescriptor> make_pipe() {
+  array<int, 2> fds{};
+  if (::pipe2(fds.data(), O_NONBLOCK) != 0) {
+    throw runtime_error("pipe() failed");
+  }
+  return {FileDescriptor{fds[0]}, FileDescriptor{fds[1]}};
+}
+
+static pair<FileDescriptor, FileDescriptor> make_socketpair() {
+  array<int, 2> fds{};
+  if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds.data()) !=
+      0) {
+    throw runtime_error("socketpair() failed");
+  }
+  return {FileDescriptor{fds[0]}, FileDescriptor{fds[1]}};
+}
+
+int main() {
+  try {
+    {
+      // One edge for far more than the stream holds: the loop comes back
+      // to the descriptor when told the stream has been drained
+      auto [read_end, write_end] = make_pipe();
+      const string data(10000, 'x');
+      check(write_end.write(data) == data.size(), "pipe takes the data");
+      write_end.close();
+
+      EventLoop loop;
+      ByteStream stream{100};
+      bool cancelled = false;
+      add_reader(loop, read_end, stream.writer(), [&] { cancelled = true; });
+      check(loop.rule_count() == 1, "one rule");
+
+      string received;
+      for (unsigned i = 0; i < 1000 and not stream.reader().is_finished();
+           ++i) {
+        loop.wait_next_event(10);
+        check(stream.reader().bytes_buffered() <= 100, "within capacity");
+        received += stream.reader().peek();
+        stream.reader().pop(stream.reader().peek().size());
+        loop.notify(read_end);
+      }
+      check(received == data, "all the data");
+      check(stream.reader().is_finished(), "stream closed at EOF");
+      check(cancelled and loop.rule_count() == 0, "rule removed at EOF");
+      check(loop.wait_next_event(-1) == EventLoop::Result::Exit, "exit");
+    }
+
+    {
+      // A writer drains its stream, and goes once the stream is finished
+      auto [read_end, write_end] = make_pipe();
+      EventLoop loop;
+      ByteStream stream{1000};
+      bool cancelled = false;
+      add_writer(loop, write_end, stream.reader(), [&] { cancelled = true; });
+
+      string received;
+      string buffer;
+      stream.writer().push(string(1000, 'a'));
+      loop.wait_next_event(10);
+      read_end.read(buffer);
+      received += buffer;
+      check(received == string(1000, 'a'), "first write");
+
+      // Writable all along, with no new edge: the loop remembers, and is
+      // only asked again once notified
+      stream.writer().push(string(500, 'b'));
+      stream.writer().close();
+      check(loop.wait_next_event(0) == EventLoop::Result::Timeout,
+            "interest is not polled");
+      loop.notify(write_end);
+      check(loop.wait_next_event(0) == EventLoop::Result::Success,
+            "writes without a new edge");
+      read_end.read(buffer);
+      received += buffer;
+      check(received == string(1000, 'a') + string(500, 'b'), "all written");
+      check(cancelled and loop.rule_count() == 0, "rule removed when done");
+    }
+
+    {
+      // Interest, cancellation and timeouts
+      auto [a, b] = make_socketpair();
+      EventLoop loop;
+      unsigned runs = 0;
+      bool interested = false;
+      auto handle = loop.add_rule(
+          a, EventLoop::Direction::In,
+          [&, &a = a] {
+            string buffer;
+            do {
+              a.read(buffer);
+            } while (not buffer.empty());
+            ++runs;
+          },
+          [&] { return interested; });
+      check(loop.wait_next_event(0) == EventLoop::Result::Timeout,
+            "nothing to read");
+      b.write("ping");
+      check(loop.wait_next_event(10) == EventLoop::Result::Timeout and
+                runs == 0,
+            "not interested");
+      interested = true;
+      loop.notify(a);
+      check(loop.wait_next_event(0) == EventLoop::Result::Success and
+                runs == 1,
+            "interested now");
+      check(loop.wait_next_event(0) == EventLoop::Result::Timeout and
+                runs == 1,
+            "read to the end");
+      handle.cancel();
+      b.write("pong");
+      check(loop.wait_next_event(0) == EventLoop::Result::Exit and runs == 1,
+            "cancelled");
+    }
+
+    {
+      // A reset peer ends its own rule, without a signal, and the loop
+      // carries on with the others
+      auto [a, b] = make_socketpair();
+      auto [c, d] = make_socketpair();
+      b.close();
+      EventLoop loop;
+      ByteStream outbound{1000};
+      ByteStream inbound{1000};
+      bool cancelled = false;
+      add_writer(loop, a, outbound.reader(), [&] { cancelled = true; });
+      add_reader(loop, c, inbound.writer());
+      outbound.writer().push(string(100, 'x'));
+      d.write("still here");
+      for (unsigned i = 0; i < 10 and inbound.reader().peek().empty(); ++i) {
+        loop.wait_next_event(10);
+      }
+      check(cancelled, "failed rule removed");
+      check(inbound.reader().peek() == "still here", "other rule ran");
+      check(loop.rule_count() == 1, "one rule left");
+    }
+
+    {
+      // A blocking descriptor is refused, not changed
+      array<int, 2> fds{};
+      check(::pipe(fds.data()) == 0, "pipe");
+      FileDescriptor blocking{fds[0]};
+      FileDescriptor other{fds[1]};
+      EventLoop loop;
+      bool refused = false;
+      try {
+        loop.add_rule(blocking, EventLoop::Direction::In, [] {});
+      } catch (const runtime_error&) {
+        refused = true;
+      }
+      check(refused and loop.rule_count() == 0, "blocking fd refused");
+      check((::fcntl(blocking.fd_num(), F_GETFL) & O_NONBLOCK) == 0,
+            "flags untouched");
+    }
+
+    {
+      // Timers run on the loop's clock, and bound its sleep
+      EventLoop loop;
+      vector<uint64_t> fired;
+      auto first = loop.timers().schedule(20, [&] {
+        fired.push_back(loop.timers().now());
+      });
+      auto second = loop.timers().schedule(100, [&] {
+        fired.push_back(loop.timers().now());
+      });
+      const auto start = steady_clock::now();
+      while (loop.wait_next_event(-1) != EventLoop::Result::Exit) {
+      }
+      const auto elapsed = steady_clock::now() - start;
+      check(fired == vector<uint64_t>{20, 100}, "timers in order");
+      check(elapsed >= milliseconds{100} and elapsed < milliseconds{1000},
+            "slept until the timers");
+    }
+
+    {
+      // Many connections on one thread
+      static constexpr size_t PAIRS = 200;
+      EventLoop loop;
+      vector<pair<FileDescriptor, FileDescriptor>> pairs;
+      vector<ByteStream> streams(PAIRS, ByteStream{64});
+      for (size_t i = 0; i < PAIRS; ++i) {
+        pairs.push_back(make_socketpair());
+        add_reader(loop, pairs[i].first, streams[i].writer());
+      }
+      for (size_t i = 0; i < PAIRS; i += 2) {
+        pairs[i].second.write(to_string(i));
+      }
+      check(loop.wait_next_event(100) == EventLoop::Result::Success,
+            "events");
+      for (size_t i = 0; i < PAIRS; ++i) {
+        const string expected = i % 2 == 0 ? to_string(i) : "";
+        check(streams[i].reader().peek() == expected,
+              "connection " + to_string(i));
+      }
+      for (size_t i = 0; i < PAIRS; ++i) {
+        pairs[i].second.close();
+      }
+      for (unsigned i = 0; i < 10 and loop.rule_count() > 0; ++i) {
+        loop.wait_next_event(100);
+      }
+      check(loop.rule_count() == 0, "all closed");
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "byte_stream.hh"
+#include "random.hh"
+#include "reassembler.hh"
+#include "reassembler_test_harness.hh"
+
+using namespace std;
+
+static constexpr size_t NREPS = 16;
+static constexpr size_t NSEGS = 128;
+static constexpr size_t MAX_SEG_LEN = 512;
+static constexpr size_t BURST = 12;
+
+int main() {
+  try {
+    auto rd = get_random_engine();
+
+    for (const auto engine :
+         {Reassembler::Engine::Map, Reassembler::Engine::Bitmap}) {
+      {
+        ReassemblerTestHarness test{"batch in order", 65000, engine};
+
+        test.execute(InsertBatch{{{"ab", 0}, {"cd", 2}, {"ef", 4}}});
+        test.execute(BytesPending(0));
+        test.execute(ReadAll("abcdef"));
+        test.execute(IsFinished{false});
+      }
+
+      {
+        ReassemblerTestHarness test{"batch out of order", 65000, engine};
+
+        test.execute(InsertBatch{{{"ef", 4}, {"ab", 0}, {"i", 8}}});
+        test.execute(BytesPending(3));
+        test.execute(ReadAll("ab"));
+
+        test.execute(
+            InsertBatch{{{"j", 9}, {"cdefg", 2}, Insert{"h", 7}.is_last()}});
+        test.execute(BytesPending(0));
+        test.execute(ReadAll("cdefghij"));
+        test.execute(IsFinished{false});
+
+        test.execute(InsertBatch{{Insert{"k", 10}.is_last()}});
+        test.execute(ReadAll("k"));
+        test.execute(IsFinished{true});
+      }
+
+      {
+        ReassemblerTestHarness test{"batch overlapping", 65000, engine};
+
+        test.execute(Insert{"cde", 2});
+        test.execute(InsertBatch{
+            {{"bcd", 1}, {"defg", 3}, Insert{"abcdefgh", 0}.is_last()}});
+        test.execute(BytesPending(0));
+        test.execute(ReadAll("abcdefgh"));
+        test.execute(IsFinished{true});
+      }
+
+      {
+        ReassemblerTestHarness test{"batch capacity", 4, engine};
+
+        test.execute(InsertBatch{{{"cdef", 2}, {"ab", 0}}});
+        test.execute(ReadAll("abcd"));
+        test.execute(InsertBatch{{Insert{"ef", 4}.is_last()}});
+        test.execute(ReadAll("ef"));
+        test.execute(IsFinished{true});
+      }
+
+      {
+        ReassemblerTestHarness test{"batch catches up on storage", 10, engine};
+
+        test.execute(Insert{"fgh", 5});
+        test.execute(InsertBatch{{{"abcdef", 0}, {"ghij", 6}}});
+        test.execute(BytesPending(0));
+        test.execute(ReadAll("abcdefghij"));
+      }
+
+      {
+        ReassemblerTestHarness test{"empty batch", 65000, engine};
+
+        test.execute(InsertBatch{{}});
+        test.execute(BytesPushed(0));
+        test.execute(IsFinished{false});
+      }
+
+      // Random overlapping bursts
+      for (unsigned rep_no = 0; rep_no < NREPS; ++rep_no) {
+        ReassemblerTestHarness sr{"batch random " + to_string(rep_no),
+                                  NSEGS * MAX_SEG_LEN, engine};
+
+        vector<tuple<size_t, size_t>> seq_size;
+        size_t offset = 0;
+        for (unsigned i = 0; i < NSEGS; ++i) {
+          const size_t size = 1 + (rd() % (MAX_SEG_LEN - 1));
+          const size_t offs =
+              min(offset, 1 + (static_cast<size_t>(rd()) % 127));
+          seq_size.emplace_back(offset - offs, size + offs);
+          offset += size;
+        }
+        shuffle(seq_size.begin(), seq_size.end(), rd);
+
+        string d(offset, 0);
+        generate(d.begin(), d.end(), [&] { return rd(); });
+
+        for (size_t i = 0; i < seq_size.size(); i += BURST) {
+          vector<Insert> burst;
+          for (size_t j = i; j < min(i + BURST, seq_size.size()); ++j) {
+            auto [off, sz] = seq_size[j];
+            burst.push_back(
+                Insert{d.substr(off, sz), off}.is_last(off + sz == offset));
+          }
+          sr.execute(InsertBatch{burst});
+        }
+
+        sr.execute(BytesPending(0));
+        sr.execute(ReadAll{d});
+        sr.execute(IsFinished{true});
+      }
+
+      // Random bursts into a small window, against inserting one at a time
+      // in index order
+      for (unsigned rep_no = 0; rep_no < NREPS; ++rep_no) {
+        static constexpr uint64_t CAPACITY = 64;
+        string d(16 * CAPACITY, 0);
+        generate(d.begin(), d.end(), [&] { return rd(); });
+
+        Reassembler one_by_one{engine};
+        Reassembler batched{engine};
+        ByteStream one_by_one_stream{CAPACITY};
+        ByteStream batched_stream{CAPACITY};
+        string one_by_one_output;
+        string batched_output;
+        const auto read = [](ByteStream& stream, string& output, size_t len) {
+          while (len > 0 and stream.reader().bytes_buffered() > 0) {
+            const auto peeked = stream.reader().peek().substr(0, len);
+            output += peeked;
+            len -= peeked.size();
+            stream.reader().pop(peeked.size());
+          }
+        };
+
+        for (unsigned burst_no = 0; burst_no < 64; ++burst_no) {
+          const uint64_t next = one_by_one_stream.writer().bytes_pushed();
+          vector<Reassembler::Segment> burst;
+          for (size_t j = 0; j < 1 + rd() % BURST; ++j) {
+            const uint64_t first =
+                min<uint64_t>(d.size() - 1, next - min<uint64_t>(next, 8) +
+                                                rd() % (CAPACITY + 16));
+            const uint64_t len = min<uint64_t>(d.size() - first,
+                                               1 + rd() % (CAPACITY / 2));
+            burst.push_back(
+                {first, Buffer{d.substr(first, len)}, first + len == d.size()});
+          }
+          // The batch is taken in index order
+          sort(burst.begin(), burst.end(), [](const auto& a, const auto& b) {
+            return a.first_index < b.first_index;
+          });
+          for (const auto& segment : burst) {
+            one_by_one.insert(segment.first_index,
+                              Buffer{string{segment.data}},
+                              segment.is_last_substring,
+                              one_by_one_stream.writer());
+          }
+          batched.insert_batch(burst, batched_stream.writer());
+
+          const string where =
+              string{engine == Reassembler::Engine::Map ? "map" : "bitmap"} +
+              " rep " + to_string(rep_no) + ", burst " + to_string(burst_no) +
+              ": pushed " +
+              to_string(one_by_one_stream.writer().bytes_pushed()) + " vs " +
+              to_string(batched_stream.writer().bytes_pushed()) +
+              ", pending " + to_string(one_by_one.bytes_pending()) + " vs " +
+              to_string(batched.bytes_pending());
+          if (batched_stream.writer().bytes_pushed() !=
+                  one_by_one_stream.writer().bytes_pushed() or
+              batched.bytes_pending() != one_by_one.bytes_pending()) {
+            throw runtime_error("batch differs from one at a time: " + where);
+          }
+          const size_t len = rd() % CAPACITY;
+          read(one_by_one_stream, one_by_one_output, len);
+          read(batched_stream, batched_output, len);
+        }
+        read(one_by_one_stream, one_by_one_output, d.size());
+        read(batched_stream, batched_output, d.size());
+        if (batched_output != one_by_one_output or
+            one_by_one_output != d.substr(0, one_by_one_output.size())) {
+          throw runtime_error("batch wrote different bytes");
+        }
+      }
+    }
+  } catch (const exception& e) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
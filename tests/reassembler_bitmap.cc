@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <tuple>
+#include <vector>
+
+#include "random.hh"
+#include "reassembler_test_harness.hh"
+
+using namespace std;
+
+static constexpr auto BITMAP = Reassembler::Engine::Bitmap;
+
+static constexpr size_t NREPS = 32;
+static constexpr size_t NSEGS = 64;
+static constexpr size_t MAX_SEG_LEN = 300;
+
+int main() {
+  try {
+    auto rd = get_random_engine();
+
+    {
+      ReassemblerTestHarness test{"bitmap holes", 65000, BITMAP};
+
+      test.execute(Insert{"b", 1});
+      test.execute(Insert{"d", 3});
+      test.execute(BytesPending(2));
+      test.execute(ReadAll(""));
+
+      test.execute(Insert{"c", 2});
+      test.execute(BytesPending(3));
+      test.execute(ReadAll(""));
+
+      test.execute(Insert{"a", 0});
+      test.execute(BytesPending(0));
+      test.execute(ReadAll("abcd"));
+      test.execute(IsFinished{false});
+    }
+
+    {
+      ReassemblerTestHarness test{"bitmap overlap", 65000, BITMAP};
+
+      test.execute(Insert{"cdef", 2});
+      test.execute(Insert{"efgh", 4});
+      test.execute(BytesPending(6));
+
+      test.execute(Insert{"bcd", 1});
+      test.execute(BytesPending(7));
+
+      test.execute(Insert{"abcdefghij", 0}.is_last());
+      test.execute(BytesPending(0));
+      test.execute(ReadAll("abcdefghij"));
+      test.execute(IsFinished{true});
+    }
+
+    {
+      ReassemblerTestHarness test{"bitmap capacity", 8, BITMAP};
+
+      // Bytes beyond the available capacity are dropped
+      test.execute(Insert{"defghijk", 3});
+      test.execute(BytesPending(5));
+
+      test.execute(Insert{"abc", 0});
+      test.execute(BytesPending(0));
+      test.execute(ReadAll("abcdefgh"));
+
+      test.execute(Insert{"ijkl", 8}.is_last());
+      test.execute(ReadAll("ijkl"));
+      test.execute(IsFinished{true});
+    }
+
+    {
+      // Small capacity, so the stream wraps around the ring many times
+      ReassemblerTestHarness test{"bitmap wraparound", 100, BITMAP};
+
+      for (uint64_t base = 0; base < 1000; base += 100) {
+        string block(100, 0);
+        generate(block.begin(), block.end(), [&] { return rd(); });
+
+        test.execute(
+            Insert{block.substr(50), base + 50}.is_last(base + 100 == 1000));
+        test.execute(Insert{block.substr(10, 30), base + 10});
+        test.execute(BytesPending(80));
+        test.execute(Insert{block.substr(0, 20), base});
+        test.execute(BytesPending(50));
+        test.execute(Insert{block.substr(35, 20), base + 35});
+        test.execute(BytesPending(0));
+        test.execute(ReadAll(block));
+      }
+      test.execute(BytesPushed(1000));
+      test.execute(IsFinished{true});
+    }
+
+    // Random overlapping segments with a window smaller than the stream
+    for (unsigned rep_no = 0; rep_no < NREPS; ++rep_no) {
+      ReassemblerTestHarness sr{"bitmap random " + to_string(rep_no),
+                                NSEGS * MAX_SEG_LEN / 4, BITMAP};
+
+      vector<tuple<size_t, size_t>> seq_size;
+      size_t offset = 0;
+      for (unsigned i = 0; i < NSEGS; ++i) {
+        const size_t size = 1 + (rd() % (MAX_SEG_LEN - 1));
+        const size_t offs = min(offset, 1 + (static_cast<size_t>(rd()) % 127));
+        seq_size.emplace_back(offset - offs, size + offs);
+        offset += size;
+      }
+
+      string d(offset, 0);
+      generate(d.begin(), d.end(), [&] { return rd(); });
+
+      // Shuffle within groups of 8 segments (each group fits in the window),
+      // reading after each group so the window keeps sliding forward
+      size_t read = 0;
+      for (size_t i = 0; i < seq_size.size(); i += 8) {
+        const auto group = seq_size.begin() + static_cast<ptrdiff_t>(i);
+        const size_t group_end = get<0>(group[7]) + get<1>(group[7]);
+        shuffle(group, group + 8, rd);
+        for (auto it = group; it != group + 8; ++it) {
+          auto [off, sz] = *it;
+          sr.execute(
+              Insert{d.substr(off, sz), off}.is_last(off + sz == offset));
+        }
+        sr.execute(BytesPending(0));
+        sr.execute(ReadAll{d.substr(read, group_end - read)});
+        read = group_end;
+      }
+
+      sr.execute(IsFinished{true});
+    }
+  } catch (const exception& e) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "byte_stream.hh"
+
+#include "reassembler_test_harness.hh"
+
+using namespace std;
+
+int main() {
+  try {
+    for (const auto engine :
+         {Reassembler::Engine::Map, Reassembler::Engine::Bitmap}) {
+      {
+        ReassemblerTestHarness test{"budget drops farthest", 1000, engine};
+        test.execute(SetMemoryBudget{6});
+
+        test.execute(Insert{"cd", 2});
+        test.execute(Insert{"ghij", 6});
+        test.execute(BytesPending(6));
+        test.execute(Evictions(0));
+
+        // The new bytes are nearer than "ij", which goes
+        test.execute(Insert{"ef", 4});
+        test.execute(BytesPending(6));
+        test.execute(Evictions(1));
+        test.execute(BytesEvicted(2));
+
+        // Bytes beyond the budget are dropped as they arrive
+        test.execute(Insert{"klm", 10});
+        test.execute(BytesPending(6));
+        test.execute(Evictions(2));
+        test.execute(BytesEvicted(5));
+
+        test.execute(Insert{"ab", 0});
+        test.execute(BytesPending(0));
+        test.execute(ReadAll("abcdefgh"));
+
+        // Dropped bytes are accepted again once they are resent
+        test.execute(Insert{"ijklm", 8}.is_last());
+        test.execute(ReadAll("ijklm"));
+        test.execute(IsFinished{true});
+        test.execute(BytesEvicted(5));
+      }
+
+      {
+        ReassemblerTestHarness test{"zero budget", 1000, engine};
+        test.execute(SetMemoryBudget{0});
+
+        test.execute(Insert{"b", 1});
+        test.execute(BytesPending(0));
+        test.execute(Insert{"a", 0});
+        test.execute(ReadAll("a"));
+        test.execute(Insert{"bc", 1});
+        test.execute(ReadAll("bc"));
+        test.execute(Evictions(1));
+      }
+
+      {
+        // Pressure from all Reassemblers together
+        Reassembler::set_global_memory_budget(10);
+        ReassemblerTestHarness first{"global budget (first)", 1000, engine};
+        ReassemblerTestHarness second{"global budget (second)", 1000, engine};
+
+        first.execute(Insert{"bcdefgh", 1});
+        first.execute(BytesPending(7));
+
+        // Over the shared budget: the inserting Reassembler gives way
+        second.execute(Insert{"bcdefgh", 1});
+        second.execute(BytesPending(3));
+        second.execute(BytesEvicted(4));
+        first.execute(BytesPending(7));
+        first.execute(Evictions(0));
+
+        first.execute(Insert{"a", 0});
+        first.execute(ReadAll("abcdefgh"));
+        second.execute(Insert{"efghi", 4});
+        second.execute(BytesPending(8));
+        second.execute(Insert{"a", 0});
+        second.execute(ReadAll("abcdefghi"));
+        Reassembler::set_global_memory_budget(UINT64_MAX);
+      }
+    }
+
+    {
+      // A byte kept from a full frame must not keep the whole frame alive
+      ByteStream stream{10000};
+      Reassembler reassembler;
+      const Buffer frame{string(1500, 'x') + "y"};
+      reassembler.insert(1, frame.substr(1500, 1), false, stream.writer());
+      reassembler.insert(0, Buffer{"a"}, false, stream.writer());
+      const Buffer kept = stream.reader().peek_buffer(1, 1);
+      if (string_view{kept} != "y" or kept.capacity() >= 1500) {
+        throw runtime_error("stored slice pins its frame (" +
+                            to_string(kept.capacity()) + " bytes)");
+      }
+    }
+  } catch (const exception& e) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -6,21 +6,119 @@
 #include <iostream>
 #include <queue>
 #include <random>
+#include <string_view>
 #include <tuple>
+#include <vector>
 
+#include "allocation_counter.hh"
+#include "chunk_pool.hh"
 #include "reassembler.hh"
 
 using namespace std;
 using namespace std::chrono;
 
+// How the stream is cut into segments and in what order they arrive
+enum class Pattern {
+  Overlapping,  // three overlapping copies of each 2*capacity stretch
+  Swapped,      // adjacent pairs of segments arrive in reverse order
+  Holes,        // within each capacity block, odd segments before even
+  Shuffled,     // each capacity block's segments in random order
+  InOrder,      // 99% in order; rarely a segment is late by one
+};
+
+constexpr string_view pattern_name(Pattern pattern) {
+  switch (pattern) {
+    case Pattern::Overlapping:
+      return "overlapping";
+    case Pattern::Swapped:
+      return "swapped";
+    case Pattern::Holes:
+      return "holes";
+    case Pattern::Shuffled:
+      return "shuffled";
+    case Pattern::InOrder:
+      return "99% in order";
+  }
+  return "";
+}
+
+static constexpr size_t SEGMENT_SIZE = 100;
+
+queue<tuple<uint64_t, string, bool>> split(const string& data,
+                                           const size_t capacity,
+                                           const Pattern pattern,
+                                           default_random_engine& rd) {
+  queue<tuple<uint64_t, string, bool>> split_data;
+  const auto emplace = [&](size_t first, size_t len) {
+    split_data.emplace(first, data.substr(first, len),
+                       first + len >= data.size());
+  };
+
+  if (pattern == Pattern::Overlapping) {
+    for (size_t i = 0; i < data.size(); i += capacity) {
+      emplace(i + 2, capacity * 2);
+      emplace(i, capacity * 2);
+      emplace(i + 1, capacity * 2);
+    }
+    return split_data;
+  }
+
+  if (pattern == Pattern::InOrder) {
+    bernoulli_distribution late{0.01};
+    for (size_t i = 0; i < data.size(); i += SEGMENT_SIZE) {
+      if (late(rd) and i + SEGMENT_SIZE < data.size()) {
+        emplace(i + SEGMENT_SIZE, SEGMENT_SIZE);
+        emplace(i, SEGMENT_SIZE);
+        i += SEGMENT_SIZE;
+      } else {
+        emplace(i, SEGMENT_SIZE);
+      }
+    }
+    return split_data;
+  }
+
+  for (size_t block = 0; block < data.size(); block += capacity) {
+    const size_t block_end = min(block + capacity, data.size());
+    vector<size_t> firsts;
+    for (size_t i = block; i < block_end; i += SEGMENT_SIZE) {
+      firsts.push_back(i);
+    }
+    switch (pattern) {
+      case Pattern::Swapped:
+        for (size_t i = 0; i + 1 < firsts.size(); i += 2) {
+          swap(firsts[i], firsts[i + 1]);
+        }
+        break;
+      case Pattern::Holes:
+        stable_partition(firsts.begin(), firsts.end(), [&](size_t first) {
+          return (first - block) / SEGMENT_SIZE % 2 == 1;
+        });
+        break;
+      case Pattern::Shuffled:
+        shuffle(firsts.begin(), firsts.end(), rd);
+        break;
+      case Pattern::Overlapping:
+      case Pattern::InOrder:
+        break;
+    }
+    for (const size_t first : firsts) {
+      emplace(first, min(SEGMENT_SIZE, block_end - first));
+    }
+  }
+  return split_data;
+}
+
 void speed_test(
     const size_t num_chunks,   // NOLINT(bugprone-easily-swappable-parameters)
     const size_t capacity,     // NOLINT(bugprone-easily-swappable-parameters)
-    const size_t random_seed)  // NOLINT(bugprone-easily-swappable-parameters)
-{
+    const size_t random_seed,  // NOLINT(bugprone-easily-swappable-parameters)
+    const Reassembler::Engine engine, const Pattern pattern,
+    const size_t burst,  // segments per insert_batch(), or 1 for insert()
+    const bool check_allocations) {
+  default_random_engine rd{random_seed};
+
   // Generate the data to be written
   const string data = [&] {
-    default_random_engine rd{random_seed};
     uniform_int_distribution<char> ud;
     string ret;
     for (size_t i = 0; i < num_chunks * capacity; ++i) {
@@ -30,28 +128,37 @@ void speed_test(
   }();
 
   // Split the data into segments before writing
-  queue<tuple<uint64_t, string, bool>> split_data;
-  for (size_t i = 0; i < data.size(); i += capacity) {
-    split_data.emplace(i + 2, data.substr(i + 2, capacity * 2),
-                       i + 2 + capacity * 2 >= data.size());
-    split_data.emplace(i, data.substr(i, capacity * 2),
-                       i + capacity * 2 >= data.size());
-    split_data.emplace(i + 1, data.substr(i + 1, capacity * 2),
-                       i + 1 + capacity * 2 >= data.size());
-  }
+  auto split_data = split(data, capacity, pattern, rd);
 
   ByteStream stream{capacity};
-  Reassembler reassembler;
+  Reassembler reassembler{engine};
 
   string output_data;
   output_data.reserve(data.size());
 
+  vector<Reassembler::Segment> batch;
+  batch.reserve(burst);
+
+  const size_t num_segments = split_data.size();
+  ChunkPool::reset_stats();
+  const uint64_t allocations_before = global_allocation_count;
   const auto start_time = steady_clock::now();
   while (not split_data.empty()) {
-    auto& next = split_data.front();
-    reassembler.insert(get<uint64_t>(next), move(get<string>(next)),
-                       get<bool>(next), stream.writer());
-    split_data.pop();
+    if (burst == 1) {
+      auto& next = split_data.front();
+      reassembler.insert(get<uint64_t>(next), move(get<string>(next)),
+                         get<bool>(next), stream.writer());
+      split_data.pop();
+    } else {
+      batch.clear();
+      while (not split_data.empty() and batch.size() < burst) {
+        auto& next = split_data.front();
+        batch.push_back({get<uint64_t>(next), move(get<string>(next)),
+                         get<bool>(next)});
+        split_data.pop();
+      }
+      reassembler.insert_batch(batch, stream.writer());
+    }
 
     while (stream.reader().bytes_buffered()) {
       output_data += stream.reader().peek();
@@ -60,6 +167,8 @@ void speed_test(
   }
 
   const auto stop_time = steady_clock::now();
+  const uint64_t allocations = global_allocation_count - allocations_before;
+  const auto pool = ChunkPool::stats();
 
   if (not stream.reader().is_finished()) {
     throw runtime_error("Reassembler did not close ByteStream when finished");
@@ -78,23 +187,53 @@ void speed_test(
   fstream debug_output;
   debug_output.open("/dev/tty");
 
-  cout << "Reassembler to ByteStream with capacity=" << capacity << " reached "
-       << fixed << setprecision(2) << gigabits_per_second << " Gbit/s.\n";
-
-  debug_output << "             Reassembler throughput: " << fixed
+  const string_view engine_name =
+      engine == Reassembler::Engine::Bitmap ? "bitmap" : "map";
+  const string mode =
+      burst == 1 ? "" : ", batches of " + to_string(burst);
+  cout << "Reassembler (" << engine_name << ", " << pattern_name(pattern)
+       << mode << ") to ByteStream with capacity=" << capacity << " reached "
+       << fixed << setprecision(2) << gigabits_per_second << " Gbit/s, "
+       << allocations << " heap allocations (chunk pool " << pool.hits
+       << " hits, " << pool.misses << " misses).\n";
+
+  debug_output << "             Reassembler throughput (" << engine_name
+               << ", " << pattern_name(pattern) << mode << "): " << fixed
                << setprecision(2) << gigabits_per_second << " Gbit/s\n";
 
   if (gigabits_per_second < 0.1) {
     throw runtime_error(
         "Reassembler did not meet minimum speed of 0.1 Gbit/s.");
   }
+
+  // Stored out-of-order segments may need a node each, but nothing more
+  if (check_allocations and allocations > num_segments) {
+    throw runtime_error("Reassembler made " + to_string(allocations) +
+                        " heap allocations for " + to_string(num_segments) +
+                        " segments (expected at most one per segment).");
+  }
 }
 
-void program_body() { speed_test(10000, 1500, 1370); }
+void program_body(bool check_allocations) {
+  for (const auto engine :
+       {Reassembler::Engine::Map, Reassembler::Engine::Bitmap}) {
+    for (const auto pattern : {Pattern::Overlapping, Pattern::Swapped,
+                               Pattern::Holes, Pattern::Shuffled,
+                               Pattern::InOrder}) {
+      speed_test(10000, 1500, 1370, engine, pattern, 1, check_allocations);
+    }
+    // Bursts of one capacity block, as a GRO or recvmmsg batch might be
+    for (const auto pattern :
+         {Pattern::Swapped, Pattern::Holes, Pattern::Shuffled}) {
+      speed_test(10000, 1500, 1370, engine, pattern, 1500 / SEGMENT_SIZE,
+                 check_allocations);
+    }
+  }
+}
 
-int main() {
+int main(int argc, char* argv[]) {
   try {
-    program_body();
+    program_body(argc > 1 and string_view{argv[1]} == "--check-allocations");
   } catch (const exception& e) {
     cerr << "Exception: " << e.what() << "\n";
     return EXIT_FAILURE;
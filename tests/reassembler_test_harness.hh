@@ -3,6 +3,7 @@
 #include <optional>
 #include <sstream>
 #include <utility>
+#include <vector>
 
 #include "byte_stream_test_harness.hh"
 #include "common.hh"
@@ -28,9 +29,15 @@ struct ReassemblerByteStreamTestStep : public TestStep<StreamAndReassembler> {
 
 class ReassemblerTestHarness : public TestHarness<StreamAndReassembler> {
  public:
-  ReassemblerTestHarness(std::string test_name, uint64_t capacity)
-      : TestHarness(move(test_name), "capacity=" + std::to_string(capacity),
-                    {ByteStream{capacity}, Reassembler{}}) {}
+  ReassemblerTestHarness(
+      std::string test_name, uint64_t capacity,
+      Reassembler::Engine engine = Reassembler::Engine::Map)
+      : TestHarness(move(test_name),
+                    "capacity=" + std::to_string(capacity) +
+                        (engine == Reassembler::Engine::Bitmap
+                             ? ", engine=bitmap"
+                             : ""),
+                    {ByteStream{capacity}, Reassembler{engine}}) {}
 
   template <std::derived_from<TestStep<ByteStream>> T>
   void execute(const T& test) {
@@ -49,6 +56,33 @@ struct BytesPending : public ExpectNumber<StreamAndReassembler, uint64_t> {
   }
 };
 
+struct BytesEvicted : public ExpectNumber<StreamAndReassembler, uint64_t> {
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "eviction_stats().bytes"; }
+  uint64_t value(StreamAndReassembler& sr) const override {
+    return sr.second.eviction_stats().bytes;
+  }
+};
+
+struct Evictions : public ExpectNumber<StreamAndReassembler, uint64_t> {
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "eviction_stats().evictions"; }
+  uint64_t value(StreamAndReassembler& sr) const override {
+    return sr.second.eviction_stats().evictions;
+  }
+};
+
+struct SetMemoryBudget : public Action<StreamAndReassembler> {
+  uint64_t bytes_;
+  explicit SetMemoryBudget(uint64_t bytes) : bytes_(bytes) {}
+  std::string description() const override {
+    return "set memory budget to " + std::to_string(bytes_);
+  }
+  void execute(StreamAndReassembler& sr) const override {
+    sr.second.set_memory_budget(bytes_);
+  }
+};
+
 struct Insert : public Action<StreamAndReassembler> {
   std::string data_;
   uint64_t first_index_;
@@ -77,3 +111,27 @@ struct Insert : public Action<StreamAndReassembler> {
                      sr.first.writer());
   }
 };
+
+struct InsertBatch : public Action<StreamAndReassembler> {
+  std::vector<Insert> inserts_;
+
+  explicit InsertBatch(std::vector<Insert> inserts)
+      : inserts_(move(inserts)) {}
+
+  std::string description() const override {
+    std::string ret = "insert batch {";
+    for (const auto& insert : inserts_) {
+      ret += " " + insert.description() + ";";
+    }
+    return ret + " }";
+  }
+
+  void execute(StreamAndReassembler& sr) const override {
+    std::vector<Reassembler::Segment> segments;
+    for (const auto& insert : inserts_) {
+      segments.push_back(
+          {insert.first_index_, insert.data_, insert.is_last_substring_});
+    }
+    sr.second.insert_batch(segments, sr.first.writer());
+  }
+};
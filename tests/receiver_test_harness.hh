@@ -3,6 +3,7 @@
 #include <optional>
 #include <sstream>
 #include <utility>
+#include <vector>
 
 #include "common.hh"
 #include "reassembler_test_harness.hh"
@@ -26,9 +27,36 @@ struct ReceiverSetTestStep : public TestStep<ReceiverSet> {
 
 class TCPReceiverTestHarness : public TestHarness<ReceiverSet> {
  public:
-  TCPReceiverTestHarness(std::string test_name, uint64_t capacity)
-      : TestHarness(move(test_name), "capacity=" + std::to_string(capacity),
-                    {{ByteStream{capacity}, Reassembler{}}, TCPReceiver{}}) {}
+  TCPReceiverTestHarness(
+      std::string test_name, uint64_t capacity,
+      Reassembler::Engine engine = Reassembler::Engine::Map)
+      : TestHarness(move(test_name),
+                    "capacity=" + std::to_string(capacity) +
+                        (engine == Reassembler::Engine::Bitmap
+                             ? ", engine=bitmap"
+                             : ""),
+                    {{ByteStream{capacity}, Reassembler{engine}},
+                     TCPReceiver{}}) {}
+
+  // With a receiver that offered window scaling
+  TCPReceiverTestHarness(std::string test_name, uint64_t capacity,
+                         uint8_t offered_window_shift)
+      : TestHarness(move(test_name),
+                    "capacity=" + std::to_string(capacity) +
+                        ", offered_window_shift=" +
+                        std::to_string(offered_window_shift),
+                    {{ByteStream{capacity}, Reassembler{}},
+                     TCPReceiver{offered_window_shift}}) {}
+
+  TCPReceiverTestHarness(std::string test_name, const TCPConfig& config)
+      : TestHarness(move(test_name),
+                    "capacity=" + std::to_string(config.recv_capacity) +
+                        (config.delayed_ack
+                             ? ", delayed_ack_ms=" +
+                                   std::to_string(config.delayed_ack_ms)
+                             : ""),
+                    {{ByteStream{config.recv_capacity}, Reassembler{}},
+                     TCPReceiver{config}}) {}
 
   template <std::derived_from<TestStep<StreamAndReassembler>> T>
   void execute(const T& test) {
@@ -52,6 +80,77 @@ struct ExpectWindow : public ExpectNumber<ReceiverSet, uint16_t> {
   }
 };
 
+struct ExpectWindowShift : public ExpectNumber<ReceiverSet, int> {
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "window_shift"; }
+  int value(ReceiverSet& rs) const override {
+    return rs.second.send(rs.first.first.writer()).window_shift;
+  }
+};
+
+struct ExpectAcksSent : public ExpectNumber<ReceiverSet, uint64_t> {
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "acks_sent"; }
+  uint64_t value(ReceiverSet& rs) const override {
+    return rs.second.acks_sent();
+  }
+};
+
+struct ExpectAcksSuppressed : public ExpectNumber<ReceiverSet, uint64_t> {
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "acks_suppressed"; }
+  uint64_t value(ReceiverSet& rs) const override {
+    return rs.second.acks_suppressed();
+  }
+};
+
+// maybe_send() returns an ACK, with `ackno` if given
+struct ExpectAck : public Expectation<ReceiverSet> {
+  std::optional<Wrap32> ackno_;
+  explicit ExpectAck(std::optional<Wrap32> ackno = {}) : ackno_(ackno) {}
+
+  std::string description() const override {
+    return "ACK sent" + (ackno_.has_value()
+                             ? " with ackno = " + to_string(ackno_.value())
+                             : std::string{});
+  }
+
+  void execute(ReceiverSet& rs) const override {
+    const auto message =
+        rs.second.maybe_send(rs.first.first.writer(), rs.first.second);
+    if (not message.has_value()) {
+      throw ExpectationViolation("expected an ACK, but none was sent");
+    }
+    if (ackno_.has_value() and message->ackno != ackno_) {
+      throw ExpectationViolation("ackno", ackno_, message->ackno);
+    }
+  }
+};
+
+struct ExpectNoAck : public Expectation<ReceiverSet> {
+  std::string description() const override { return "no ACK sent"; }
+
+  void execute(ReceiverSet& rs) const override {
+    if (rs.second.maybe_send(rs.first.first.writer(), rs.first.second)
+            .has_value()) {
+      throw ExpectationViolation("an ACK was sent when none was expected");
+    }
+  }
+};
+
+struct Tick : public Action<ReceiverSet> {
+  uint64_t ms_;
+  explicit Tick(uint64_t ms) : ms_(ms) {}
+
+  std::string description() const override {
+    return std::to_string(ms_) + " ms pass";
+  }
+
+  void execute(ReceiverSet& rs) const override {
+    rs.second.tick(ms_, rs.first.first.writer());
+  }
+};
+
 struct ExpectAckno : public ExpectNumber<ReceiverSet, std::optional<Wrap32>> {
   using ExpectNumber::ExpectNumber;
   std::string name() const override { return "ackno"; }
@@ -87,6 +186,49 @@ struct ExpectAcknoBetween : public Expectation<ReceiverSet> {
   }
 };
 
+struct ExpectSACK : public Expectation<ReceiverSet> {
+  // Raw [left edge, right edge) pairs, most recent first
+  std::vector<std::pair<uint32_t, uint32_t>> blocks_;
+  explicit ExpectSACK(std::vector<std::pair<uint32_t, uint32_t>> blocks)
+      : blocks_(std::move(blocks)) {}
+
+  static std::string str(Wrap32 left, Wrap32 right) {
+    return "[" + to_string(left) + ", " + to_string(right) + ")";
+  }
+
+  std::string expected() const {
+    std::string ret;
+    for (const auto& [left, right] : blocks_) {
+      ret += " " + str(Wrap32{left}, Wrap32{right});
+    }
+    return ret.empty() ? " (none)" : ret;
+  }
+
+  std::string description() const override {
+    return "sack_blocks =" + expected();
+  }
+
+  void execute(ReceiverSet& rs) const override {
+    const auto message =
+        rs.second.send(rs.first.first.writer(), rs.first.second);
+    std::string actual;
+    for (const auto& block : message.sack_blocks) {
+      actual += " " + str(block.left_edge, block.right_edge);
+    }
+    bool match = message.sack_blocks.size() == blocks_.size();
+    for (size_t i = 0; match and i < blocks_.size(); ++i) {
+      match = message.sack_blocks[i].left_edge == Wrap32{blocks_[i].first} and
+              message.sack_blocks[i].right_edge == Wrap32{blocks_[i].second};
+    }
+    if (not match) {
+      throw ExpectationViolation("The TCPReceiver reported sack_blocks =" +
+                                 (actual.empty() ? " (none)" : actual) +
+                                 ", but they should have been" + expected() +
+                                 ".");
+    }
+  }
+};
+
 struct HasAckno : public ExpectBool<ReceiverSet> {
   using ExpectBool::ExpectBool;
   std::string name() const override { return "ackno.has_value()"; }
@@ -104,6 +246,11 @@ struct SegmentArrives : public Action<ReceiverSet> {
     return *this;
   }
 
+  SegmentArrives& with_window_scale(uint8_t shift) {
+    msg_.window_scale = shift;
+    return *this;
+  }
+
   SegmentArrives& with_fin() {
     msg_.FIN = true;
     return *this;
@@ -140,6 +287,9 @@ struct SegmentArrives : public Action<ReceiverSet> {
     if (msg_.SYN) {
       ss << " +SYN";
     }
+    if (msg_.window_scale.has_value()) {
+      ss << " window_scale=" << static_cast<int>(msg_.window_scale.value());
+    }
     if (not msg_.payload.empty()) {
       ss << " payload=\"" << Printer::prettify(msg_.payload) << "\"";
     }
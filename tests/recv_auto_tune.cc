@@ -0,0 +1,135 @@
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "random.hh"
+#include "receiver_test_harness.hh"
+#include "tcp_config.hh"
+
+using namespace std;
+
+// Each round trip of `rtt_ms`, `bytes` arrive in 1000-byte segments and the
+// application reads them all
+static void round_trip(TCPReceiverTestHarness& test, uint32_t isn,
+                       uint64_t& stream_index, uint64_t bytes,
+                       uint64_t rtt_ms) {
+  for (uint64_t sent = 0; sent < bytes; sent += 1000) {
+    test.execute(SegmentArrives{}
+                     .with_seqno(isn + 1 + static_cast<uint32_t>(stream_index))
+                     .with_data(string(1000, 'x')));
+    stream_index += 1000;
+  }
+  test.execute(BytesPushed{stream_index});
+  test.execute(Pop{bytes});
+  test.execute(Tick{rtt_ms});
+}
+
+int main() {
+  try {
+    auto rd = get_random_engine();
+
+    TCPConfig cfg;
+    cfg.recv_capacity = 4000;
+    cfg.auto_tune_recv = true;
+    cfg.max_recv_capacity = 20000;
+
+    {
+      const uint32_t isn =
+          uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+      TCPReceiverTestHarness test{"grows with the drain rate", cfg};
+      uint64_t stream_index = 0;
+      test.execute(SegmentArrives{}.with_syn().with_seqno(isn));
+      test.execute(ExpectAck{Wrap32{isn + 1}});
+      test.execute(Capacity{4000});
+
+      // The first round trip sets the clock going
+      round_trip(test, isn, stream_index, 4000, 10);
+      test.execute(Capacity{4000});
+      test.execute(ExpectAck{});
+
+      // 4000 bytes drained per 10 ms round trip: room for twice that
+      round_trip(test, isn, stream_index, 4000, 10);
+      test.execute(Capacity{8000});
+      test.execute(ExpectWindow{8000});
+
+      // Each measurement covers the round trip before the last
+      round_trip(test, isn, stream_index, 8000, 10);
+      test.execute(Capacity{8000});
+      round_trip(test, isn, stream_index, 8000, 10);
+      test.execute(Capacity{16000});
+      round_trip(test, isn, stream_index, 16000, 10);
+      round_trip(test, isn, stream_index, 16000, 10);
+      test.execute(Capacity{20000});
+      round_trip(test, isn, stream_index, 20000, 10);
+      round_trip(test, isn, stream_index, 20000, 10);
+      test.execute(Capacity{20000});
+
+      // A slower reader does not shrink it
+      round_trip(test, isn, stream_index, 2000, 10);
+      test.execute(Capacity{20000});
+    }
+
+    {
+      const uint32_t isn =
+          uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+      TCPReceiverTestHarness test{"shrinks when idle", cfg};
+      uint64_t stream_index = 0;
+      test.execute(SegmentArrives{}.with_syn().with_seqno(isn));
+      round_trip(test, isn, stream_index, 4000, 10);
+      round_trip(test, isn, stream_index, 4000, 10);
+      test.execute(Capacity{8000});
+      test.execute(Tick{TCPConfig::RECV_IDLE_MS - 20});
+      test.execute(Capacity{8000});
+
+      // Unread data keeps the memory in use
+      const auto seqno = isn + 1 + static_cast<uint32_t>(stream_index);
+      test.execute(SegmentArrives{}.with_seqno(seqno).with_data("abc"));
+      test.execute(Tick{TCPConfig::RECV_IDLE_MS});
+      test.execute(Capacity{8000});
+      test.execute(Pop{3});
+      test.execute(Tick{1});
+      stream_index += 3;
+
+      // The window already advertised is never retracted: the stream
+      // shrinks as the peer uses it up, with no room given back as it drains
+      test.execute(Capacity{8000});
+      test.execute(ExpectWindow{8000});
+      round_trip(test, isn, stream_index, 2000, 1);
+      test.execute(Capacity{6000});
+      test.execute(ExpectWindow{6000});
+      round_trip(test, isn, stream_index, 6000, 1);
+      test.execute(Capacity{4000});
+      test.execute(ExpectWindow{4000});
+    }
+
+    {
+      const uint32_t isn =
+          uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+      TCPConfig fixed = cfg;
+      fixed.auto_tune_recv = false;
+      TCPReceiverTestHarness test{"fixed capacity by default", fixed};
+      uint64_t stream_index = 0;
+      test.execute(SegmentArrives{}.with_syn().with_seqno(isn));
+      for (int i = 0; i < 4; ++i) {
+        round_trip(test, isn, stream_index, 4000, 10);
+      }
+      test.execute(Capacity{4000});
+    }
+
+    {
+      // The window scale covers the largest capacity
+      TCPConfig scaled = cfg;
+      scaled.max_recv_capacity = 1 << 20;
+      if (scaled.window_shift() != 5) {
+        throw runtime_error("window_shift() should cover max_recv_capacity");
+      }
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
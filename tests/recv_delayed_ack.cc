@@ -0,0 +1,130 @@
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "random.hh"
+#include "receiver_test_harness.hh"
+#include "tcp_config.hh"
+
+using namespace std;
+
+int main() {
+  try {
+    auto rd = get_random_engine();
+
+    TCPConfig delayed;
+    delayed.recv_capacity = 4000;
+    delayed.delayed_ack = true;
+
+    {
+      const uint32_t isn =
+          uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+      TCPConfig cfg;
+      cfg.recv_capacity = 4000;
+      TCPReceiverTestHarness test{"an ACK per segment by default", cfg};
+      test.execute(ExpectNoAck{});
+      test.execute(SegmentArrives{}.with_syn().with_seqno(isn));
+      test.execute(ExpectAck{Wrap32{isn + 1}});
+      test.execute(ExpectNoAck{});
+      test.execute(SegmentArrives{}.with_seqno(isn + 1).with_data("abc"));
+      test.execute(ExpectAck{Wrap32{isn + 4}});
+      test.execute(SegmentArrives{}.with_seqno(isn + 4).with_data("def"));
+      test.execute(ExpectAck{Wrap32{isn + 7}});
+      test.execute(ExpectAcksSent{3});
+      test.execute(ExpectAcksSuppressed{0});
+    }
+
+    {
+      const uint32_t isn =
+          uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+      TCPReceiverTestHarness test{"every second full segment", delayed};
+      test.execute(SegmentArrives{}.with_syn().with_seqno(isn));
+      test.execute(ExpectAck{Wrap32{isn + 1}});
+      test.execute(
+          SegmentArrives{}.with_seqno(isn + 1).with_data(string(1000, 'a')));
+      test.execute(ExpectNoAck{});
+      test.execute(SegmentArrives{}.with_seqno(isn + 1001).with_data(
+          string(1000, 'b')));
+      test.execute(ExpectAck{Wrap32{isn + 2001}});
+      test.execute(ExpectNoAck{});
+      test.execute(ExpectAcksSent{2});
+      test.execute(ExpectAcksSuppressed{1});
+    }
+
+    {
+      const uint32_t isn =
+          uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+      TCPReceiverTestHarness test{"ACK after the delay", delayed};
+      test.execute(SegmentArrives{}.with_syn().with_seqno(isn));
+      test.execute(ExpectAck{Wrap32{isn + 1}});
+      test.execute(SegmentArrives{}.with_seqno(isn + 1).with_data("abc"));
+      test.execute(Tick{39});
+      test.execute(ExpectNoAck{});
+      // The delay runs from the first segment held back
+      test.execute(SegmentArrives{}.with_seqno(isn + 4).with_data("def"));
+      test.execute(Tick{1});
+      test.execute(ExpectAck{Wrap32{isn + 7}});
+      test.execute(Tick{1000});
+      test.execute(ExpectNoAck{});
+      test.execute(ExpectAcksSent{2});
+      test.execute(ExpectAcksSuppressed{1});
+    }
+
+    {
+      const uint32_t isn =
+          uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+      TCPReceiverTestHarness test{"out of order: ACK at once", delayed};
+      test.execute(SegmentArrives{}.with_syn().with_seqno(isn));
+      test.execute(ExpectAck{Wrap32{isn + 1}});
+      test.execute(SegmentArrives{}.with_seqno(isn + 4).with_data("def"));
+      test.execute(ExpectAck{Wrap32{isn + 1}});
+      // Filling the hole
+      test.execute(SegmentArrives{}.with_seqno(isn + 1).with_data("abc"));
+      test.execute(ExpectAck{Wrap32{isn + 7}});
+      // A duplicate
+      test.execute(SegmentArrives{}.with_seqno(isn + 1).with_data("abc"));
+      test.execute(ExpectAck{Wrap32{isn + 7}});
+      test.execute(ExpectAcksSent{4});
+      test.execute(ExpectAcksSuppressed{0});
+    }
+
+    {
+      const uint32_t isn =
+          uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+      TCPReceiverTestHarness test{"FIN: ACK at once", delayed};
+      test.execute(SegmentArrives{}.with_syn().with_seqno(isn));
+      test.execute(ExpectAck{Wrap32{isn + 1}});
+      test.execute(SegmentArrives{}.with_seqno(isn + 1).with_data("abc"));
+      test.execute(ExpectNoAck{});
+      test.execute(
+          SegmentArrives{}.with_seqno(isn + 4).with_data("def").with_fin());
+      test.execute(ExpectAck{Wrap32{isn + 8}});
+      test.execute(ExpectAcksSuppressed{1});
+    }
+
+    {
+      const uint32_t isn =
+          uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+      TCPReceiverTestHarness test{"window update", delayed};
+      test.execute(SegmentArrives{}.with_syn().with_seqno(isn));
+      test.execute(ExpectAck{Wrap32{isn + 1}});
+      test.execute(SegmentArrives{}.with_seqno(isn + 1).with_data(
+          string(2000, 'a')));
+      test.execute(ExpectAck{Wrap32{isn + 2001}});
+      test.execute(ExpectWindow{2000});
+      // Less than an MSS more room: not worth an ACK
+      test.execute(Pop{999});
+      test.execute(ExpectNoAck{});
+      test.execute(Pop{1});
+      test.execute(ExpectAck{Wrap32{isn + 2001}});
+      test.execute(ExpectNoAck{});
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
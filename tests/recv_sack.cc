@@ -0,0 +1,92 @@
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "random.hh"
+#include "receiver_test_harness.hh"
+
+using namespace std;
+
+int main() {
+  try {
+    auto rd = get_random_engine();
+
+    for (const auto engine :
+         {Reassembler::Engine::Map, Reassembler::Engine::Bitmap}) {
+      {
+        const uint32_t isn =
+            uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+        TCPReceiverTestHarness test{"no SACK in order", 4000, engine};
+        test.execute(ExpectSACK{{}});
+        test.execute(SegmentArrives{}.with_syn().with_seqno(isn));
+        test.execute(SegmentArrives{}.with_seqno(isn + 1).with_data("abcd"));
+        test.execute(ExpectAckno{Wrap32{isn + 5}});
+        test.execute(ExpectSACK{{}});
+      }
+
+      {
+        const uint32_t isn =
+            uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+        TCPReceiverTestHarness test{"SACK most recent first", 4000, engine};
+        test.execute(SegmentArrives{}.with_syn().with_seqno(isn));
+        test.execute(SegmentArrives{}.with_seqno(isn + 11).with_data("klmn"));
+        test.execute(ExpectSACK{{{isn + 11, isn + 15}}});
+
+        test.execute(SegmentArrives{}.with_seqno(isn + 21).with_data("uv"));
+        test.execute(ExpectSACK{{{isn + 21, isn + 23}, {isn + 11, isn + 15}}});
+
+        // Extending an older block makes it the most recent
+        test.execute(SegmentArrives{}.with_seqno(isn + 15).with_data("opq"));
+        test.execute(ExpectSACK{{{isn + 11, isn + 18}, {isn + 21, isn + 23}}});
+
+        // Blocks below the ackno disappear
+        test.execute(
+            SegmentArrives{}.with_seqno(isn + 1).with_data("abcdefghij"));
+        test.execute(ExpectAckno{Wrap32{isn + 18}});
+        test.execute(ExpectSACK{{{isn + 21, isn + 23}}});
+        test.execute(ReadAll{"abcdefghijklmnopq"});
+
+        test.execute(SegmentArrives{}.with_seqno(isn + 18).with_data("rst"));
+        test.execute(ExpectAckno{Wrap32{isn + 23}});
+        test.execute(ExpectSACK{{}});
+      }
+
+      {
+        const uint32_t isn =
+            uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+        TCPReceiverTestHarness test{"SACK block limit", 4000, engine};
+        test.execute(SegmentArrives{}.with_syn().with_seqno(isn));
+        for (uint32_t i = 1; i <= 6; ++i) {
+          test.execute(
+              SegmentArrives{}.with_seqno(isn + 1 + 10 * i).with_data("xyz"));
+        }
+        test.execute(ExpectSACK{{{isn + 61, isn + 64},
+                                 {isn + 51, isn + 54},
+                                 {isn + 41, isn + 44},
+                                 {isn + 31, isn + 34}}});
+
+        // A duplicate of an old segment brings its block to the front
+        test.execute(SegmentArrives{}.with_seqno(isn + 11).with_data("xyz"));
+        test.execute(ExpectSACK{{{isn + 11, isn + 14},
+                                 {isn + 61, isn + 64},
+                                 {isn + 51, isn + 54},
+                                 {isn + 41, isn + 44}}});
+      }
+
+      {
+        const uint32_t isn = UINT32_MAX - 5;
+        TCPReceiverTestHarness test{"SACK across wraparound", 4000, engine};
+        test.execute(SegmentArrives{}.with_syn().with_seqno(isn));
+        test.execute(SegmentArrives{}.with_seqno(isn + 4).with_data("defgh"));
+        test.execute(ExpectSACK{{{isn + 4, isn + 9}}});
+      }
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
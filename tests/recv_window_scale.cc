@@ -0,0 +1,86 @@
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "random.hh"
+#include "receiver_test_harness.hh"
+#include "tcp_config.hh"
+
+using namespace std;
+
+int main() {
+  try {
+    auto rd = get_random_engine();
+
+    {
+      // The smallest shift that covers the capacity, up to 14
+      TCPConfig cfg;
+      for (const auto& [capacity, shift] :
+           {pair<size_t, uint8_t>{4000, 0}, {65535, 0}, {65536, 1},
+            {1000000, 4}, {1 << 20, 5}, {size_t{1} << 30, 14},
+            {size_t{1} << 40, 14}}) {
+        cfg.recv_capacity = capacity;
+        if (cfg.window_shift() != shift) {
+          throw runtime_error("window_shift() for capacity " +
+                              to_string(capacity) + " should be " +
+                              to_string(shift));
+        }
+      }
+    }
+
+    {
+      const uint32_t isn =
+          uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+      TCPReceiverTestHarness test{"scaled window", 1000000, 4};
+      test.execute(ExpectWindow{65535});
+      test.execute(ExpectWindowShift{0});
+      test.execute(
+          SegmentArrives{}.with_syn().with_seqno(isn).with_window_scale(7));
+      test.execute(ExpectWindowShift{4});
+      test.execute(ExpectWindow{62500});
+      test.execute(SegmentArrives{}.with_seqno(isn + 1).with_data("abc"));
+      // Rounded down: 999997 >> 4
+      test.execute(ExpectWindow{62499});
+      test.execute(ExpectWindowShift{4});
+    }
+
+    {
+      const uint32_t isn =
+          uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+      TCPReceiverTestHarness test{"peer does not offer scaling", 1000000, 4};
+      test.execute(SegmentArrives{}.with_syn().with_seqno(isn));
+      test.execute(ExpectWindowShift{0});
+      test.execute(ExpectWindow{65535});
+    }
+
+    {
+      const uint32_t isn =
+          uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+      TCPReceiverTestHarness test{"we do not offer scaling", 1000000};
+      test.execute(
+          SegmentArrives{}.with_syn().with_seqno(isn).with_window_scale(7));
+      test.execute(ExpectWindowShift{0});
+      test.execute(ExpectWindow{65535});
+    }
+
+    {
+      const uint32_t isn =
+          uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+      TCPReceiverTestHarness test{"largest shift", 1 << 22, 14};
+      test.execute(
+          SegmentArrives{}.with_syn().with_seqno(isn).with_window_scale(14));
+      test.execute(ExpectWindowShift{14});
+      test.execute(ExpectWindow{256});
+      test.execute(SegmentArrives{}.with_seqno(isn + 1).with_data("a"));
+      test.execute(ExpectWindow{255});
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,241 @@
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+using namespace std;
+
+static constexpr uint16_t BIG_WINDOW = 60000;
+
+// Expect `n` full segments, then one of `rest` bytes if nonzero
+static void expect_segments(TCPSenderTestHarness& test, size_t n,
+                            size_t rest = 0) {
+  for (size_t i = 0; i < n; ++i) {
+    test.execute(ExpectMessage{}.with_payload_size(1000));
+  }
+  if (rest) {
+    test.execute(ExpectMessage{}.with_payload_size(rest));
+  }
+  test.execute(ExpectNoSegment{});
+}
+
+static void check(bool condition, const string& what) {
+  if (not condition) {
+    throw runtime_error(what);
+  }
+}
+
+int main() {
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.congestion_control = TCPConfig::CongestionControl::NewReno;
+
+      TCPSenderTestHarness test{"NewReno slow start and RTO", cfg};
+      test.execute(ExpectCwnd{4000});
+      test.execute(ExpectSsthresh{UINT64_MAX});
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(ExpectCwnd{4001});
+
+      // The congestion window is smaller than the receiver's window
+      test.execute(Push{string(20000, 'x')});
+      expect_segments(test, 4, 1);
+      test.execute(ExpectSeqnosInFlight{4001});
+
+      // Slow start: one segment per ACK
+      test.execute(AckReceived{isn + 1001}.with_win(BIG_WINDOW));
+      test.execute(ExpectCwnd{5001});
+      expect_segments(test, 2);
+      test.execute(AckReceived{isn + 4002}.with_win(BIG_WINDOW));
+      test.execute(ExpectCwnd{6001});
+      expect_segments(test, 4, 1);
+      test.execute(ExpectSeqnosInFlight{6001});
+
+      // A timeout halves the flight size and drops to one segment
+      test.execute(Tick{1000});
+      test.execute(ExpectCwnd{1000});
+      test.execute(ExpectSsthresh{3000});
+      test.execute(ExpectMessage{}.with_payload_size(1000));
+      test.execute(ExpectNoSegment{});
+
+      // Back to slow start until ssthresh, then one segment per window
+      test.execute(AckReceived{isn + 6002}.with_win(BIG_WINDOW));
+      test.execute(ExpectCwnd{2000});
+      test.execute(AckReceived{isn + 7003}.with_win(BIG_WINDOW));
+      test.execute(ExpectCwnd{3000});
+      test.execute(AckReceived{isn + 8003}.with_win(BIG_WINDOW));
+      test.execute(ExpectCwnd{3000});
+      test.execute(AckReceived{isn + 10003}.with_win(BIG_WINDOW));
+      test.execute(ExpectCwnd{4000});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.congestion_control = TCPConfig::CongestionControl::NewReno;
+      cfg.super_segments = true;
+      cfg.fast_retransmit = true;
+
+      TCPSenderTestHarness test{"NewReno loss halves what was sent", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(Push{string(20000, 'x')});
+      expect_segments(test, 4, 1);
+      test.execute(AckReceived{isn + 1001}.with_win(BIG_WINDOW));
+      test.execute(ExpectSeqnosInFlight{5001});
+      test.execute(ExpectMessage{}.with_payload_size(1000));
+
+      // 4001 bytes sent and unacknowledged: the segment still queued is not
+      // in the network and does not count
+      for (int i = 0; i < 3; ++i) {
+        test.execute(AckReceived{isn + 1001}.with_win(BIG_WINDOW));
+      }
+      test.execute(ExpectFastRecovery{true});
+      test.execute(ExpectSsthresh{2000});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.congestion_control = TCPConfig::CongestionControl::NewReno;
+      cfg.super_segments = true;
+
+      TCPSenderTestHarness test{"NewReno timeout halves what was sent", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(Push{string(20000, 'x')});
+      expect_segments(test, 4, 1);
+      test.execute(AckReceived{isn + 1001}.with_win(BIG_WINDOW));
+      test.execute(ExpectSeqnosInFlight{5001});
+      test.execute(ExpectMessage{}.with_payload_size(1000));
+
+      // As for a fast retransmit, the queued segment does not count
+      test.execute(Tick{1000});
+      test.execute(ExpectCwnd{1000});
+      test.execute(ExpectSsthresh{2000});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.congestion_control = TCPConfig::CongestionControl::NewReno;
+
+      TCPSenderTestHarness test{"Receiver window still limits", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(1500));
+      test.execute(Push{string(5000, 'x')});
+      expect_segments(test, 1, 500);
+      test.execute(ExpectSeqnosInFlight{1500});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.congestion_control = TCPConfig::CongestionControl::Cubic;
+
+      TCPSenderTestHarness test{"CUBIC", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(Push{string(50000, 'x')});
+      expect_segments(test, 4, 1);
+
+      // Loses less than Reno on timeout: ssthresh is 0.7 * cwnd
+      test.execute(Tick{1000});
+      test.execute(ExpectCwnd{1000});
+      test.execute(ExpectSsthresh{2800});
+      test.execute(ExpectMessage{}.with_payload_size(1000));
+
+      test.execute(AckReceived{isn + 1001}.with_win(BIG_WINDOW));
+      test.execute(ExpectCwnd{2000});
+      test.execute(AckReceived{isn + 4002}.with_win(BIG_WINDOW));
+      test.execute(ExpectCwnd{3000});
+
+    }
+
+    {
+      // The cubic window curve itself. ACKs are sparse (a long RTT), so
+      // the cubic rather than the Reno estimate is in charge.
+      Cubic cubic{1000};
+      uint64_t now = 0;
+      while (cubic.cwnd() < 10000) {
+        cubic.on_ack(1000, now += 10);
+      }
+      cubic.on_loss(10000, now);
+      check(cubic.cwnd() == 7000 and cubic.ssthresh() == 7000,
+            "CUBIC reduces the window to 0.7 of where the loss was");
+
+      // K = cbrt(W_max * (1 - beta) / C), in segments and seconds
+      const uint64_t loss = now;
+      const uint64_t k_ms = 1957;
+      uint64_t prev_cwnd = cubic.cwnd();
+      uint64_t cwnd_at_k = 0;
+      while (now < loss + k_ms + 3000) {
+        cubic.on_ack(1000, now += 100);
+        check(cubic.cwnd() >= prev_cwnd, "CUBIC window never shrinks on ACK");
+        prev_cwnd = cubic.cwnd();
+        if (cwnd_at_k == 0 and now - loss >= k_ms) {
+          cwnd_at_k = cubic.cwnd();
+        }
+      }
+      check(cwnd_at_k > 9000 and cwnd_at_k < 10500,
+            "CUBIC window is back near W_max after K, but was " +
+                to_string(cwnd_at_k));
+      check(cubic.cwnd() > 13000,
+            "CUBIC window grows past W_max well after K, but was " +
+                to_string(cubic.cwnd()));
+    }
+
+    {
+      // The window grows towards where the cubic will be an RTT on, so with
+      // an RTT known it keeps ahead of a window aiming at the cubic's
+      // present value
+      Cubic aiming_ahead{1000};
+      Cubic aiming_now{1000};
+      aiming_ahead.on_rtt(500);
+      uint64_t now = 0;
+      while (aiming_now.cwnd() < 10000) {
+        aiming_ahead.on_ack(1000, now += 10);
+        aiming_now.on_ack(1000, now);
+      }
+      aiming_ahead.on_loss(10000, now);
+      aiming_now.on_loss(10000, now);
+
+      const uint64_t loss = now;
+      const uint64_t k_ms = 1957;
+      while (now < loss + k_ms - 500) {
+        aiming_ahead.on_ack(1000, now += 100);
+        aiming_now.on_ack(1000, now);
+        check(aiming_ahead.cwnd() >= aiming_now.cwnd(),
+              "CUBIC aiming an RTT ahead is never behind");
+      }
+      check(aiming_ahead.cwnd() > aiming_now.cwnd() + 200,
+            "CUBIC aiming an RTT ahead is well ahead an RTT before K, at " +
+                to_string(aiming_ahead.cwnd()) + " against " +
+                to_string(aiming_now.cwnd()));
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+using namespace std;
+
+static constexpr uint16_t BIG_WINDOW = 60000;
+
+int main() {
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.congestion_control = TCPConfig::CongestionControl::NewReno;
+      cfg.fast_retransmit = true;
+
+      TCPSenderTestHarness test{"Fast retransmit and NewReno recovery", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(Push{string(4001, 'x')});
+      for (int i = 0; i < 4; ++i) {
+        test.execute(ExpectMessage{}.with_payload_size(1000));
+      }
+      test.execute(ExpectMessage{}.with_payload_size(1));
+      test.execute(ExpectNoSegment{});
+
+      // The segment at isn + 1001 is lost; the rest produce duplicate ACKs
+      test.execute(AckReceived{isn + 1001}.with_win(BIG_WINDOW));
+      test.execute(ExpectCwnd{5001});
+      test.execute(AckReceived{isn + 1001}.with_win(BIG_WINDOW));
+      test.execute(AckReceived{isn + 1001}.with_win(BIG_WINDOW));
+      test.execute(ExpectNoSegment{});
+      test.execute(AckReceived{isn + 1001}.with_win(BIG_WINDOW));
+      test.execute(ExpectFastRecovery{true});
+      test.execute(ExpectFastRetransmissions{1});
+      test.execute(
+          ExpectMessage{}.with_seqno(isn + 1001).with_payload_size(1000));
+      test.execute(ExpectNoSegment{});
+      test.execute(ExpectSsthresh{2000});
+      test.execute(ExpectCwnd{2000});
+      test.execute(ExpectSeqnosInFlight{3001});
+
+      // Further duplicates inflate the window, letting new data out
+      test.execute(
+          AckReceived{isn + 1001}.with_win(BIG_WINDOW).without_push());
+      test.execute(Push{string(2999, 'y')});
+      test.execute(
+          ExpectMessage{}.with_seqno(isn + 4002).with_payload_size(1000));
+      test.execute(ExpectMessage{}.with_payload_size(1000));
+      test.execute(ExpectMessage{}.with_payload_size(999));
+      test.execute(ExpectNoSegment{});
+      test.execute(ExpectFastRetransmissions{1});
+
+      // A partial ACK (the segment at isn + 2001 was lost too) resends the
+      // next hole straight away
+      test.execute(AckReceived{isn + 2001}.with_win(BIG_WINDOW));
+      test.execute(ExpectFastRecovery{true});
+      test.execute(
+          ExpectMessage{}.with_seqno(isn + 2001).with_payload_size(1000));
+      test.execute(ExpectNoSegment{});
+
+      // A full ACK ends recovery with cwnd = ssthresh, with no RTO
+      test.execute(AckReceived{isn + 4002}.with_win(BIG_WINDOW));
+      test.execute(ExpectFastRecovery{false});
+      test.execute(ExpectCwnd{2000});
+      test.execute(ExpectRTO{1000});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.fast_retransmit = true;
+
+      TCPSenderTestHarness test{"Fast retransmit without congestion control",
+                                cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1});
+      test.execute(Push{"abcdefgh"});
+      test.execute(ExpectMessage{}.with_data("abcdefgh"));
+      test.execute(Push{"ijkl"});
+      test.execute(ExpectMessage{}.with_data("ijkl"));
+
+      // A changed window is not a duplicate ACK
+      test.execute(AckReceived{isn + 1}.with_win(100));
+      test.execute(AckReceived{isn + 1}.with_win(90));
+      test.execute(AckReceived{isn + 1}.with_win(80));
+      test.execute(AckReceived{isn + 1}.with_win(70));
+      test.execute(ExpectNoSegment{});
+
+      test.execute(AckReceived{isn + 1}.with_win(70));
+      test.execute(AckReceived{isn + 1}.with_win(70));
+      test.execute(ExpectNoSegment{});
+      test.execute(AckReceived{isn + 1}.with_win(70));
+      test.execute(ExpectMessage{}.with_data("abcdefgh"));
+      test.execute(ExpectNoSegment{});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test{"Duplicate ACKs ignored by default", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1});
+      test.execute(Push{"abcdefgh"});
+      test.execute(ExpectMessage{}.with_data("abcdefgh"));
+      for (int i = 0; i < 4; ++i) {
+        test.execute(AckReceived{isn + 1});
+      }
+      test.execute(ExpectNoSegment{});
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
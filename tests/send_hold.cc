@@ -0,0 +1,107 @@
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+using namespace std;
+
+static constexpr uint16_t BIG_WINDOW = 60000;
+
+int main() {
+  try {
+    auto rd = get_random_engine();
+
+    string data(5000, 0);
+    for (auto& c : data) {
+      c = static_cast<char>('a' + rd() % 26);
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test{"sent bytes leave the stream", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(Push{data.substr(0, 2000)});
+      test.execute(ExpectMessage{}.with_data(data.substr(0, 1000)));
+      test.execute(ExpectMessage{}.with_data(data.substr(1000, 1000)));
+      test.execute(ExpectStreamBuffered{0});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.hold_unacked = true;
+      cfg.send_capacity = 3000;
+
+      TCPSenderTestHarness test{"stream holds bytes until acked", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+
+      // Only the stream's capacity fits, sent or not
+      test.execute(Push{data.substr(0, 4000)});
+      test.execute(ExpectMessage{}.with_data(data.substr(0, 1000)));
+      test.execute(ExpectMessage{}.with_data(data.substr(1000, 1000)));
+      test.execute(ExpectMessage{}.with_data(data.substr(2000, 1000)));
+      test.execute(ExpectNoSegment{});
+      test.execute(ExpectStreamBuffered{3000});
+      test.execute(Push{data.substr(3000)});
+      test.execute(ExpectNoSegment{});
+
+      // An ack frees room in the stream
+      test.execute(AckReceived{isn + 1001}.with_win(BIG_WINDOW));
+      test.execute(ExpectStreamBuffered{2000});
+      test.execute(Push{data.substr(3000, 500)});
+      test.execute(ExpectMessage{}.with_data(data.substr(3000, 500)));
+      test.execute(ExpectStreamBuffered{2500});
+
+      // Retransmissions come from the same bytes
+      test.execute(Tick{1000});
+      test.execute(ExpectMessage{}
+                       .with_seqno(isn + 1001)
+                       .with_data(data.substr(1000, 1000)));
+
+      test.execute(Close{});
+      test.execute(ExpectMessage{}.with_fin(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 3502}.with_win(BIG_WINDOW));
+      test.execute(ExpectStreamBuffered{0});
+      test.execute(ExpectSeqnosInFlight{0});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.hold_unacked = true;
+      cfg.super_segments = true;
+      cfg.mss = 100;
+
+      TCPSenderTestHarness test{"held super-segments acked in part", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(Push{data.substr(0, 300)});
+      for (size_t i = 0; i < 3; ++i) {
+        test.execute(ExpectMessage{}.with_data(data.substr(100 * i, 100)));
+      }
+      test.execute(AckReceived{isn + 151}.with_win(BIG_WINDOW));
+      test.execute(ExpectStreamBuffered{150});
+      test.execute(Tick{1000});
+      test.execute(ExpectMessage{}.with_data(data.substr(150, 100)));
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+using namespace std;
+
+static constexpr uint16_t BIG_WINDOW = 60000;
+
+int main() {
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.mss = 500;
+
+      TCPSenderTestHarness test{"runtime MSS", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(Push{string(1200, 'x')});
+      test.execute(ExpectMessage{}.with_payload_size(500));
+      test.execute(ExpectMessage{}.with_payload_size(500));
+      test.execute(ExpectMessage{}.with_payload_size(200));
+      test.execute(ExpectNoSegment{});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.mss = 2000;
+
+      TCPSenderTestHarness test{"MSS above the default", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(Push{string(3000, 'x')});
+      test.execute(ExpectMessage{}.with_payload_size(2000));
+      test.execute(ExpectMessage{}.with_payload_size(1000));
+      test.execute(ExpectNoSegment{});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.mss = 100;
+      cfg.super_segments = true;
+
+      TCPSenderTestHarness test{"super-segments cut at MSS", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      const string data = "0123456789abcdefghijklmnopqrstuvwxyz";
+      string stream;
+      while (stream.size() < 1000) {
+        stream += data;
+      }
+      stream.resize(1050);
+      test.execute(Push{stream}.with_close());
+      for (size_t i = 0; i < 10; ++i) {
+        test.execute(ExpectMessage{}
+                         .with_seqno(isn + 1 + 100 * i)
+                         .with_data(stream.substr(100 * i, 100))
+                         .with_fin(false));
+      }
+      test.execute(ExpectMessage{}.with_data(stream.substr(1000)).with_fin(true));
+      test.execute(ExpectNoSegment{});
+      test.execute(ExpectSeqnosInFlight{1051});
+
+      // Acks can end inside a queued message
+      test.execute(AckReceived{isn + 251}.with_win(BIG_WINDOW));
+      test.execute(ExpectSeqnosInFlight{801});
+      test.execute(Tick{1000});
+      test.execute(ExpectMessage{}
+                       .with_seqno(isn + 251)
+                       .with_data(stream.substr(250, 100)));
+      test.execute(ExpectNoSegment{});
+      test.execute(AckReceived{isn + 1052}.with_win(BIG_WINDOW));
+      test.execute(ExpectSeqnosInFlight{0});
+      test.execute(ExpectNoSegment{});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.mss = 100;
+      cfg.super_segments = true;
+
+      TCPSenderTestHarness test{"super-segments respect the window", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(250));
+      test.execute(Push{string(1000, 'x')});
+      test.execute(ExpectMessage{}.with_payload_size(100));
+      test.execute(ExpectMessage{}.with_payload_size(100));
+      test.execute(ExpectMessage{}.with_payload_size(50));
+      test.execute(ExpectNoSegment{});
+
+      // Only what was sent is resent
+      test.execute(AckReceived{isn + 101}.with_win(100));
+      test.execute(Tick{1000});
+      test.execute(ExpectMessage{}.with_seqno(isn + 101).with_payload_size(100));
+      test.execute(ExpectNoSegment{});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.mss = 100;
+      cfg.super_segments = true;
+      cfg.fast_retransmit = true;
+
+      TCPSenderTestHarness test{"super-segments and fast retransmit", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(Push{string(800, 'x')});
+      for (int i = 0; i < 8; ++i) {
+        test.execute(ExpectMessage{}.with_payload_size(100));
+      }
+      test.execute(AckReceived{isn + 201}.with_win(BIG_WINDOW));
+      for (int i = 0; i < 3; ++i) {
+        test.execute(AckReceived{isn + 201}.with_win(BIG_WINDOW));
+      }
+      test.execute(ExpectFastRecovery{true});
+      test.execute(ExpectMessage{}.with_seqno(isn + 201).with_payload_size(100));
+      test.execute(ExpectNoSegment{});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.mss = 100;
+      cfg.super_segments = true;
+
+      TCPSenderTestHarness test{"no ack for queued but unsent data", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(Push{string(1000, 'x')});
+      for (int i = 0; i < 3; ++i) {
+        test.execute(ExpectMessage{}.with_payload_size(100));
+      }
+
+      // Inside the queued message, past what has gone out: ignored
+      test.execute(AckReceived{isn + 501}.with_win(BIG_WINDOW));
+      test.execute(ExpectSeqnosInFlight{1000});
+      test.execute(ExpectMessage{}.with_seqno(isn + 301).with_payload_size(100));
+      test.execute(AckReceived{isn + 401}.with_win(BIG_WINDOW));
+      test.execute(ExpectSeqnosInFlight{600});
+      test.execute(ExpectMessage{}.with_seqno(isn + 401).with_payload_size(100));
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
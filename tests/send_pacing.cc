@@ -0,0 +1,105 @@
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+using namespace std;
+
+static constexpr uint16_t BIG_WINDOW = 60000;
+
+int main() {
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.congestion_control = TCPConfig::CongestionControl::NewReno;
+      cfg.pacing = true;
+      cfg.pacing_gain = 1;
+
+      TCPSenderTestHarness test{"pacing spreads out the window", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(Tick{10});
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      // cwnd / SRTT = 4001 bytes / 10 ms
+      test.execute(ExpectPacingRate{400.1});
+
+      test.execute(Push{string(4000, 'x')});
+      // One segment's burst, and one more into debt
+      test.execute(ExpectMessage{}.with_seqno(isn + 1));
+      test.execute(ExpectMessage{}.with_seqno(isn + 1001));
+      test.execute(ExpectNoSegment{});
+      test.execute(ExpectNextSendMs{3});
+      test.execute(Tick{2});
+      test.execute(ExpectNoSegment{});
+      test.execute(ExpectNextSendMs{1});
+      test.execute(Tick{1});
+      test.execute(ExpectMessage{}.with_seqno(isn + 2001));
+      test.execute(ExpectNoSegment{});
+      test.execute(ExpectNextSendMs{2});
+      test.execute(Tick{2});
+      test.execute(ExpectMessage{}.with_seqno(isn + 3001));
+      test.execute(ExpectNoSegment{});
+      test.execute(ExpectSeqnosInFlight{4000});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.pacing = true;
+      cfg.pacing_gain = 2;
+
+      TCPSenderTestHarness test{"pacing by the receiver's window", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(Tick{20});
+      test.execute(AckReceived{isn + 1}.with_win(3000));
+      test.execute(ExpectPacingRate{300});
+
+      test.execute(Push{string(3000, 'x')});
+      test.execute(ExpectMessage{}.with_seqno(isn + 1));
+      test.execute(ExpectMessage{}.with_seqno(isn + 1001));
+      test.execute(ExpectNoSegment{});
+      test.execute(ExpectNextSendMs{4});
+
+      // Retransmissions are not held back
+      test.execute(Tick{1000});
+      test.execute(ExpectMessage{}.with_seqno(isn + 1));
+      test.execute(ExpectMessage{}.with_seqno(isn + 2001));
+      test.execute(ExpectNoSegment{});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.pacing = true;
+
+      TCPSenderTestHarness test{"no pacing before an RTT sample", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      // The ACK of a retransmitted SYN gives no sample
+      test.execute(Tick{1000});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(Push{string(3000, 'x')});
+      for (int i = 0; i < 3; ++i) {
+        test.execute(ExpectMessage{}.with_payload_size(1000));
+      }
+      test.execute(ExpectNoSegment{});
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "byte_stream.hh"
+#include "reassembler.hh"
+#include "tcp_config.hh"
+#include "tcp_receiver.hh"
+#include "tcp_sender.hh"
+
+using namespace std;
+
+// A sender and receiver joined by one bottleneck link: the link forwards one
+// segment per millisecond from a drop-tail queue, and each direction has a
+// fixed propagation delay.
+static constexpr uint64_t ONE_WAY_DELAY_MS = 10;
+static constexpr uint64_t MAX_SIMULATED_MS = 1000000;
+
+struct Result {
+  uint64_t completion_ms;
+  size_t max_queue;
+  double mean_queue;
+  uint64_t drops;
+};
+
+Result simulate(const TCPConfig& config, const size_t queue_limit,
+                const uint64_t transfer_bytes) {
+  TCPSender sender{config};
+  TCPReceiver receiver;
+  Reassembler reassembler;
+  ByteStream outbound{config.send_capacity};
+  ByteStream inbound{config.recv_capacity};
+
+  deque<TCPSenderMessage> bottleneck;
+  deque<pair<uint64_t, TCPSenderMessage>> to_receiver;
+  deque<pair<uint64_t, TCPReceiverMessage>> to_sender;
+
+  const string chunk(TCPConfig::MAX_PAYLOAD_SIZE, 'x');
+  uint64_t queue_sum = 0;
+  Result result{};
+
+  for (uint64_t now = 0; now < MAX_SIMULATED_MS; ++now) {
+    while (not to_sender.empty() and to_sender.front().first <= now) {
+      sender.receive(to_sender.front().second);
+      to_sender.pop_front();
+    }
+
+    while (outbound.writer().bytes_pushed() < transfer_bytes and
+           outbound.writer().available_capacity() > 0) {
+      const uint64_t left = transfer_bytes - outbound.writer().bytes_pushed();
+      outbound.writer().push(string_view{chunk}.substr(0, left));
+    }
+    if (outbound.writer().bytes_pushed() == transfer_bytes) {
+      outbound.writer().close();
+    }
+    sender.push(outbound.reader());
+    while (auto segment = sender.maybe_send()) {
+      if (bottleneck.size() < queue_limit) {
+        bottleneck.push_back(move(segment.value()));
+      } else {
+        result.drops += 1;
+      }
+    }
+
+    result.max_queue = max(result.max_queue, bottleneck.size());
+    queue_sum += bottleneck.size();
+    if (not bottleneck.empty()) {
+      to_receiver.emplace_back(now + ONE_WAY_DELAY_MS,
+                               move(bottleneck.front()));
+      bottleneck.pop_front();
+    }
+
+    while (not to_receiver.empty() and to_receiver.front().first <= now) {
+      receiver.receive(move(to_receiver.front().second), reassembler,
+                       inbound.writer());
+      to_receiver.pop_front();
+      inbound.reader().pop(inbound.reader().bytes_buffered());
+      to_sender.emplace_back(now + ONE_WAY_DELAY_MS,
+                             receiver.send(inbound.writer(), reassembler));
+    }
+
+    if (inbound.reader().is_finished()) {
+      result.completion_ms = now;
+      result.mean_queue =
+          static_cast<double>(queue_sum) / static_cast<double>(now + 1);
+      return result;
+    }
+    sender.tick(1);
+  }
+  throw runtime_error("transfer did not finish");
+}
+
+void program_body() {
+  static constexpr uint64_t TRANSFER_BYTES = 2000000;
+
+  struct Scenario {
+    size_t receive_window;
+    size_t queue_limit;
+  };
+  // First a window about the bandwidth-delay product and a deep queue, so
+  // any queue comes from bursts; then a larger window into a shallow queue
+  for (const auto [receive_window, queue_limit] :
+       {Scenario{24000, 1000}, Scenario{64000, 8}}) {
+    Result results[2]{};
+    for (const bool pacing : {false, true}) {
+      TCPConfig config;
+      config.recv_capacity = receive_window;
+      config.congestion_control = TCPConfig::CongestionControl::NewReno;
+      config.fast_retransmit = true;
+      config.sack = true;
+      config.adaptive_rto = true;
+      config.pacing = pacing;
+
+      const Result r = simulate(config, queue_limit, TRANSFER_BYTES);
+      results[pacing] = r;
+      cout << "Bottleneck (window " << setw(5) << receive_window
+           << ", queue limit " << setw(4) << queue_limit << ", pacing "
+           << (pacing ? "on) " : "off)") << ": max queue " << setw(3)
+           << r.max_queue << ", mean queue " << fixed << setprecision(1)
+           << setw(4) << r.mean_queue << ", drops " << setw(4) << r.drops
+           << ", done in " << r.completion_ms << " ms\n";
+    }
+    // With room to queue, the peak shows how bursty the sender is. (Into
+    // the shallow queue, both overshoot in slow start and lose segments.)
+    if (queue_limit > receive_window / TCPConfig::MAX_PAYLOAD_SIZE and
+        results[true].max_queue >= results[false].max_queue) {
+      throw runtime_error("pacing did not lower the peak queue occupancy");
+    }
+  }
+}
+
+int main() {
+  try {
+    program_body();
+  } catch (const exception& e) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+using namespace std;
+
+int main() {
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.adaptive_rto = true;
+      cfg.min_rto_ms = 1;
+      cfg.max_rto_ms = 50;
+
+      TCPSenderTestHarness test{"RTO follows the measured RTT", cfg};
+      test.execute(ExpectRTO{1000});
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(Tick{10});
+      test.execute(AckReceived{isn + 1});
+
+      // First sample: SRTT = R, RTTVAR = R / 2, RTO = SRTT + 4 * RTTVAR
+      test.execute(ExpectSRTT{10});
+      test.execute(ExpectRTO{30});
+
+      test.execute(Push{"abc"});
+      test.execute(ExpectMessage{}.with_data("abc"));
+      test.execute(Tick{29});
+      test.execute(ExpectNoSegment{});
+      test.execute(Tick{1});
+      test.execute(ExpectMessage{}.with_data("abc"));
+      test.execute(ExpectRTO{50});  // backed off to 60, clamped to 50
+
+      // Karn: the ACK of a retransmitted segment is no sample
+      test.execute(Tick{5});
+      test.execute(AckReceived{isn + 4});
+      test.execute(ExpectSRTT{10});
+      test.execute(ExpectRTO{30});
+
+      test.execute(Push{"def"});
+      test.execute(ExpectMessage{}.with_data("def"));
+      test.execute(Tick{2});
+      test.execute(AckReceived{isn + 7});
+      // RTTVAR = 3/4 * 5 + 1/4 * |10 - 2| = 5.75, SRTT = 7/8 * 10 + 1/8 * 2
+      test.execute(ExpectSRTT{9});
+      test.execute(ExpectRTO{32});
+
+      // Backoff never passes the maximum
+      test.execute(Push{"ghi"});
+      test.execute(ExpectMessage{}.with_data("ghi"));
+      test.execute(Tick{32});
+      test.execute(ExpectMessage{}.with_data("ghi"));
+      test.execute(ExpectRTO{50});
+      test.execute(Tick{49});
+      test.execute(ExpectNoSegment{});
+      test.execute(Tick{1});
+      test.execute(ExpectMessage{}.with_data("ghi"));
+      test.execute(ExpectRTO{50});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.adaptive_rto = true;
+
+      TCPSenderTestHarness test{"RTO is at least the minimum", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(Tick{1});
+      test.execute(AckReceived{isn + 1});
+      test.execute(ExpectSRTT{1});
+      test.execute(ExpectRTO{200});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test{"Fixed RTO still measures RTT", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(Tick{10});
+      test.execute(AckReceived{isn + 1});
+      test.execute(ExpectSRTT{10});
+      test.execute(ExpectRTO{1000});
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+using namespace std;
+
+static constexpr uint16_t BIG_WINDOW = 60000;
+
+int main() {
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.fast_retransmit = true;
+      cfg.sack = true;
+
+      TCPSenderTestHarness test{"SACK resends every hole at once", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(Push{string(8000, 'x')});
+      for (int i = 0; i < 8; ++i) {
+        test.execute(ExpectMessage{}.with_payload_size(1000));
+      }
+      test.execute(ExpectNoSegment{});
+
+      // The segments at isn + 1001 and isn + 3001 are lost
+      const auto ack = [&] {
+        return AckReceived{isn + 1001}.with_win(BIG_WINDOW);
+      };
+      test.execute(ack());
+      test.execute(ack().with_sack(isn + 2001, isn + 3001));
+      test.execute(ack().with_sack(isn + 4001, isn + 5001)
+                       .with_sack(isn + 2001, isn + 3001));
+      test.execute(ExpectNoSegment{});
+      test.execute(ack().with_sack(isn + 4001, isn + 6001)
+                       .with_sack(isn + 2001, isn + 3001));
+      test.execute(ExpectFastRecovery{true});
+      test.execute(ExpectMessage{}.with_seqno(isn + 1001));
+      test.execute(ExpectNoSegment{});
+
+      // Three SACKed segments above isn + 3001 mean it is lost too
+      test.execute(ack().with_sack(isn + 4001, isn + 7001)
+                       .with_sack(isn + 2001, isn + 3001));
+      test.execute(ExpectMessage{}.with_seqno(isn + 3001));
+      test.execute(ExpectNoSegment{});
+      // Two resent segments, and the unSACKed one at isn + 7001
+      test.execute(ExpectPipe{3000});
+
+      // The partial ACK needs no further resends
+      test.execute(AckReceived{isn + 3001}
+                       .with_win(BIG_WINDOW)
+                       .with_sack(isn + 4001, isn + 8001));
+      test.execute(ExpectFastRecovery{true});
+      test.execute(ExpectNoSegment{});
+      test.execute(ExpectPipe{1000});
+
+      test.execute(AckReceived{isn + 8001}.with_win(BIG_WINDOW));
+      test.execute(ExpectFastRecovery{false});
+      test.execute(ExpectSeqnosInFlight{0});
+      test.execute(ExpectFastRetransmissions{1});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.fast_retransmit = true;
+      cfg.sack = true;
+      cfg.congestion_control = TCPConfig::CongestionControl::NewReno;
+
+      TCPSenderTestHarness test{"SACK recovery is limited by cwnd", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(Push{string(3999, 'x')});
+      for (int i = 0; i < 3; ++i) {
+        test.execute(ExpectMessage{}.with_payload_size(1000));
+      }
+      test.execute(ExpectMessage{}.with_payload_size(999));
+      test.execute(ExpectNoSegment{});
+      test.execute(ExpectCwnd{4001});
+
+      // The first segment is lost: SACKs alone (no ACKs) reveal it
+      test.execute(AckReceived{isn + 1}
+                       .with_win(BIG_WINDOW)
+                       .with_sack(isn + 1001, isn + 4000));
+      test.execute(ExpectFastRecovery{true});
+      test.execute(ExpectCwnd{2000});
+      test.execute(ExpectPipe{0});
+      test.execute(Push{string(5000, 'y')});
+      // Queued is not sent: nothing is in the network until maybe_send()
+      test.execute(ExpectPipe{0});
+      test.execute(ExpectMessage{}.with_seqno(isn + 1));
+      // One resent segment in the pipe leaves room for one new one
+      test.execute(ExpectMessage{}.with_seqno(isn + 4000));
+      test.execute(ExpectNoSegment{});
+      test.execute(ExpectPipe{2000});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.fast_retransmit = true;
+
+      TCPSenderTestHarness test{"SACK blocks ignored when disabled", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_payload_size(0));
+      test.execute(AckReceived{isn + 1}.with_win(BIG_WINDOW));
+      test.execute(Push{string(5000, 'x')});
+      for (int i = 0; i < 5; ++i) {
+        test.execute(ExpectMessage{}.with_payload_size(1000));
+      }
+      test.execute(AckReceived{isn + 1}
+                       .with_win(BIG_WINDOW)
+                       .with_sack(isn + 2001, isn + 5001));
+      test.execute(ExpectNoSegment{});
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
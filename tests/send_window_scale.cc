@@ -0,0 +1,90 @@
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+using namespace std;
+
+int main() {
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test{"no window scale option by default", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_window_scale({}));
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.window_scaling = true;
+      cfg.recv_capacity = 1 << 20;
+
+      TCPSenderTestHarness test{"SYN offers the receiver's shift", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true).with_window_scale(5));
+      test.execute(Tick{cfg.rt_timeout});
+      test.execute(ExpectMessage{}.with_syn(true).with_window_scale(5));
+      test.execute(AckReceived{isn + 1});
+      test.execute(Push{"abc"});
+      test.execute(ExpectMessage{}.with_data("abc").with_window_scale({}));
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+      cfg.send_capacity = 200000;
+
+      // 512 << 8: a window of 131072, beyond what 16 bits can hold
+      TCPSenderTestHarness test{"scaled window", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true));
+      test.execute(AckReceived{isn + 1}.with_win(512).with_win_shift(8));
+      test.execute(Push{string(200000, 'x')});
+      for (int i = 0; i < 131; ++i) {
+        test.execute(ExpectMessage{}.with_payload_size(1000));
+      }
+      test.execute(ExpectMessage{}.with_payload_size(72));
+      test.execute(ExpectNoSegment{});
+      test.execute(ExpectSeqnosInFlight{131072});
+
+      // The window slides by what is acked
+      test.execute(
+          AckReceived{isn + 1 + 65000}.with_win(512).with_win_shift(8));
+      test.execute(ExpectSeqnosInFlight{131072});
+      test.execute(ExpectStreamBuffered{200000 - 131072 - 65000});
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn(rd());
+      cfg.fixed_isn = isn;
+
+      // Scaled to zero, the window is probed as any zero window
+      TCPSenderTestHarness test{"scaled zero window", cfg};
+      test.execute(Push{});
+      test.execute(ExpectMessage{}.with_syn(true));
+      test.execute(Push{"abc"});
+      test.execute(ExpectNoSegment{});
+      test.execute(AckReceived{isn + 1}.with_win(0).with_win_shift(8));
+      test.execute(ExpectMessage{}.with_data("a"));
+      test.execute(ExpectNoSegment{});
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
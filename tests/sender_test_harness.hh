@@ -53,6 +53,101 @@ struct ExpectSeqnosInFlight : public ExpectNumber<StreamAndSender, uint64_t> {
   }
 };
 
+struct ExpectCwnd : public ExpectNumber<StreamAndSender, uint64_t> {
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "cwnd"; }
+  uint64_t value(StreamAndSender& ss) const override {
+    return ss.second.congestion_controller()->cwnd();
+  }
+};
+
+struct ExpectSsthresh : public ExpectNumber<StreamAndSender, uint64_t> {
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "ssthresh"; }
+  uint64_t value(StreamAndSender& ss) const override {
+    return ss.second.congestion_controller()->ssthresh();
+  }
+};
+
+struct ExpectRTO : public ExpectNumber<StreamAndSender, uint64_t> {
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "current_RTO_ms"; }
+  uint64_t value(StreamAndSender& ss) const override {
+    return ss.second.current_RTO_ms();
+  }
+};
+
+struct ExpectSRTT : public ExpectNumber<StreamAndSender, double> {
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "srtt_ms"; }
+  double value(StreamAndSender& ss) const override {
+    const auto srtt = ss.second.srtt_ms();
+    if (not srtt.has_value()) {
+      throw ExpectationViolation("TCPSender has no RTT sample yet");
+    }
+    return srtt.value();
+  }
+};
+
+struct ExpectPacingRate : public ExpectNumber<StreamAndSender, double> {
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "pacing_rate"; }
+  double value(StreamAndSender& ss) const override {
+    const auto rate = ss.second.pacing_rate();
+    if (not rate.has_value()) {
+      throw ExpectationViolation("TCPSender is not pacing");
+    }
+    return rate.value();
+  }
+};
+
+struct ExpectNextSendMs : public ExpectNumber<StreamAndSender, uint64_t> {
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "next_send_ms"; }
+  uint64_t value(StreamAndSender& ss) const override {
+    const auto ms = ss.second.next_send_ms();
+    if (not ms.has_value()) {
+      throw ExpectationViolation("TCPSender has no segment waiting");
+    }
+    return ms.value();
+  }
+};
+
+struct ExpectStreamBuffered : public ExpectNumber<StreamAndSender, uint64_t> {
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override {
+    return "bytes buffered in the outbound stream";
+  }
+  uint64_t value(StreamAndSender& ss) const override {
+    return ss.first.reader().bytes_buffered();
+  }
+};
+
+struct ExpectPipe : public ExpectNumber<StreamAndSender, uint64_t> {
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "pipe"; }
+  uint64_t value(StreamAndSender& ss) const override {
+    return ss.second.pipe();
+  }
+};
+
+struct ExpectFastRecovery : public ExpectBool<StreamAndSender> {
+  using ExpectBool::ExpectBool;
+  std::string name() const override { return "in_fast_recovery"; }
+  bool value(StreamAndSender& ss) const override {
+    return ss.second.in_fast_recovery();
+  }
+};
+
+struct ExpectFastRetransmissions
+    : public ExpectNumber<StreamAndSender, uint64_t> {
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "fast_retransmissions"; }
+  uint64_t value(StreamAndSender& ss) const override {
+    return ss.second.fast_retransmissions();
+  }
+};
+
 struct ExpectNoSegment : public Expectation<StreamAndSender> {
   std::string description() const override { return "nothing to send"; }
   void execute(StreamAndSender& ss) const override {
@@ -147,7 +242,14 @@ struct Receive : public Action<StreamAndSender> {
   std::string description() const override {
     std::ostringstream desc;
     desc << "receive(ack=" << to_string(msg_.ackno)
-         << ", win=" << msg_.window_size << ")";
+         << ", win=" << msg_.window_size;
+    if (msg_.window_shift != 0) {
+      desc << "<<" << static_cast<int>(msg_.window_shift);
+    }
+    for (const auto& block : msg_.sack_blocks) {
+      desc << ", sack=[" << block.left_edge << ", " << block.right_edge << ")";
+    }
+    desc << ")";
     if (push_) {
       desc << ", then push stream to TCPSender";
     }
@@ -159,6 +261,16 @@ struct Receive : public Action<StreamAndSender> {
     return *this;
   }
 
+  Receive& with_win_shift(uint8_t shift) {
+    msg_.window_shift = shift;
+    return *this;
+  }
+
+  Receive& with_sack(Wrap32 left_edge, Wrap32 right_edge) {
+    msg_.sack_blocks.push_back({left_edge, right_edge});
+    return *this;
+  }
+
   void execute(StreamAndSender& ss) const override {
     ss.second.receive(msg_);
     if (push_) {
@@ -186,6 +298,7 @@ struct ExpectMessage : public Expectation<StreamAndSender> {
   std::optional<Wrap32> seqno{};
   std::optional<std::string> data{};
   std::optional<size_t> payload_size{};
+  std::optional<std::optional<uint8_t>> window_scale{};
 
   ExpectMessage& with_syn(bool syn_) {
     syn = syn_;
@@ -222,6 +335,11 @@ struct ExpectMessage : public Expectation<StreamAndSender> {
     return *this;
   }
 
+  ExpectMessage& with_window_scale(std::optional<uint8_t> window_scale_) {
+    window_scale = window_scale_;
+    return *this;
+  }
+
   std::string message_description() const {
     std::ostringstream o;
     if (seqno.has_value()) {
@@ -243,6 +361,9 @@ struct ExpectMessage : public Expectation<StreamAndSender> {
     if (fin.has_value()) {
       o << (fin.value() ? " +FIN" : " (no FIN)");
     }
+    if (window_scale.has_value()) {
+      o << " window_scale=" << to_string(window_scale.value());
+    }
     return o.str();
   }
 
@@ -271,12 +392,16 @@ struct ExpectMessage : public Expectation<StreamAndSender> {
     if (seqno.has_value() and seg.seqno != seqno.value()) {
       throw ExpectationViolation("sequence number", seqno.value(), seg.seqno);
     }
+    if (window_scale.has_value() and seg.window_scale != window_scale.value()) {
+      throw ExpectationViolation("window_scale", window_scale.value(),
+                                 seg.window_scale);
+    }
     if (payload_size.has_value() and
         seg.payload.size() != payload_size.value()) {
       throw ExpectationViolation("payload_size", payload_size.value(),
                                  seg.payload.size());
     }
-    if (seg.payload.size() > TCPConfig::MAX_PAYLOAD_SIZE) {
+    if (seg.payload.size() > ss.second.mss()) {
       throw ExpectationViolation("payload has length (" +
                                  std::to_string(seg.payload.size()) +
                                  ") greater than the maximum");
@@ -295,6 +420,5 @@ class TCPSenderTestHarness : public TestHarness<StreamAndSender> {
   TCPSenderTestHarness(std::string name, TCPConfig config)
       : TestHarness(move(name),
                     "initial_RTO_ms=" + to_string(config.rt_timeout),
-                    {ByteStream{config.send_capacity},
-                     TCPSender{config.rt_timeout, config.fixed_isn}}) {}
+                    {ByteStream{config.send_capacity}, TCPSender{config}}) {}
 };
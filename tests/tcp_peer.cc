@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ipv4_header.hh"
+#include "parser.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+using namespace std;
+
+static void check(bool condition, const string& what) {
+  if (not condition) {
+    throw runtime_error("TCPPeer test failed: " + what);
+  }
+}
+
+// Put a segment on the wire and take it off again
+static TCPSegment wire(TCPSegment segment) {
+  segment.sport = 40000;
+  segment.dport = 80;
+  IPv4Header ip;
+  ip.len = IPv4Header::LENGTH + segment.header_length() +
+           segment.sender_message.payload.size();
+  segment.compute_checksum(ip.pseudo_checksum());
+  TCPSegment parsed;
+  Parser parser{serialize(segment)};
+  parsed.parse(parser, ip.pseudo_checksum());
+  check(not parser.has_error(), "segment survives the wire");
+  return parsed;
+}
+
+// Everything `from` has to send, as it arrives; delivered to `to` if given
+static vector<TCPSegment> exchange(TCPPeer& from, TCPPeer* to) {
+  vector<TCPSegment> sent;
+  array<TCPSegment, 16> batch;
+  size_t count = 0;
+  do {
+    count = from.drain_outbound(batch);
+    for (size_t i = 0; i < count; ++i) {
+      sent.push_back(wire(move(batch[i])));
+    }
+  } while (count == batch.size());
+  if (to != nullptr) {
+    vector<TCPSegment> delivered = sent;
+    to->receive(span{delivered});
+  }
+  return sent;
+}
+
+static string read_all(TCPPeer& peer) {
+  string data;
+  while (peer.inbound_reader().bytes_buffered() > 0) {
+    data += peer.inbound_reader().peek();
+    peer.inbound_reader().pop(peer.inbound_reader().peek().size());
+  }
+  return data;
+}
+
+static TCPConfig config_with_isn(uint32_t isn) {
+  TCPConfig config;
+  config.fixed_isn = Wrap32{isn};
+  return config;
+}
+
+int main() {
+  try {
+    {
+      // Handshake, then data each way with the ACKs riding along
+      TCPPeer client{config_with_isn(1000)};
+      TCPPeer server{config_with_isn(5000)};
+      check(exchange(server, &client).empty(), "server waits for a SYN");
+
+      client.connect();
+      auto sent = exchange(client, &server);
+      check(sent.size() == 1 and sent[0].sender_message.SYN and
+                sent[0].sender_message.seqno == Wrap32{1000} and
+                not sent[0].receiver_message.ackno.has_value(),
+            "SYN");
+      check(sent[0].mss == TCPConfig::MAX_PAYLOAD_SIZE, "MSS on the SYN");
+
+      sent = exchange(server, &client);
+      check(sent.size() == 1 and sent[0].sender_message.SYN and
+                sent[0].receiver_message.ackno == Wrap32{1001},
+            "SYN/ACK");
+      sent = exchange(client, &server);
+      check(sent.size() == 1 and
+                sent[0].sender_message.sequence_length() == 0 and
+                sent[0].receiver_message.ackno == Wrap32{5001},
+            "ACK of the SYN/ACK");
+      check(exchange(server, &client).empty(), "nothing to ACK an ACK");
+
+      client.outbound_writer().push(string{"hello"});
+      server.outbound_writer().push(string{"world"});
+      sent = exchange(client, &server);
+      check(sent.size() == 1 and sent[0].push and
+                sent[0].receiver_message.ackno == Wrap32{5001},
+            "client data");
+      sent = exchange(server, &client);
+      check(sent.size() == 1 and
+                static_cast<string>(sent[0].sender_message.payload) ==
+                    "world" and
+                sent[0].receiver_message.ackno == Wrap32{1006},
+            "server data carries the ACK");
+      sent = exchange(client, &server);
+      check(sent.size() == 1 and sent[0].receiver_message.ackno ==
+                                      Wrap32{5006},
+            "client ACKs the reply");
+      check(read_all(server) == "hello" and read_all(client) == "world",
+            "data");
+
+      // A burst is acknowledged once
+      client.outbound_writer().push(string(10 * TCPConfig::MAX_PAYLOAD_SIZE,
+                                           'x'));
+      check(exchange(client, &server).size() == 10, "ten segments");
+      sent = exchange(server, &client);
+      check(sent.size() == 1 and
+                sent[0].receiver_message.ackno ==
+                    Wrap32{1006 + 10 * TCPConfig::MAX_PAYLOAD_SIZE},
+            "one ACK for the burst");
+      check(server.receiver().acks_suppressed() == 9, "nine ACKs saved");
+      check(client.sender().sequence_numbers_in_flight() == 0, "all acked");
+
+      // The client closes first, and lingers
+      client.outbound_writer().close();
+      sent = exchange(client, &server);
+      check(sent.size() == 1 and sent[0].sender_message.FIN, "client FIN");
+      exchange(server, &client);
+      check(read_all(server).size() == 10 * TCPConfig::MAX_PAYLOAD_SIZE and
+                server.inbound_reader().is_finished(),
+            "server sees the FIN");
+      server.outbound_writer().close();
+      sent = exchange(server, &client);
+      check(sent.size() == 1 and sent[0].sender_message.FIN, "server FIN");
+      exchange(client, &server);
+      check(not server.active(), "passive closer is done at once");
+      check(client.active(), "active closer lingers");
+      client.tick(10 * TCPConfig::TIMEOUT_DFLT - 1);
+      check(client.active(), "still lingering");
+      client.tick(1);
+      check(not client.active(), "done lingering");
+    }
+
+    {
+      // A burst arriving out of order is reassembled as one
+      TCPPeer client{config_with_isn(1)};
+      TCPPeer server{config_with_isn(2)};
+      client.connect();
+      exchange(client, &server);
+      exchange(server, &client);
+      exchange(client, &server);
+
+      string data;
+      for (char c = 'a'; c < 'e'; ++c) {
+        data += string(TCPConfig::MAX_PAYLOAD_SIZE, c);
+      }
+      client.outbound_writer().push(string{data});
+      auto burst = exchange(client, nullptr);
+      check(burst.size() == 4, "four segments");
+      reverse(burst.begin(), burst.end());
+      server.receive(span{burst});
+      check(read_all(server) == data, "burst reassembled");
+      const auto sent = exchange(server, &client);
+      check(sent.size() == 1 and
+                sent[0].receiver_message.ackno ==
+                    Wrap32{2 + 4 * TCPConfig::MAX_PAYLOAD_SIZE} and
+                sent[0].receiver_message.sack_blocks.empty(),
+            "one ACK for the reordered burst");
+      check(server.receiver().acks_suppressed() == 3, "three ACKs saved");
+      check(client.sender().sequence_numbers_in_flight() == 0, "all acked");
+    }
+
+    {
+      // Too many retransmissions reset the connection
+      TCPConfig config = config_with_isn(1);
+      config.rt_timeout = 100;
+      TCPPeer client{config};
+      TCPPeer server{config_with_isn(2)};
+      client.connect();
+      exchange(client, &server);
+      vector<TCPSegment> sent;
+      for (unsigned i = 0; i <= TCPConfig::MAX_RETX_ATTEMPTS and
+                           client.active();
+           ++i) {
+        client.tick(client.sender().current_RTO_ms());
+        sent = exchange(client, nullptr);
+      }
+      check(not client.active() and sent.size() == 1 and sent[0].reset,
+            "RST after the last retransmission");
+      check(client.outbound_writer().reader().has_error() and
+                client.inbound_reader().has_error(),
+            "streams in error");
+      check(exchange(client, nullptr).empty(), "one RST only");
+
+      check(server.active(), "server mid-handshake");
+      vector<TCPSegment> rst = sent;
+      server.receive(span{rst});
+      check(not server.active() and server.inbound_reader().has_error(),
+            "RST received");
+      check(exchange(server, nullptr).empty(), "no RST for a RST");
+    }
+
+    {
+      // Window scaling lets more than 64 KiB into flight
+      TCPConfig config = config_with_isn(1);
+      config.recv_capacity = config.send_capacity = 1 << 20;
+      config.window_scaling = true;
+      TCPPeer client{config};
+      TCPPeer server{config};
+      client.connect();
+      auto sent = exchange(client, &server);
+      check(sent[0].sender_message.window_scale == config.window_shift(),
+            "window scale on the SYN");
+      sent = exchange(server, &client);
+      check(sent[0].receiver_message.window_size == UINT16_MAX,
+            "SYN window is not scaled");
+      exchange(client, &server);
+
+      client.outbound_writer().push(string(1 << 19, 'x'));
+      exchange(client, &server);
+      check(client.sender().sequence_numbers_in_flight() <= UINT16_MAX,
+            "limited by the SYN's window");
+      sent = exchange(server, &client);
+      check(sent.size() == 1 and
+                sent[0].receiver_message.window_size ==
+                    server.inbound_reader().writer().available_capacity() >>
+                        config.window_shift(),
+            "scaled window");
+      exchange(client, nullptr);
+      check(client.sender().sequence_numbers_in_flight() > UINT16_MAX,
+            "beyond 64 KiB in flight");
+    }
+
+    {
+      // The SYN/ACK's window goes unscaled, and counts as such: once the
+      // handshake is done the full scaled window is offered at once
+      TCPConfig config = config_with_isn(1);
+      config.recv_capacity = config.send_capacity = 1 << 20;
+      config.window_scaling = true;
+      TCPPeer client{config};
+      TCPPeer server{config};
+      client.connect();
+      exchange(client, &server);
+      auto sent = exchange(server, &client);
+      check(sent.size() == 1 and sent[0].sender_message.SYN and
+                sent[0].receiver_message.window_size == UINT16_MAX,
+            "unscaled SYN/ACK window");
+      exchange(client, &server);
+      sent = exchange(server, &client);
+      check(sent.size() == 1 and
+                sent[0].sender_message.sequence_length() == 0 and
+                sent[0].receiver_message.window_size ==
+                    server.inbound_reader().writer().available_capacity() >>
+                        config.window_shift(),
+            "window update after the handshake");
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+using namespace std;
+using namespace std::chrono;
+
+// Move a batch of segments from one peer to the other; returns how many
+size_t exchange(TCPPeer& from, TCPPeer& to, span<TCPSegment> batch) {
+  size_t total = 0;
+  size_t count = 0;
+  do {
+    count = from.drain_outbound(batch);
+    to.receive(batch.first(count));
+    total += count;
+  } while (count == batch.size());
+  return total;
+}
+
+// One peer sends `input_len` bytes to the other over a lossless link, the
+// application draining the inbound stream after every batch
+void speed_test(const size_t input_len, const TCPConfig& config,
+                const size_t batch_size) {
+  TCPPeer client{config};
+  TCPPeer server{config};
+  vector<TCPSegment> batch(batch_size);
+  const string chunk(config.mss * 16, 'x');
+
+  const auto start_time = steady_clock::now();
+  client.connect();
+  uint64_t received = 0;
+  size_t segments = 0;
+  while (not server.inbound_reader().is_finished()) {
+    Writer& outbound = client.outbound_writer();
+    while (outbound.bytes_pushed() < input_len and
+           outbound.available_capacity() > 0) {
+      outbound.push(string_view{chunk}.substr(
+          0, min<uint64_t>(chunk.size(), input_len - outbound.bytes_pushed())));
+    }
+    if (outbound.bytes_pushed() == input_len and not outbound.is_closed()) {
+      outbound.close();
+    }
+
+    const size_t sent = exchange(client, server, batch);
+    Reader& inbound = server.inbound_reader();
+    while (inbound.bytes_buffered() > 0) {
+      received += inbound.peek().size();
+      inbound.pop(inbound.peek().size());
+    }
+    const size_t acked = exchange(server, client, batch);
+    if (sent == 0 and acked == 0) {
+      throw runtime_error("TCPPeer connection stalled");
+    }
+    segments += sent + acked;
+  }
+  const auto stop_time = steady_clock::now();
+
+  if (received != input_len) {
+    throw runtime_error("Mismatch between data written and read");
+  }
+
+  auto test_duration = duration_cast<duration<double>>(stop_time - start_time);
+  auto gigabits_per_second =
+      8 * static_cast<double>(input_len) / test_duration.count() / 1e9;
+
+  fstream debug_output;
+  debug_output.open("/dev/tty");
+
+  cout << "TCPPeer with mss=" << config.mss
+       << ", recv_capacity=" << config.recv_capacity
+       << ", batch=" << batch_size << " reached " << fixed << setprecision(2)
+       << gigabits_per_second << " Gbit/s (" << segments << " segments).\n";
+
+  debug_output << "             TCPPeer throughput: " << fixed
+               << setprecision(2) << gigabits_per_second << " Gbit/s\n";
+
+  if (gigabits_per_second < 0.1) {
+    throw runtime_error("TCPPeer did not meet minimum speed of 0.1 Gbit/s.");
+  }
+}
+
+void program_body() {
+  TCPConfig config;
+  config.mss = 1460;
+  config.fixed_isn = Wrap32{1};
+  speed_test(1e8, config, 64);
+
+  config.recv_capacity = config.send_capacity = 1 << 20;
+  config.window_scaling = true;
+  config.delayed_ack = true;
+  speed_test(1e8, config, 64);
+}
+
+int main() {
+  try {
+    program_body();
+  } catch (const exception& e) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
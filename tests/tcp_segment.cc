@@ -0,0 +1,239 @@
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "checksum.hh"
+#include "ipv4_header.hh"
+#include "parser.hh"
+#include "tcp_segment.hh"
+
+using namespace std;
+
+static void check(bool condition, const string& what) {
+  if (not condition) {
+    throw runtime_error("TCPSegment test failed: " + what);
+  }
+}
+
+static string concat(const vector<Buffer>& buffers) {
+  string ret;
+  for (const auto& buffer : buffers) {
+    ret += buffer;
+  }
+  return ret;
+}
+
+// The IPv4 header a segment of `length` bytes would travel under
+static IPv4Header ip_header(size_t length) {
+  IPv4Header header;
+  header.src = 0x0a000001;
+  header.dst = 0x0a000002;
+  header.len = IPv4Header::LENGTH + length;
+  return header;
+}
+
+// Fill in the checksum of the raw segment `bytes`
+static string with_checksum(string bytes) {
+  bytes[16] = bytes[17] = 0;
+  InternetChecksum check{ip_header(bytes.size()).pseudo_checksum()};
+  check.add(bytes);
+  const uint16_t cksum = check.value();
+  bytes[16] = static_cast<char>(cksum >> 8);
+  bytes[17] = static_cast<char>(cksum);
+  return bytes;
+}
+
+static bool parse_raw(TCPSegment& segment, const vector<Buffer>& bytes,
+                      size_t length) {
+  Parser parser{bytes};
+  segment.parse(parser, ip_header(length).pseudo_checksum());
+  return not parser.has_error();
+}
+
+static bool parse_raw(TCPSegment& segment, const string& bytes) {
+  return parse_raw(segment, {Buffer{bytes}}, bytes.size());
+}
+
+static vector<Buffer> serialize_with_checksum(TCPSegment& segment) {
+  const size_t length =
+      segment.header_length() + segment.sender_message.payload.size();
+  segment.compute_checksum(ip_header(length).pseudo_checksum());
+  return serialize(segment);
+}
+
+int main() {
+  try {
+    {
+      // A SYN laid out as Linux sends it
+      TCPSegment syn;
+      syn.sport = 40000;
+      syn.dport = 80;
+      syn.sender_message.seqno = Wrap32{0x01020304};
+      syn.sender_message.SYN = true;
+      syn.sender_message.window_scale = 7;
+      syn.receiver_message.window_size = 64240;
+      syn.mss = 1460;
+      syn.sack_permitted = true;
+      syn.timestamps = TCPSegment::Timestamps{100, 0};
+      check(syn.header_length() == 40, "SYN header length");
+
+      const string expected = with_checksum(string{
+          "\x9c\x40\x00\x50"                  // ports
+          "\x01\x02\x03\x04"                  // seqno
+          "\x00\x00\x00\x00"                  // ackno
+          "\xa0\x02\xfa\xf0"                  // offset, SYN, window
+          "\x00\x00\x00\x00"                  // checksum, urgent pointer
+          "\x02\x04\x05\xb4"                  // MSS
+          "\x04\x02\x08\x0a\x00\x00\x00\x64"  // SACK-permitted, TSval
+          "\x00\x00\x00\x00"                  // TSecr
+          "\x01\x03\x03\x07",                 // NOP, window scale
+          40});
+      check(concat(serialize_with_checksum(syn)) == expected, "SYN bytes");
+
+      TCPSegment parsed;
+      check(parse_raw(parsed, expected), "SYN parses");
+      check(parsed.sport == 40000 and parsed.dport == 80, "ports");
+      check(parsed.sender_message.seqno == Wrap32{0x01020304}, "seqno");
+      check(parsed.sender_message.SYN and not parsed.sender_message.FIN,
+            "SYN flag");
+      check(not parsed.receiver_message.ackno.has_value(), "no ACK");
+      check(parsed.receiver_message.window_size == 64240, "window");
+      check(parsed.receiver_message.window_shift == 0, "shift not on wire");
+      check(parsed.sender_message.window_scale == 7, "window scale");
+      check(parsed.mss == 1460 and parsed.sack_permitted, "MSS and SACK");
+      check(parsed.timestamps.has_value() and
+                parsed.timestamps->value == 100 and
+                parsed.timestamps->echo_reply == 0,
+            "timestamps");
+      check(concat(serialize(parsed)) == expected, "SYN round trip");
+    }
+
+    {
+      // Data, ACK and SACK blocks, with the payload in its own Buffer
+      TCPSegment segment;
+      segment.sport = 1234;
+      segment.dport = 5678;
+      segment.sender_message.seqno = Wrap32{0xfffffff0};
+      segment.sender_message.payload = string{"hello, world"};
+      segment.sender_message.FIN = true;
+      segment.receiver_message.ackno = Wrap32{77};
+      segment.receiver_message.window_size = 1000;
+      segment.receiver_message.sack_blocks = {{Wrap32{100}, Wrap32{200}},
+                                              {Wrap32{300}, Wrap32{400}}};
+      segment.push = true;
+      segment.timestamps = TCPSegment::Timestamps{0xdeadbeef, 42};
+      check(segment.header_length() == 20 + 12 + 4 + 16, "header length");
+
+      const auto bytes = serialize_with_checksum(segment);
+      check(bytes.size() >= 2 and bytes[1].size() == 12,
+            "payload not copied into the header");
+      TCPSegment parsed;
+      check(parse_raw(parsed, bytes, concat(bytes).size()), "parses");
+      check(parsed.sender_message.seqno == Wrap32{0xfffffff0}, "seqno");
+      check(static_cast<string>(parsed.sender_message.payload) ==
+                "hello, world",
+            "payload");
+      check(parsed.sender_message.FIN and not parsed.sender_message.SYN,
+            "FIN flag");
+      check(parsed.push and not parsed.reset, "PSH flag");
+      check(parsed.receiver_message.ackno == Wrap32{77}, "ackno");
+      check(parsed.receiver_message.sack_blocks.size() == 2 and
+                parsed.receiver_message.sack_blocks[1].left_edge ==
+                    Wrap32{300} and
+                parsed.receiver_message.sack_blocks[1].right_edge ==
+                    Wrap32{400},
+            "SACK blocks");
+      check(parsed.timestamps.has_value() and
+                parsed.timestamps->value == 0xdeadbeef and
+                parsed.timestamps->echo_reply == 42,
+            "timestamps");
+      check(not parsed.mss.has_value() and not parsed.sack_permitted and
+                not parsed.sender_message.window_scale.has_value(),
+            "no SYN options");
+      check(concat(serialize(parsed)) == concat(bytes), "round trip");
+
+      // Any change to the bytes, or to the addresses, fails the checksum
+      string corrupted = concat(bytes);
+      corrupted.back() ^= 1;
+      check(not parse_raw(parsed, corrupted), "corrupted payload");
+      Parser parser{bytes};
+      IPv4Header elsewhere = ip_header(corrupted.size());
+      elsewhere.dst += 1;
+      parsed.parse(parser, elsewhere.pseudo_checksum());
+      check(parser.has_error(), "wrong pseudo-header");
+    }
+
+    {
+      // SACK blocks are cut to what fits in the options
+      TCPSegment segment;
+      segment.receiver_message.ackno = Wrap32{1};
+      for (uint32_t i = 0; i < 4; ++i) {
+        segment.receiver_message.sack_blocks.push_back(
+            {Wrap32{100 * i + 10}, Wrap32{100 * i + 20}});
+      }
+      check(segment.header_length() == 20 + 4 + 32, "four blocks");
+      segment.timestamps = TCPSegment::Timestamps{1, 2};
+      check(segment.header_length() == 20 + 12 + 4 + 24, "three blocks");
+      TCPSegment parsed;
+      const auto bytes = serialize_with_checksum(segment);
+      check(parse_raw(parsed, bytes, concat(bytes).size()), "parses");
+      check(parsed.receiver_message.sack_blocks.size() == 3, "three sent");
+    }
+
+    {
+      // A bare ACK, then the same with odd options
+      const string header{
+          "\x00\x01\x00\x02"
+          "\x00\x00\x00\x05"
+          "\x00\x00\x00\x09"
+          "\x50\x10\x01\x00"
+          "\x00\x00\x00\x00",
+          20};
+      TCPSegment parsed;
+      check(parse_raw(parsed, with_checksum(header)), "bare ACK");
+      check(parsed.receiver_message.ackno == Wrap32{9} and
+                parsed.receiver_message.window_size == 256,
+            "bare ACK fields");
+
+      // An unknown option is skipped, and the end-of-options pads
+      string unknown = header + string{"\x1e\x04\xab\xcd\x02\x04\x02\x00", 8} +
+                       string{"\x00\x00\x00\x00", 4} + "data";
+      unknown[12] = '\x80';
+      check(parse_raw(parsed, with_checksum(unknown)), "unknown option");
+      check(parsed.mss == 512, "MSS after an unknown option");
+      check(static_cast<string>(parsed.sender_message.payload) == "data",
+            "payload after options");
+
+      // Malformed: data offset, option length, truncation
+      string short_offset = header;
+      short_offset[12] = '\x40';
+      check(not parse_raw(parsed, with_checksum(short_offset)),
+            "data offset below 5");
+      string overrun = header + string{"\x02\x08\x05\xb4", 4};
+      overrun[12] = '\x60';
+      check(not parse_raw(parsed, with_checksum(overrun)), "option overrun");
+      string zero_length = header + string{"\x1e\x00\x00\x00", 4};
+      zero_length[12] = '\x60';
+      check(not parse_raw(parsed, with_checksum(zero_length)),
+            "zero-length option");
+      string bad_mss = header + string{"\x02\x03\x05\x01", 4};
+      bad_mss[12] = '\x60';
+      check(not parse_raw(parsed, with_checksum(bad_mss)), "bad MSS length");
+      string truncated = header;
+      truncated[12] = '\x60';
+      check(not parse_raw(parsed, with_checksum(truncated)),
+            "options past the end");
+      check(not parse_raw(parsed, with_checksum(header).substr(0, 19)),
+            "short header");
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
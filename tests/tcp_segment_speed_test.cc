@@ -0,0 +1,117 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ipv4_header.hh"
+#include "parser.hh"
+#include "tcp_segment.hh"
+
+using namespace std;
+using namespace std::chrono;
+
+// Encode (checksum and serialize) then decode (parse and verify) the same
+// segment, as a peer does for every segment it sends and receives
+void speed_test(const string_view name, const TCPSegment& prototype,
+                const size_t iterations) {
+  const size_t length =
+      prototype.header_length() + prototype.sender_message.payload.size();
+  IPv4Header ip;
+  ip.src = 0x0a000001;
+  ip.dst = 0x0a000002;
+  ip.len = IPv4Header::LENGTH + length;
+  const uint32_t pseudo_checksum = ip.pseudo_checksum();
+
+  TCPSegment segment = prototype;
+  vector<vector<Buffer>> encoded;
+  encoded.reserve(iterations);
+
+  const auto encode_start = steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    segment.sender_message.seqno = Wrap32{static_cast<uint32_t>(i)};
+    segment.compute_checksum(pseudo_checksum);
+    encoded.push_back(serialize(segment));
+  }
+  const auto encode_stop = steady_clock::now();
+
+  TCPSegment parsed;
+  const auto decode_start = steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    Parser parser{encoded[i]};
+    parsed.parse(parser, pseudo_checksum);
+    if (parser.has_error() or
+        parsed.sender_message.seqno != Wrap32{static_cast<uint32_t>(i)}) {
+      throw runtime_error("TCPSegment did not parse what it serialized");
+    }
+  }
+  const auto decode_stop = steady_clock::now();
+
+  const auto gigabits_per_second = [&](auto start, auto stop) {
+    const auto test_duration = duration_cast<duration<double>>(stop - start);
+    return 8 * static_cast<double>(length * iterations) /
+           test_duration.count() / 1e9;
+  };
+  const double encode_speed = gigabits_per_second(encode_start, encode_stop);
+  const double decode_speed = gigabits_per_second(decode_start, decode_stop);
+  const double segments_per_second =
+      static_cast<double>(iterations) /
+      duration_cast<duration<double>>(decode_stop - decode_start).count();
+
+  fstream debug_output;
+  debug_output.open("/dev/tty");
+
+  cout << "TCPSegment (" << name << ", " << length << " bytes) encoded at "
+       << fixed << setprecision(2) << encode_speed << " Gbit/s, decoded at "
+       << decode_speed << " Gbit/s ("
+       << segments_per_second / 1e6 << "M segments/s).\n";
+
+  debug_output << "             TCPSegment (" << name << ") throughput: "
+               << fixed << setprecision(2) << encode_speed << " / "
+               << decode_speed << " Gbit/s\n";
+
+  if (encode_speed < 0.1 or decode_speed < 0.1) {
+    throw runtime_error("TCPSegment did not meet minimum speed of 0.1 Gbit/s.");
+  }
+}
+
+void program_body() {
+  // A full-sized data segment with timestamps
+  TCPSegment data;
+  data.sport = 40000;
+  data.dport = 80;
+  data.sender_message.payload = string(1448, 'x');
+  data.receiver_message.ackno = Wrap32{1};
+  data.receiver_message.window_size = 65535;
+  data.timestamps = TCPSegment::Timestamps{12345, 67890};
+  speed_test("data", data, 200000);
+
+  // A bare ACK carrying as many SACK blocks as fit: all header, no payload
+  TCPSegment ack;
+  ack.sport = 80;
+  ack.dport = 40000;
+  ack.receiver_message.ackno = Wrap32{1};
+  ack.receiver_message.window_size = 65535;
+  ack.timestamps = TCPSegment::Timestamps{67890, 12345};
+  for (uint32_t i = 1; i <= 3; ++i) {
+    ack.receiver_message.sack_blocks.push_back(
+        {Wrap32{i * 3000}, Wrap32{i * 3000 + 1448}});
+  }
+  speed_test("SACK", ack, 1000000);
+}
+
+int main() {
+  try {
+    program_body();
+  } catch (const exception& e) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
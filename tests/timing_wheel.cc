@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ethernet_header.hh"
+#include "network_interface.hh"
+#include "random.hh"
+#include "tcp_sender.hh"
+#include "timing_wheel.hh"
+
+using namespace std;
+
+static void check(bool condition, const string& what) {
+  if (not condition) {
+    throw runtime_error("TimingWheel test failed: " + what);
+  }
+}
+
+int main() {
+  try {
+    auto rd = get_random_engine();
+
+    {
+      // Deadlines on and around every level's boundaries, and past the top
+      TimingWheel wheel;
+      const vector<uint64_t> deadlines{1,    63,     64,      65,      4095,
+                                       4096, 4097,   262143,  262144,  300000,
+                                       16777215,     16777216, 20000000};
+      vector<uint64_t> fired;
+      vector<TimingWheel::Handle> handles;
+      for (const uint64_t deadline : deadlines) {
+        handles.push_back(wheel.schedule_at(
+            deadline, [&, deadline] {
+              check(wheel.now() == deadline,
+                    "timer due at " + to_string(deadline) + " ran at " +
+                        to_string(wheel.now()));
+              fired.push_back(deadline);
+            }));
+      }
+      check(wheel.size() == deadlines.size(), "size");
+      wheel.advance(64);
+      check(fired.size() == 3, "three timers by 64 ms");
+      wheel.advance(20000000);
+      check(fired == deadlines, "all timers, in order");
+      check(wheel.size() == 0, "empty");
+      check(not handles.front().pending(), "run timers are not pending");
+    }
+
+    {
+      TimingWheel wheel;
+      unsigned runs = 0;
+      auto a = wheel.schedule(10, [&] { ++runs; });
+      {
+        auto b = wheel.schedule(10, [&] { ++runs; });
+        check(b.pending(), "pending");
+      }
+      auto c = wheel.schedule(10, [&] { ++runs; });
+      c.cancel();
+      check(not c.pending(), "cancelled");
+      check(wheel.size() == 1, "one timer left");
+
+      // Moving a handle keeps the timer; assigning over one cancels it
+      auto moved = std::move(a);
+      check(moved.pending(), "moved handle");
+      wheel.advance(10);
+      check(runs == 1, "only the timer still held runs");
+
+      auto d = wheel.schedule(5, [&] { ++runs; });
+      d = wheel.schedule(6, [&] { runs += 10; });
+      wheel.advance(6);
+      check(runs == 11, "replaced timer");
+    }
+
+    {
+      // Cancelled and moved timers leave nothing behind to wake up for
+      TimingWheel wheel;
+      unsigned runs = 0;
+      auto early = wheel.schedule(10, [&] { ++runs; });
+      auto late = wheel.schedule(50, [&] { runs += 10; });
+      early.cancel();
+      check(wheel.next_wakeup() == 50, "no wakeup for a cancelled timer");
+      check(late.reschedule_at(30) and late.pending(), "rescheduled");
+      check(wheel.next_wakeup() == 30 and wheel.size() == 1,
+            "wakeup for the new deadline only");
+      check(late.reschedule_at(5000), "rescheduled past level 0");
+      check(wheel.next_wakeup() == 64, "wake to refile");
+      wheel.advance(5000);
+      check(runs == 10 and not late.pending(), "runs once, when moved to");
+      check(not late.reschedule_at(6000) and not early.reschedule_at(6000),
+            "only pending timers can be rescheduled");
+      check(wheel.size() == 0, "nothing scheduled by a failed reschedule");
+
+      // A callback can cancel another timer due in the same millisecond
+      TimingWheel::Handle first;
+      TimingWheel::Handle second;
+      first = wheel.schedule(1, [&] {
+        second.cancel();
+        ++runs;
+      });
+      second = wheel.schedule(1, [&] {
+        first.cancel();
+        ++runs;
+      });
+      check(wheel.advance(1) == 1 and runs == 11, "one of the two ran");
+    }
+
+    {
+      // A callback can schedule another; a delay of 0 still waits 1 ms
+      TimingWheel wheel;
+      vector<uint64_t> times;
+      TimingWheel::Handle next;
+      TimingWheel::Callback periodic = [&] {
+        times.push_back(wheel.now());
+        next = wheel.schedule(times.size() < 5 ? 100 : 0, periodic);
+      };
+      auto first = wheel.schedule(100, periodic);
+      wheel.advance(501);
+      check(times == vector<uint64_t>{100, 200, 300, 400, 500, 501},
+            "periodic timer");
+    }
+
+    {
+      // Random deadlines, some cancelled, against a brute-force record
+      TimingWheel wheel;
+      vector<uint64_t> due(10000);
+      vector<uint64_t> ran(due.size(), 0);
+      vector<TimingWheel::Handle> handles;
+      for (size_t i = 0; i < due.size(); ++i) {
+        due[i] = 1 + rd() % 500000;
+        handles.push_back(
+            wheel.schedule_at(due[i], [&, i] { ran[i] = wheel.now(); }));
+      }
+      for (size_t i = 0; i < due.size(); i += 7) {
+        handles[i].cancel();
+      }
+      uint64_t elapsed = 0;
+      while (elapsed < 500000) {
+        const uint64_t ms = 1 + rd() % 3000;
+        wheel.advance(ms);
+        elapsed += ms;
+      }
+      for (size_t i = 0; i < due.size(); ++i) {
+        check(ran[i] == (i % 7 == 0 ? 0 : due[i]), "random timer " +
+                                                       to_string(i));
+      }
+    }
+
+    {
+      // A TCPSender woken by the wheel, without tick()
+      TimingWheel wheel;
+      TCPConfig cfg;
+      cfg.fixed_isn = Wrap32{0};
+      TCPSender sender{cfg};
+      unsigned timeouts = 0;
+      sender.use_timing_wheel(wheel, [&] { ++timeouts; });
+
+      ByteStream stream{cfg.send_capacity};
+      sender.push(stream.reader());
+      check(sender.maybe_send().has_value(), "SYN");
+      wheel.advance(999);
+      check(timeouts == 0 and not sender.maybe_send().has_value(),
+            "no timeout yet");
+      wheel.advance(1);
+      check(timeouts == 1, "timeout after the RTO");
+      const auto resent = sender.maybe_send();
+      check(resent.has_value() and resent->SYN, "SYN resent");
+      check(sender.consecutive_retransmissions() == 1, "backed off");
+      wheel.advance(1999);
+      check(timeouts == 1, "doubled RTO");
+      wheel.advance(1);
+      check(timeouts == 2, "second timeout");
+
+      // Acked: the timer stops, and with it the wakeups
+      sender.receive({Wrap32{1}, 1000, {}});
+      wheel.advance(10000);
+      check(timeouts == 2 and wheel.size() == 0, "no wakeup when idle");
+    }
+
+    {
+      // Each ACK moves the sender's wakeup to the restarted timer's deadline,
+      // leaving no entry behind at the old one
+      TimingWheel wheel;
+      TCPConfig cfg;
+      cfg.fixed_isn = Wrap32{0};
+      cfg.rt_timeout = 60;
+      TCPSender sender{cfg};
+      sender.use_timing_wheel(wheel, [] {});
+
+      ByteStream stream{cfg.send_capacity};
+      sender.push(stream.reader());
+      check(sender.maybe_send().has_value(), "SYN");
+      sender.receive({Wrap32{1}, 1000, {}});
+      for (uint32_t ackno = 1; ackno <= 20; ++ackno) {
+        // Two bytes in flight, in segments of their own, one acked at a time
+        while (sender.sequence_numbers_in_flight() < 2) {
+          stream.writer().push(string{"x"});
+          sender.push(stream.reader());
+          check(sender.maybe_send().has_value(), "one byte");
+        }
+        wheel.advance(1);
+        sender.receive({Wrap32{ackno + 1}, 1000, {}});
+        check(wheel.size() == 1 and
+                  wheel.next_wakeup() == wheel.now() + cfg.rt_timeout,
+              "one wakeup, at the new deadline");
+      }
+    }
+
+    {
+      // Network interfaces sharing one wheel, advanced once for all
+      TimingWheel wheel;
+      vector<NetworkInterface> interfaces;
+      for (uint8_t i = 0; i < 4; ++i) {
+        interfaces.emplace_back(EthernetAddress{2, 0, 0, 0, 0, i},
+                                Address("10.0.0." + to_string(i + 1), 0),
+                                wheel);
+      }
+      InternetDatagram dgram;
+      for (auto& interface : interfaces) {
+        interface.send_datagram(dgram, Address("10.0.1.1", 0));
+        check(interface.maybe_send().has_value(), "ARP request");
+      }
+      wheel.advance(4999);
+      for (auto& interface : interfaces) {
+        check(not interface.maybe_send().has_value(), "no retry yet");
+      }
+      wheel.advance(1);
+      for (auto& interface : interfaces) {
+        const auto frame = interface.maybe_send();
+        check(frame.has_value() and
+                  frame->header.type == EthernetHeader::TYPE_ARP and
+                  frame->header.dst == ETHERNET_BROADCAST,
+              "ARP request retried");
+        check(not interface.maybe_send().has_value(), "one retry");
+      }
+      check(wheel.size() == interfaces.size(), "one timer each");
+    }
+
+    {
+      // Moving over an interface with timers of its own wheel pending
+      NetworkInterface a{EthernetAddress{2, 0, 0, 0, 0, 1},
+                         Address("10.0.0.1", 0)};
+      NetworkInterface b{EthernetAddress{2, 0, 0, 0, 0, 2},
+                         Address("10.0.0.2", 0)};
+      InternetDatagram dgram;
+      a.send_datagram(dgram, Address("10.0.1.1", 0));
+      b.send_datagram(dgram, Address("10.0.1.2", 0));
+      check(a.maybe_send().has_value() and b.maybe_send().has_value(),
+            "ARP requests");
+      a = std::move(b);
+      a.tick(5000);
+      const auto frame = a.maybe_send();
+      check(frame.has_value() and
+                frame->header.type == EthernetHeader::TYPE_ARP,
+            "moved interface retries its ARP request");
+    }
+
+    {
+      // How long to sleep: never past a deadline, and exact within 64 ms
+      TimingWheel wheel;
+      check(not wheel.next_wakeup().has_value(), "nothing to wake for");
+      auto far = wheel.schedule(1000, [] {});
+      check(wheel.next_wakeup() == 64, "wake to refile");
+      auto near = wheel.schedule(10, [] {});
+      check(wheel.next_wakeup() == 10, "wake for the near timer");
+      check(wheel.advance(10) == 1, "one ran");
+      check(wheel.next_wakeup() == 64, "near timer gone");
+      wheel.advance(54);
+      check(wheel.next_wakeup() <= 1000, "refiled, not past the deadline");
+      check(wheel.advance(936) == 1, "far timer ran");
+      check(not wheel.next_wakeup().has_value(), "all done");
+    }
+  } catch (const exception& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -1,23 +1,94 @@
 #pragma once
 
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <string_view>
 
+#include "chunk_pool.hh"
+
+// A reference-counted string. Copies share the underlying storage, and a
+// Buffer may view only part of it (see substr(), remove_prefix() and
+// truncate()), so payloads can be sliced and handed on without copying.
+// The shared string's control block and storage come from the ChunkPool.
 class Buffer {
   std::shared_ptr<std::string> buffer_;
+  size_t offset_{};
+  size_t length_{std::string::npos};  // npos: up to the end of *buffer_
+
+  // Give this Buffer a string that holds exactly the bytes it views.
+  // Called before handing out mutable access to a slice.
+  void unshare() {
+    if (offset_ == 0 and length_ == std::string::npos) {
+      return;
+    }
+    if (buffer_.use_count() > 1) {
+      compact();
+      return;
+    }
+    buffer_->resize(offset_ + size());
+    buffer_->erase(0, offset_);
+    offset_ = 0;
+    length_ = std::string::npos;
+  }
 
  public:
   // NOLINTBEGIN(*-explicit-*)
 
   Buffer(std::string str = {})
-      : buffer_(make_shared<std::string>(std::move(str))) {}
-  operator std::string_view() const { return *buffer_; }
-  operator std::string&() { return *buffer_; }
+      : buffer_(make_pooled_string(std::move(str))) {}
+  operator std::string_view() const {
+    return std::string_view{*buffer_}.substr(offset_, length_);
+  }
+  operator std::string&() {
+    unshare();
+    return *buffer_;
+  }
 
   // NOLINTEND(*-explicit-*)
 
-  std::string&& release() { return std::move(*buffer_); }
-  size_t size() const { return buffer_->size(); }
-  size_t length() const { return buffer_->length(); }
-  bool empty() const { return buffer_->empty(); }
+  std::string&& release() {
+    unshare();
+    return std::move(*buffer_);
+  }
+  size_t size() const { return std::min(length_, buffer_->size() - offset_); }
+  size_t length() const { return size(); }
+  bool empty() const { return size() == 0; }
+
+  // Bytes of storage this Buffer keeps alive, however little of it it views
+  size_t capacity() const { return buffer_->capacity(); }
+
+  // Copy the viewed bytes into storage of their own, letting go of the rest
+  // of the shared string
+  void compact() {
+    std::string copy = ChunkPool::acquire(size());
+    copy.assign(std::string_view{*this});
+    buffer_ = make_pooled_string(std::move(copy));
+    offset_ = 0;
+    length_ = std::string::npos;
+  }
+
+  // A Buffer sharing this one's storage, viewing [pos, pos + n)
+  Buffer substr(size_t pos, size_t n = std::string::npos) const {
+    Buffer ret{*this};
+    ret.remove_prefix(pos);
+    ret.truncate(n);
+    return ret;
+  }
+
+  // Stop viewing the first `n` bytes (no copy)
+  void remove_prefix(size_t n) {
+    n = std::min(n, size());
+    if (length_ != std::string::npos) {
+      length_ -= n;
+    }
+    offset_ += n;
+  }
+
+  // Stop viewing anything past the first `n` bytes (no copy)
+  void truncate(size_t n) {
+    if (n < size()) {
+      length_ = n;
+    }
+  }
 };
@@ -0,0 +1,169 @@
+#include "chunk_pool.hh"
+
+#include <bit>
+#include <new>
+
+using namespace std;
+
+namespace {
+
+// Trivially destructible, so it can still be read after the thread's
+// ChunkPool has been destroyed
+thread_local bool pool_destroyed = false;
+
+// The smallest class that holds `size` bytes (NUM_CLASSES if none does)
+size_t class_holding(size_t size) {
+  if (size <= ChunkPool::MIN_CLASS_SIZE) {
+    return 0;
+  }
+  if (size > ChunkPool::MAX_CLASS_SIZE) {
+    return ChunkPool::NUM_CLASSES;
+  }
+  return bit_width(size - 1) - bit_width(ChunkPool::MIN_CLASS_SIZE - 1);
+}
+
+// The largest class that `size` bytes can serve (NUM_CLASSES if none).
+// Storage of twice the largest class or more serves none: pooled, it would
+// pin that much memory to hand out MAX_CLASS_SIZE at a time.
+size_t class_served_by(size_t size) {
+  if (size < ChunkPool::MIN_CLASS_SIZE or
+      size >= 2 * ChunkPool::MAX_CLASS_SIZE) {
+    return ChunkPool::NUM_CLASSES;
+  }
+  size = min(size, ChunkPool::MAX_CLASS_SIZE);
+  return bit_width(size) - bit_width(ChunkPool::MIN_CLASS_SIZE);
+}
+
+size_t class_size(size_t size_class) {
+  return ChunkPool::MIN_CLASS_SIZE << size_class;
+}
+
+// Owns a pooled string; recycles its storage when the last Buffer goes away
+struct PooledString {
+  string str;
+
+  explicit PooledString(string&& s) : str(move(s)) {}
+  ~PooledString() { ChunkPool::recycle(move(str)); }
+
+  PooledString(const PooledString& other) = delete;
+  PooledString& operator=(const PooledString& other) = delete;
+  PooledString(PooledString&& other) = delete;
+  PooledString& operator=(PooledString&& other) = delete;
+};
+
+}  // namespace
+
+ChunkPool::ChunkPool() {
+  // Reserve up front so that recycling never allocates
+  for (auto& list : strings_) {
+    list.reserve(MAX_FREE_PER_CLASS);
+  }
+}
+
+ChunkPool::~ChunkPool() {
+  pool_destroyed = true;
+  for (size_t i = 0; i < NUM_CLASSES; ++i) {
+    while (blocks_[i]) {
+      FreeBlock* block = blocks_[i];
+      blocks_[i] = block->next;
+      ::operator delete(block);
+    }
+  }
+}
+
+ChunkPool* ChunkPool::local() {
+  if (pool_destroyed) {
+    return nullptr;
+  }
+  thread_local ChunkPool pool;
+  return &pool;
+}
+
+string ChunkPool::acquire(size_t capacity) {
+  ChunkPool* pool = local();
+  const size_t size_class = class_holding(capacity);
+  if (pool and size_class < NUM_CLASSES) {
+    auto& list = pool->strings_[size_class];
+    if (not list.empty()) {
+      ++pool->stats_.hits;
+      string str = move(list.back());
+      list.pop_back();
+      return str;
+    }
+    ++pool->stats_.misses;
+    capacity = class_size(size_class);
+  } else if (pool) {
+    ++pool->stats_.misses;
+  }
+  string str;
+  str.reserve(capacity);
+  return str;
+}
+
+void ChunkPool::recycle(string&& str) {
+  ChunkPool* pool = local();
+  const size_t size_class = class_served_by(str.capacity());
+  if (not pool or size_class == NUM_CLASSES) {
+    return;
+  }
+  auto& list = pool->strings_[size_class];
+  if (list.size() < MAX_FREE_PER_CLASS) {
+    str.clear();
+    list.push_back(move(str));
+  }
+}
+
+void* ChunkPool::allocate(size_t bytes) {
+  ChunkPool* pool = local();
+  const size_t size_class = class_holding(bytes);
+  if (size_class == NUM_CLASSES) {
+    if (pool) {
+      ++pool->stats_.misses;
+    }
+    return ::operator new(bytes);
+  }
+  // Always a whole class, even without a pool: the block may be freed into
+  // another thread's pool
+  if (not pool) {
+    return ::operator new(class_size(size_class));
+  }
+  if (FreeBlock* block = pool->blocks_[size_class]) {
+    ++pool->stats_.hits;
+    pool->blocks_[size_class] = block->next;
+    --pool->num_blocks_[size_class];
+    return block;
+  }
+  ++pool->stats_.misses;
+  return ::operator new(class_size(size_class));
+}
+
+void ChunkPool::deallocate(void* ptr, size_t bytes) noexcept {
+  ChunkPool* pool = local();
+  const size_t size_class = class_holding(bytes);
+  if (not pool or size_class == NUM_CLASSES or
+      pool->num_blocks_[size_class] == MAX_FREE_PER_CLASS) {
+    ::operator delete(ptr);
+    return;
+  }
+  auto* block = static_cast<FreeBlock*>(ptr);
+  block->next = pool->blocks_[size_class];
+  pool->blocks_[size_class] = block;
+  ++pool->num_blocks_[size_class];
+}
+
+ChunkPool::Stats ChunkPool::stats() {
+  const ChunkPool* pool = local();
+  return pool ? pool->stats_ : Stats{};
+}
+
+void ChunkPool::reset_stats() {
+  if (ChunkPool* pool = local()) {
+    pool->stats_ = {};
+  }
+}
+
+shared_ptr<string> make_pooled_string(string&& str) {
+  auto holder =
+      allocate_shared<PooledString>(PoolAllocator<PooledString>{}, move(str));
+  return {holder, &holder->str};
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A per-thread, size-classed pool of string storage and small memory blocks.
+//
+// Payload strings (ByteStream chunks, Buffers, Serializer output) are taken
+// from the pool with acquire() and handed back with recycle() instead of
+// going to the global heap each time. Buffer's shared control blocks come
+// from allocate()/deallocate() through PoolAllocator.
+//
+// Each thread has its own pool, so there is no locking; memory released on a
+// different thread from the one that acquired it simply joins that thread's
+// pool. Once a thread's pool has been destroyed (at thread exit), calls fall
+// back to the global heap.
+class ChunkPool {
+ public:
+  // Size classes are powers of two from MIN_CLASS_SIZE to MAX_CLASS_SIZE
+  static constexpr size_t MIN_CLASS_SIZE = 64;
+  static constexpr size_t MAX_CLASS_SIZE = 65536;
+  static constexpr size_t NUM_CLASSES = 11;
+  // How many free strings (or blocks) each size class keeps
+  static constexpr size_t MAX_FREE_PER_CLASS = 128;
+
+  struct Stats {
+    uint64_t hits;    // requests served from a free list
+    uint64_t misses;  // requests that went to the global heap
+  };
+
+  // An empty string with capacity for at least `capacity` bytes
+  static std::string acquire(size_t capacity);
+  // Return a string's storage to this thread's pool (or free it if full, or
+  // if it is too small or too large for any size class)
+  static void recycle(std::string&& str);
+
+  // Raw memory of at least `bytes` bytes, and its release
+  static void* allocate(size_t bytes);
+  static void deallocate(void* ptr, size_t bytes) noexcept;
+
+  // Counters for this thread's pool
+  static Stats stats();
+  static void reset_stats();
+
+  ~ChunkPool();
+  ChunkPool(const ChunkPool& other) = delete;
+  ChunkPool& operator=(const ChunkPool& other) = delete;
+  ChunkPool(ChunkPool&& other) = delete;
+  ChunkPool& operator=(ChunkPool&& other) = delete;
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  std::array<std::vector<std::string>, NUM_CLASSES> strings_{};
+  std::array<FreeBlock*, NUM_CLASSES> blocks_{};
+  std::array<size_t, NUM_CLASSES> num_blocks_{};
+  Stats stats_{};
+
+  ChunkPool();
+
+  // This thread's pool, or nullptr once it has been destroyed
+  static ChunkPool* local();
+};
+
+// std::allocator-compatible front end to ChunkPool::allocate()
+template <class T>
+struct PoolAllocator {
+  using value_type = T;
+
+  PoolAllocator() = default;
+  template <class U>
+  explicit PoolAllocator(const PoolAllocator<U>& /*unused*/) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(ChunkPool::allocate(n * sizeof(T)));
+  }
+  void deallocate(T* ptr, size_t n) noexcept {
+    ChunkPool::deallocate(ptr, n * sizeof(T));
+  }
+
+  template <class U>
+  bool operator==(const PoolAllocator<U>& /*unused*/) const {
+    return true;
+  }
+};
+
+// A shared string whose control block comes from the pool, and whose storage
+// is recycled into the pool when the last reference goes away
+std::shared_ptr<std::string> make_pooled_string(std::string&& str);
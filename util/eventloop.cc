@@ -0,0 +1,239 @@
+#include "eventloop.hh"
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+
+#include "exception.hh"
+
+using namespace std;
+using namespace std::chrono;
+
+EventLoop::EventLoop()
+    : epoll_(CheckSystemCall("epoll_create1", ::epoll_create1(EPOLL_CLOEXEC))),
+      start_(steady_clock::now()) {}
+
+void EventLoop::RuleHandle::cancel() {
+  const auto rule = rule_.lock();
+  if (rule && !rule->cancelled) {
+    loop_->remove(rule);
+  }
+}
+
+EventLoop::RuleHandle EventLoop::add_rule(const FileDescriptor& fd,
+                                          Direction direction,
+                                          CallbackT callback,
+                                          InterestT interest,
+                                          CallbackT cancel) {
+  // O_NONBLOCK is shared by every dup of the descriptor: it is the
+  // caller's to set, not ours to change behind its back
+  const int flags = CheckSystemCall(
+      "fcntl", ::fcntl(fd.fd_num(), F_GETFL));  // NOLINT(*-vararg)
+  if ((flags & O_NONBLOCK) == 0) {              // NOLINT(*-bitwise)
+    throw runtime_error("EventLoop: descriptor must be non-blocking");
+  }
+  FileDescriptor watched = fd.duplicate();
+  const int fd_num = watched.fd_num();
+
+  // One registration per descriptor, for both directions: the rules sort
+  // out who is interested
+  epoll_event event{};
+  event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  event.data.fd = fd_num;
+  if (::epoll_ctl(epoll_.fd_num(), EPOLL_CTL_ADD, fd_num, &event) != 0 &&
+      errno != EEXIST) {
+    throw unix_error{"epoll_ctl"};
+  }
+
+  auto rule = make_shared<Rule>(Rule{std::move(watched), direction,
+                                     std::move(callback), std::move(interest),
+                                     std::move(cancel)});
+  Watch& watch = watches_[fd_num];
+  watch.rules.push_back(rule);
+  ++rule_count_;
+  // Readiness already seen, before there was a rule to use it
+  if (watch.readable || watch.writable) {
+    mark_pending(fd_num, watch);
+  }
+  return {this, rule};
+}
+
+void EventLoop::remove(const shared_ptr<Rule>& rule) {
+  rule->cancelled = true;
+  --rule_count_;
+  const int fd_num = rule->fd.fd_num();
+  if (const auto it = watches_.find(fd_num); it != watches_.end()) {
+    Watch& watch = it->second;
+    watch.rules.remove(rule);
+    if (watch.rules.empty()) {
+      // A closed descriptor has left the epoll set already
+      if (!rule->fd.closed()) {
+        ::epoll_ctl(epoll_.fd_num(), EPOLL_CTL_DEL, fd_num, nullptr);
+      }
+      // Dropped from watches_ by run_pending(), outside any callback
+      mark_pending(fd_num, watch);
+    }
+  }
+  rule->cancel();
+}
+
+void EventLoop::mark_pending(int fd, Watch& watch) {
+  if (!watch.pending) {
+    watch.pending = true;
+    pending_.push_back(fd);
+  }
+}
+
+// Run the callbacks of the interested rules for the directions `watch` is
+// ready in. A direction stays ready while a rule of it was not interested,
+// or lost interest during its callback (rather than running out of work).
+//
+// A rule whose interest() or callback throws (say, a reset connection) is
+// removed, as if its descriptor had closed: the error is the rule's, and the
+// other rules carry on.
+bool EventLoop::run_rules(Watch& watch) {
+  bool ran = false;
+  array<bool, 2> keep{watch.readable, watch.writable};
+  array<bool, 2> used{};
+  array<bool, 2> waiting{};
+  const vector<shared_ptr<Rule>> rules{watch.rules.begin(),
+                                       watch.rules.end()};
+  for (const auto& rule : rules) {
+    const auto dir = static_cast<size_t>(rule->direction);
+    if (rule->cancelled || !keep[dir]) {
+      continue;
+    }
+    try {
+      if (!rule->interest()) {
+        waiting[dir] = true;
+        continue;
+      }
+      rule->callback();
+      ran = true;
+      if (rule->cancelled) {
+        continue;
+      }
+      if (rule->fd.closed() ||
+          (rule->direction == Direction::In && rule->fd.eof())) {
+        remove(rule);
+        continue;
+      }
+      used[dir] = true;
+      if (!rule->interest()) {
+        waiting[dir] = true;
+      }
+    } catch (const exception&) {
+      ran = true;
+      if (!rule->cancelled) {
+        remove(rule);
+      }
+    }
+  }
+  for (size_t dir = 0; dir < 2; ++dir) {
+    keep[dir] = keep[dir] && (waiting[dir] || !used[dir]);
+  }
+  watch.readable = keep[0];
+  watch.writable = keep[1];
+  return ran;
+}
+
+bool EventLoop::run_pending() {
+  bool ran = false;
+  const vector<int> fds = std::move(pending_);
+  pending_.clear();
+  size_t next = 0;
+  try {
+    for (; next < fds.size(); ++next) {
+      const auto it = watches_.find(fds[next]);
+      if (it == watches_.end()) {
+        continue;
+      }
+      it->second.pending = false;
+      ran |= run_rules(it->second);
+    }
+  } catch (...) {
+    // Only a cancel callback can get here. The descriptors not reached
+    // keep their readiness for next time: no new edge would bring it back.
+    for (size_t i = next; i < fds.size(); ++i) {
+      if (const auto it = watches_.find(fds[i]); it != watches_.end()) {
+        it->second.pending = i == next && it->second.pending;
+        mark_pending(fds[i], it->second);
+      }
+    }
+    throw;
+  }
+
+  // What is still ready but was not wanted waits for notify()
+  for (const int fd : fds) {
+    const auto it = watches_.find(fd);
+    if (it != watches_.end() && it->second.rules.empty()) {
+      watches_.erase(it);
+    }
+  }
+  return ran;
+}
+
+void EventLoop::notify(const FileDescriptor& fd) {
+  const auto it = watches_.find(fd.fd_num());
+  if (it != watches_.end() && (it->second.readable || it->second.writable)) {
+    mark_pending(fd.fd_num(), it->second);
+  }
+}
+
+size_t EventLoop::advance_timers() {
+  const auto elapsed = static_cast<uint64_t>(
+      duration_cast<milliseconds>(steady_clock::now() - start_).count());
+  if (elapsed <= timers_.now()) {
+    return 0;
+  }
+  return timers_.advance(elapsed - timers_.now());
+}
+
+EventLoop::Result EventLoop::wait_next_event(int timeout_ms) {
+  if (rule_count_ == 0 && timers_.size() == 0) {
+    return Result::Exit;
+  }
+
+  // First, what was ready but unwanted and may be wanted now
+  bool ran = advance_timers() > 0;
+  ran |= run_pending();
+
+  int wait_ms = ran ? 0 : timeout_ms;
+  if (const auto wakeup = timers_.next_wakeup(); wakeup.has_value()) {
+    const auto until_timer =
+        static_cast<int>(min<uint64_t>(wakeup.value() - timers_.now(),
+                                       numeric_limits<int>::max()));
+    wait_ms = wait_ms < 0 ? until_timer : min(wait_ms, until_timer);
+  }
+
+  static constexpr size_t MAX_EVENTS = 1024;
+  array<epoll_event, MAX_EVENTS> events{};
+  const int count = ::epoll_wait(epoll_.fd_num(), events.data(), MAX_EVENTS,
+                                 wait_ms);
+  if (count < 0 && errno != EINTR) {
+    throw unix_error{"epoll_wait"};
+  }
+  for (int i = 0; i < count; ++i) {
+    const epoll_event& event = events[i];
+    const auto it = watches_.find(event.data.fd);
+    if (it == watches_.end()) {
+      continue;
+    }
+    Watch& watch = it->second;
+    // An error or hangup is for the callbacks to find, reading or writing
+    const bool failed = event.events & (EPOLLERR | EPOLLHUP);
+    watch.readable |= failed || (event.events & (EPOLLIN | EPOLLRDHUP));
+    watch.writable |= failed || (event.events & EPOLLOUT);
+    mark_pending(event.data.fd, watch);
+  }
+
+  ran |= advance_timers() > 0;
+  ran |= run_pending();
+  return ran ? Result::Success : Result::Timeout;
+}
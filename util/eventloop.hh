@@ -0,0 +1,125 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "file_descriptor.hh"
+#include "timing_wheel.hh"
+
+// Waits for file descriptors to become readable or writable, and runs the
+// callbacks of the rules watching them, on one thread (epoll(7)).
+//
+// Descriptors are watched edge-triggered, and must already be non-blocking
+// (add_rule() throws otherwise): a callback must read or write until the
+// descriptor would block, or until its rule's interest() turns false. The
+// loop remembers a descriptor it has seen ready while the rule was not
+// interested. interest() is not polled: whatever changes it (say, draining a
+// full buffer) calls notify(), and the loop then runs the callback without
+// waiting for a new edge that may never come. Rules moving ByteStreams to
+// and from descriptors are in eventloop_streams.hh.
+//
+// Timers share the loop's clock: wait_next_event() advances timers() by the
+// milliseconds that have passed, and sleeps no longer than until the next
+// timer is due.
+class EventLoop {
+ public:
+  enum class Direction : uint8_t { In, Out };
+
+  // What wait_next_event() did
+  enum class Result {
+    Success,  // ran a callback or timer
+    Timeout,  // nothing happened before the timeout
+    Exit      // nothing left to wait for: no rules and no timers
+  };
+
+  using CallbackT = std::function<void()>;
+  using InterestT = std::function<bool()>;
+
+ private:
+  struct Rule {
+    FileDescriptor fd;
+    Direction direction;
+    CallbackT callback;
+    InterestT interest;
+    CallbackT cancel;
+    bool cancelled = false;
+  };
+
+  // A watched descriptor: its rules, and the directions the kernel has
+  // reported ready and no callback has yet used up
+  struct Watch {
+    std::list<std::shared_ptr<Rule>> rules{};
+    bool readable = false;
+    bool writable = false;
+    bool pending = false;  // listed in pending_
+  };
+
+  FileDescriptor epoll_;
+  std::unordered_map<int, Watch> watches_{};
+  std::vector<int> pending_{};  // descriptors with readiness left over
+  size_t rule_count_ = 0;
+
+  TimingWheel timers_{};
+  std::chrono::steady_clock::time_point start_;
+
+  void mark_pending(int fd, Watch& watch);
+  bool run_pending();
+  bool run_rules(Watch& watch);
+  void remove(const std::shared_ptr<Rule>& rule);
+  size_t advance_timers();
+
+ public:
+  // Cancels its rule when cancel() is called. Dropping the handle leaves
+  // the rule in place. The loop must outlive its handles.
+  class RuleHandle {
+    EventLoop* loop_{};
+    std::weak_ptr<Rule> rule_{};
+
+   public:
+    RuleHandle() = default;
+    RuleHandle(EventLoop* loop, std::weak_ptr<Rule> rule)
+        : loop_(loop), rule_(std::move(rule)) {}
+    ~RuleHandle() = default;
+    RuleHandle(const RuleHandle& other) = default;
+    RuleHandle& operator=(const RuleHandle& other) = default;
+    RuleHandle(RuleHandle&& other) = default;
+    RuleHandle& operator=(RuleHandle&& other) = default;
+
+    void cancel();
+  };
+
+  EventLoop();
+  ~EventLoop() = default;
+  EventLoop(const EventLoop& other) = delete;
+  EventLoop& operator=(const EventLoop& other) = delete;
+  EventLoop(EventLoop&& other) = delete;
+  EventLoop& operator=(EventLoop&& other) = delete;
+
+  // Run `callback` whenever `fd` is ready for `direction` and `interest()`
+  // is true. The rule is removed, and `cancel` run, once `fd` is closed (or
+  // at EOF, for Direction::In), `callback` or `interest` throws, or the
+  // handle's cancel() is called. `fd` must be non-blocking.
+  RuleHandle add_rule(
+      const FileDescriptor& fd, Direction direction, CallbackT callback,
+      InterestT interest = [] { return true; }, CallbackT cancel = [] {});
+
+  // The interest of a rule on `fd` may have changed: look at it again on
+  // the next wait, if `fd` has readiness left over
+  void notify(const FileDescriptor& fd);
+
+  // Wait up to `timeout_ms` (forever if negative) for a descriptor to be
+  // ready or a timer due, and run what is. Callbacks may add and cancel
+  // rules and timers.
+  Result wait_next_event(int timeout_ms);
+
+  // Timers, on the loop's clock: milliseconds since it was constructed
+  TimingWheel& timers() { return timers_; }
+
+  size_t rule_count() const { return rule_count_; }
+};
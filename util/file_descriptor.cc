@@ -1,6 +1,7 @@
 #include "file_descriptor.hh"
 
 #include <fcntl.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/uio.h>
@@ -47,6 +48,10 @@ FileDescriptor::FDWrapper::FDWrapper(int fd) : fd_(fd) {
   const int flags =
       CheckSystemCall("fcntl", fcntl(fd, F_GETFL));  // NOLINT(*-vararg)
   non_blocking_ = flags & O_NONBLOCK;                // NOLINT(*-bitwise)
+
+  struct stat status {};
+  CheckSystemCall("fstat", fstat(fd, &status));
+  socket_ = S_ISSOCK(status.st_mode);  // NOLINT(*-signed-bitwise)
 }
 
 void FileDescriptor::FDWrapper::close() {
@@ -89,6 +94,7 @@ void FileDescriptor::read(string& buffer) {
   if (bytes_read < 0) {
     if (internal_fd_->non_blocking_ and
         (errno == EAGAIN or errno == EINPROGRESS)) {
+      buffer.clear();
       return;
     }
     throw unix_error{"read"};
@@ -153,6 +159,41 @@ void FileDescriptor::read(vector<unique_ptr<string>>& buffers) {
   }
 }
 
+size_t FileDescriptor::read(const vector<span<char>>& buffers) {
+  vector<iovec> iovecs;
+  iovecs.reserve(buffers.size());
+  size_t total_size = 0;
+  for (const auto x : buffers) {
+    iovecs.push_back({x.data(), x.size()});
+    total_size += x.size();
+  }
+  if (total_size == 0) {
+    return 0;
+  }
+
+  const ssize_t bytes_read =
+      ::readv(fd_num(), iovecs.data(), static_cast<int>(iovecs.size()));
+  if (bytes_read < 0) {
+    if (internal_fd_->non_blocking_ and
+        (errno == EAGAIN or errno == EINPROGRESS)) {
+      return 0;
+    }
+    throw unix_error{"readv"};
+  }
+
+  register_read();
+
+  if (bytes_read == 0) {
+    internal_fd_->eof_ = true;
+  }
+
+  if (bytes_read > static_cast<ssize_t>(total_size)) {
+    throw runtime_error("read() read more than requested");
+  }
+
+  return bytes_read;
+}
+
 size_t FileDescriptor::write(string_view buffer) {
   return write(vector<string_view>{buffer});
 }
@@ -167,12 +208,25 @@ size_t FileDescriptor::write(const vector<string_view>& buffers) {
     total_size += x.size();
   }
 
-  const ssize_t bytes_written = CheckSystemCall(
-      "writev",
-      ::writev(fd_num(), iovecs.data(), static_cast<int>(iovecs.size())));
+  ssize_t bytes_written = 0;
+  if (internal_fd_->socket_) {
+    // MSG_NOSIGNAL: a reset peer is an error for the caller to handle, not
+    // a signal that ends the process
+    msghdr message{};
+    message.msg_iov = iovecs.data();
+    message.msg_iovlen = iovecs.size();
+    bytes_written = CheckSystemCall(
+        "sendmsg", ::sendmsg(fd_num(), &message, MSG_NOSIGNAL));
+  } else {
+    bytes_written = CheckSystemCall(
+        "writev",
+        ::writev(fd_num(), iovecs.data(), static_cast<int>(iovecs.size())));
+  }
   register_write();
 
-  if (bytes_written == 0 and total_size != 0) {
+  // A non-blocking descriptor that would block reports 0 bytes written
+  if (bytes_written == 0 and total_size != 0 and
+      not internal_fd_->non_blocking_) {
     throw runtime_error("write returned 0 given non-empty input buffer");
   }
 
@@ -3,6 +3,9 @@
 #include <cstddef>
 #include <limits>
 #include <memory>
+#include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 
 // A reference-counted handle to a file descriptor
@@ -17,6 +20,7 @@ class FileDescriptor {
         false;  // Flag indicating whether FDWrapper::fd_ has been closed
     bool non_blocking_ =
         false;  // Flag indicating whether FDWrapper::fd_ is non-blocking
+    bool socket_ = false;  // Flag indicating whether FDWrapper::fd_ is a socket
     unsigned read_count_ =
         0;  // The number of times FDWrapper::fd_ has been read
     unsigned write_count_ =
@@ -70,9 +74,13 @@ class FileDescriptor {
   // Read into `buffer`
   void read(std::string& buffer);
   void read(std::vector<std::unique_ptr<std::string>>& buffers);
+  // Read directly into caller-owned memory (readv)
+  // returns number of bytes read (0 at EOF, or if non-blocking and no data)
+  size_t read(const std::vector<std::span<char>>& buffers);
 
   // Attempt to write a buffer
-  // returns number of bytes written
+  // returns number of bytes written (0 if non-blocking and it would block)
+  // A socket whose peer has gone throws (EPIPE) rather than raising SIGPIPE
   size_t write(std::string_view buffer);
   size_t write(const std::vector<std::string_view>& buffers);
 
@@ -34,6 +34,16 @@ class Parser {
     uint64_t serialized_length() const { return size(); }
     bool empty() const { return size_ == 0; }
 
+    // Call `f` on each stretch of the remaining bytes, in order
+    template <class F>
+    void for_each(F&& f) const {
+      uint64_t skip = skip_;
+      for (const auto& x : buffer_) {
+        f(std::string_view{x}.substr(skip));
+        skip = 0;
+      }
+    }
+
     std::string_view peek() const {
       if (buffer_.empty()) {
         throw std::runtime_error("peek on empty BufferList");
@@ -148,6 +158,9 @@ class Parser {
 };
 
 class Serializer {
+  // Enough for any header this stack serializes
+  static constexpr size_t HEADER_CAPACITY = 64;
+
   std::vector<Buffer> output_{};
   std::string buffer_{};
 
@@ -159,6 +172,10 @@ class Serializer {
   void integer(const T& val) {
     constexpr uint64_t len = sizeof(T);
 
+    if (buffer_.empty() and buffer_.capacity() < HEADER_CAPACITY) {
+      buffer_ = ChunkPool::acquire(HEADER_CAPACITY);
+    }
+
     for (uint64_t i = 0; i < len; ++i) {
       const uint8_t byte_val = val >> ((len - i - 1) * 8);
       buffer_.push_back(byte_val);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <optional>
@@ -16,10 +17,65 @@ class TCPConfig {
       1000;  //!< Default re-transmit timeout is 1 second
   static constexpr unsigned MAX_RETX_ATTEMPTS =
       8;  //!< Maximum re-transmit attempts before giving up
+  static constexpr size_t SUPER_SEGMENT_MSS =
+      64;  //!< With super_segments, how many MSS one queued message holds
+  static constexpr uint8_t MAX_WINDOW_SHIFT =
+      14;  //!< Largest window scale shift allowed (RFC 7323)
+  static constexpr uint64_t RECV_IDLE_MS =
+      1000;  //!< With auto_tune_recv, how long without data before the
+             //!< inbound stream shrinks back to recv_capacity
+
+  //! Congestion control for the sender (None: limited by the receiver's
+  //! window alone)
+  enum class CongestionControl : uint8_t { None, NewReno, Cubic };
 
   uint16_t rt_timeout = TIMEOUT_DFLT;  //!< Initial value of the retransmission
                                        //!< timeout, in milliseconds
   size_t recv_capacity = DEFAULT_CAPACITY;  //!< Receive capacity, in bytes
   size_t send_capacity = DEFAULT_CAPACITY;  //!< Sender capacity, in bytes
+  bool window_scaling = false;  //!< Offer window scaling (RFC 7323) on SYN,
+                                //!< with window_shift() for recv_capacity
+  bool delayed_ack = false;  //!< Acknowledge in-order data every second
+                             //!< full segment, or after delayed_ack_ms
+  uint64_t delayed_ack_ms = 40;  //!< Longest an ACK is held back
+  bool auto_tune_recv = false;  //!< Resize the inbound stream to twice what
+                                //!< the application drains per round trip
+  size_t max_recv_capacity = 4 << 20;  //!< With auto_tune_recv, the largest
+                                       //!< inbound capacity, in bytes
   std::optional<Wrap32> fixed_isn{};
+  size_t mss = MAX_PAYLOAD_SIZE;  //!< Largest payload the sender puts in
+                                  //!< one segment
+  bool super_segments = false;  //!< Queue data in messages of up to
+                                //!< SUPER_SEGMENT_MSS * mss bytes, cut into
+                                //!< mss-sized segments as they are sent;
+                                //!< not combined with sack
+  CongestionControl congestion_control = CongestionControl::None;
+  bool fast_retransmit = false;  //!< Retransmit on three duplicate ACKs
+                                 //!< and recover NewReno-style (RFC 6582)
+  bool sack = false;  //!< Recover from loss using the receiver's SACK
+                      //!< blocks (RFC 6675); needs fast_retransmit
+  bool hold_unacked = false;  //!< Leave sent bytes in the outbound stream
+                              //!< until acked, counting against its capacity
+  bool pacing = false;  //!< Space new segments out over the round trip
+                        //!< rather than sending the window at once
+  double pacing_gain = 1.25;  //!< Pacing rate is this times window / SRTT
+  bool adaptive_rto = false;    //!< Derive the retransmission timeout from
+                                //!< measured round-trip times (RFC 6298)
+  uint64_t min_rto_ms = 200;    //!< Lower clamp on the adaptive timeout
+  uint64_t max_rto_ms = 60000;  //!< Upper clamp on the adaptive timeout,
+                                //!< including its exponential backoff
+
+  //! Smallest window shift that lets a 16-bit window advertise all of
+  //! recv_capacity, or max_recv_capacity with auto_tune_recv (or as much as
+  //! MAX_WINDOW_SHIFT allows)
+  uint8_t window_shift() const {
+    const size_t capacity =
+        auto_tune_recv ? std::max(recv_capacity, max_recv_capacity)
+                       : recv_capacity;
+    uint8_t shift = 0;
+    while (shift < MAX_WINDOW_SHIFT && (capacity >> shift) > UINT16_MAX) {
+      ++shift;
+    }
+    return shift;
+  }
 };
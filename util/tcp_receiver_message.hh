@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <optional>
+#include <vector>
 
 #include "wrapping_integers.hh"
 
@@ -15,11 +17,29 @@
  * hasn't yet received the Initial Sequence Number.
  *
  * 2) The window size. This is the number of sequence numbers that the TCP
- * receiver is interested to receive, starting from the ackno if present. The
- * maximum value is 65,535 (UINT16_MAX from the <cstdint> header).
+ * receiver is interested to receive, starting from the ackno if present, in
+ * units of 2^window_shift. The maximum value is 65,535 (UINT16_MAX from the
+ * <cstdint> header).
+ *
+ * 3) The SACK blocks (RFC 2018): sequence number ranges the receiver holds
+ * beyond the ackno, most recently received first. Empty if there are none.
+ *
+ * 4) The window shift (RFC 7323): how far to shift window_size left to get
+ * the window in sequence numbers. Zero unless window scaling was negotiated
+ * on SYN.
  */
 
+struct SACKBlock {
+  Wrap32 left_edge{0};   // first sequence number of the block
+  Wrap32 right_edge{0};  // sequence number just past the block
+};
+
 struct TCPReceiverMessage {
   std::optional<Wrap32> ackno{};
   uint16_t window_size{};
+  std::vector<SACKBlock> sack_blocks{};
+  uint8_t window_shift{};
+
+  // The window in sequence numbers
+  uint64_t window() const { return uint64_t{window_size} << window_shift; }
 };
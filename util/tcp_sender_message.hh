@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <optional>
 #include <string>
 
 #include "buffer.hh"
@@ -9,7 +11,7 @@
  * The TCPSenderMessage structure contains the information sent from a TCP
  * sender to its receiver.
  *
- * It contains four fields:
+ * It contains five fields:
  *
  * 1) The sequence number (seqno) of the beginning of the segment. If the SYN
  * flag is set, this is the sequence number of the SYN flag. Otherwise, it's the
@@ -23,6 +25,10 @@
  *
  * 4) The FIN flag. If set, it means the payload represents the ending of the
  * byte stream.
+ *
+ * 5) The window scale option (RFC 7323), only on a SYN: present if the sending
+ * peer offers window scaling, giving the shift it applies to the windows it
+ * advertises.
  */
 
 struct TCPSenderMessage {
@@ -30,6 +36,7 @@ struct TCPSenderMessage {
   bool SYN{false};
   Buffer payload{};
   bool FIN{false};
+  std::optional<uint8_t> window_scale{};
 
   // How many sequence numbers does this segment use?
   size_t sequence_length() const { return SYN + payload.size() + FIN; }
@@ -0,0 +1,157 @@
+#include "timing_wheel.hh"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+TimingWheel::Handle::Handle(Handle&& other) noexcept
+    : wheel_(exchange(other.wheel_, nullptr)), id_(other.id_) {}
+
+TimingWheel::Handle& TimingWheel::Handle::operator=(Handle&& other) noexcept {
+  if (this != &other) {
+    cancel();
+    wheel_ = exchange(other.wheel_, nullptr);
+    id_ = other.id_;
+  }
+  return *this;
+}
+
+void TimingWheel::Handle::cancel() {
+  if (wheel_ != nullptr) {
+    if (const auto it = wheel_->timers_.find(id_);
+        it != wheel_->timers_.end()) {
+      wheel_->unfile(it->second);
+      wheel_->timers_.erase(it);
+    }
+    wheel_ = nullptr;
+  }
+}
+
+bool TimingWheel::Handle::pending() const {
+  return wheel_ != nullptr && wheel_->timers_.contains(id_);
+}
+
+bool TimingWheel::Handle::reschedule_at(uint64_t deadline_ms) {
+  if (wheel_ == nullptr) {
+    return false;
+  }
+  const auto it = wheel_->timers_.find(id_);
+  if (it == wheel_->timers_.end()) {
+    return false;
+  }
+  Timer& timer = it->second;
+  deadline_ms = max(deadline_ms, wheel_->now_ + 1);
+  if (timer.deadline != deadline_ms) {
+    wheel_->unfile(timer);
+    timer.deadline = deadline_ms;
+    wheel_->file(id_, timer);
+  }
+  return true;
+}
+
+TimingWheel::Handle TimingWheel::schedule_at(uint64_t deadline_ms,
+                                             Callback callback) {
+  deadline_ms = max(deadline_ms, now_ + 1);
+  const TimerId id = next_id_++;
+  auto& timer = timers_.emplace(id, Timer{deadline_ms, std::move(callback)})
+                    .first->second;
+  file(id, timer);
+  return {this, id};
+}
+
+// File under the lowest level whose span covers the deadline. A deadline
+// already reached goes in the current level-0 slot, which step() is about to
+// run.
+void TimingWheel::file(TimerId id, Timer& timer) {
+  const uint64_t deadline = timer.deadline;
+  const uint64_t delta = deadline > now_ ? deadline - now_ : 0;
+  for (size_t level = 0; level < LEVELS; ++level) {
+    const size_t shift = SLOT_BITS * level;
+    if (level + 1 < LEVELS && delta >= uint64_t{1} << (shift + SLOT_BITS)) {
+      continue;
+    }
+    // Beyond the top level: the farthest slot, to be filed again from there
+    const uint64_t span_end = now_ + (uint64_t{1} << (shift + SLOT_BITS)) - 1;
+    const uint64_t when = max(deadline, now_);
+    timer.level = level;
+    timer.slot = (min(when, span_end) >> shift) % SLOTS;
+    auto& slot = slots_[level][timer.slot];
+    timer.position = slot.size();
+    slot.push_back(id);
+    return;
+  }
+}
+
+// Take the timer's entry out of its slot, moving the slot's last entry into
+// its place
+void TimingWheel::unfile(Timer& timer) {
+  auto& slot = slots_[timer.level][timer.slot];
+  const TimerId last = slot.back();
+  slot[timer.position] = last;
+  timers_.at(last).position = timer.position;
+  slot.pop_back();
+}
+
+size_t TimingWheel::step() {
+  ++now_;
+
+  // Refile the timers of each higher-level slot the clock has just entered,
+  // from the top down so they can cascade all the way in one step
+  for (size_t level = LEVELS - 1; level > 0; --level) {
+    const size_t shift = SLOT_BITS * level;
+    if ((now_ & ((uint64_t{1} << shift) - 1)) != 0) {
+      continue;
+    }
+    // Each goes to a lower level, never back into this slot
+    auto& slot = slots_[level][(now_ >> shift) % SLOTS];
+    while (!slot.empty()) {
+      const TimerId id = slot.back();
+      slot.pop_back();
+      file(id, timers_.at(id));
+    }
+  }
+
+  // Entries are taken out one at a time, so a callback can still cancel the
+  // timers left in the slot
+  auto& slot = slots_[0][now_ % SLOTS];
+  size_t ran = 0;
+  while (!slot.empty()) {
+    const TimerId id = slot.back();
+    slot.pop_back();
+    const auto it = timers_.find(id);
+    Callback callback = std::move(it->second.callback);
+    timers_.erase(it);
+    // May schedule or cancel timers, though none for this millisecond
+    callback();
+    ++ran;
+  }
+  return ran;
+}
+
+size_t TimingWheel::advance(uint64_t ms) {
+  if (timers_.empty()) {
+    // Nothing to run, and no slot holds an entry: skip ahead
+    now_ += ms;
+    return 0;
+  }
+  size_t ran = 0;
+  for (uint64_t i = 0; i < ms; ++i) {
+    ran += step();
+  }
+  return ran;
+}
+
+// The first level-0 slot ahead with entries, else the next time a higher
+// level's slot is refiled
+optional<uint64_t> TimingWheel::next_wakeup() const {
+  if (timers_.empty()) {
+    return {};
+  }
+  for (uint64_t ms = 1; ms < SLOTS; ++ms) {
+    if (!slots_[0][(now_ + ms) % SLOTS].empty()) {
+      return now_ + ms;
+    }
+  }
+  return (now_ | (SLOTS - 1)) + 1;
+}
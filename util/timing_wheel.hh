@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// A hierarchical timing wheel (Varghese and Lauck) shared by many timers.
+//
+// Timers are filed in slots by deadline: LEVELS wheels of SLOTS slots, where
+// a slot of level k spans SLOTS^k ms. As the clock reaches a slot of a higher
+// level, its timers are filed again in a lower one. Advancing the clock thus
+// costs the slots it passes and the timers that expire, however many timers
+// are scheduled. Timers due beyond the top level wait in its farthest slot.
+//
+// Each timer knows where its entry sits in its slot, so cancelling or
+// rescheduling one takes its entry out at once (swapping the slot's last
+// entry into its place) rather than leaving it for the slot to come round.
+class TimingWheel {
+ public:
+  using Callback = std::function<void()>;
+  using TimerId = uint64_t;
+
+  // Owns one scheduled timer, and cancels it when destroyed or assigned
+  // over. The wheel must outlive its handles.
+  class Handle {
+    TimingWheel* wheel_{};
+    TimerId id_{};
+
+   public:
+    Handle() = default;
+    Handle(TimingWheel* wheel, TimerId id) : wheel_(wheel), id_(id) {}
+    ~Handle() { cancel(); }
+    Handle(const Handle& other) = delete;
+    Handle& operator=(const Handle& other) = delete;
+    Handle(Handle&& other) noexcept;
+    Handle& operator=(Handle&& other) noexcept;
+
+    void cancel();
+    bool pending() const;  // Scheduled, and neither run nor cancelled?
+
+    // Move a pending timer to a new deadline, keeping its callback. Returns
+    // false, changing nothing, if the timer is not pending.
+    bool reschedule_at(uint64_t deadline_ms);
+  };
+
+  TimingWheel() = default;
+  TimingWheel(const TimingWheel& other) = delete;
+  TimingWheel& operator=(const TimingWheel& other) = delete;
+
+  // Run `callback` from advance() when the clock reaches `deadline_ms` (or
+  // in the next millisecond, if that has passed)
+  Handle schedule_at(uint64_t deadline_ms, Callback callback);
+
+  // Same, `delay_ms` from now
+  Handle schedule(uint64_t delay_ms, Callback callback) {
+    return schedule_at(now_ + delay_ms, std::move(callback));
+  }
+
+  // Move the clock forward, running the callbacks of timers that come due
+  // (in deadline order). Returns how many ran.
+  size_t advance(uint64_t ms);
+
+  // A time to sleep until: no later than the earliest deadline, though it
+  // may be earlier. Empty if no timer is pending.
+  std::optional<uint64_t> next_wakeup() const;
+
+  uint64_t now() const { return now_; }
+  size_t size() const { return timers_.size(); }  // Timers pending
+
+ private:
+  static constexpr size_t SLOT_BITS = 6;
+  static constexpr size_t SLOTS = size_t{1} << SLOT_BITS;
+  static constexpr size_t LEVELS = 4;
+
+  struct Timer {
+    uint64_t deadline;
+    Callback callback;
+    // Where the timer's entry is filed: slots_[level][slot][position]
+    size_t level{};
+    size_t slot{};
+    size_t position{};
+  };
+
+  uint64_t now_ = 0;
+  TimerId next_id_ = 1;
+  std::unordered_map<TimerId, Timer> timers_{};
+  std::array<std::array<std::vector<TimerId>, SLOTS>, LEVELS> slots_{};
+
+  void file(TimerId id, Timer& timer);
+  void unfile(Timer& timer);
+  size_t step();
+};